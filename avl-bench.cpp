@@ -0,0 +1,1082 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "avl-tree.h"
+#include "b-plus-tree.h"
+#include "compact-avl-tree.h"
+#include "concurrent-avl-tree.h"
+#include "durable-avl-tree.h"
+#include "frozen-tree.h"
+#include "parallel-avl-tree.h"
+#include "snapshot.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+// Returns the number of nanoseconds elapsed since start.
+double elapsedNs(Clock::time_point start) {
+    return chrono::duration<double, nano>(Clock::now() - start).count();
+}
+
+// Returns the keys 0..n-1, either in order or shuffled with a fixed seed.
+vector<BinarySearchTree::DataType> makeKeys(unsigned int n, bool shuffled) {
+    vector<BinarySearchTree::DataType> keys(n);
+    for (unsigned int i = 0; i < n; ++i) keys[i] = i;
+    if (shuffled) shuffle(keys.begin(), keys.end(), mt19937(140));
+    return keys;
+}
+
+// Returns whether the trees count the nodes their operations visit, which they
+// only do when built with LAB3_TREE_STATS.
+bool countsVisits() {
+#ifdef LAB3_TREE_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Formats the nodes visited per operation, or "-" if the trees do not count them.
+string visitsPerOperation(double visited, double operations) {
+    if (!countsVisits()) return "-";
+    ostringstream out;
+    out << fixed << setprecision(2) << visited / operations;
+    return out.str();
+}
+
+// Grows a tree to max_keys in steps of 10x, reporting the cost of the inserts in
+// each step and then of removing the same keys again. If the cost per operation
+// is logarithmic, the last column stays roughly flat as the tree grows.
+void benchmarkScaling(const char* name, unsigned int max_keys, bool shuffled) {
+    vector<BinarySearchTree::DataType> keys = makeKeys(max_keys, shuffled);
+    vector<unsigned int> sizes;
+    AVLTree avl;
+
+    cout << name << " keys\n"
+         << setw(12) << "size" << setw(8) << "op" << setw(14) << "ns/op" << setw(14) << "ns/op/log2n"
+         << setw(14) << "nodes/op" << "\n";
+
+    // Insert the keys in steps of 10x, so each step costs about as much as all before it.
+    unsigned int from = 0;
+    for (unsigned int to = 1000; from < max_keys; to *= 10) {
+        if (to > max_keys) to = max_keys;
+
+        double visited = 0;
+        Clock::time_point start = Clock::now();
+        for (unsigned int i = from; i < to; ++i) {
+            avl.insert(keys[i]);
+            visited += avl.nodesVisited();
+        }
+        double ns = elapsedNs(start) / (to - from);
+
+        cout << setw(12) << to << setw(8) << "insert" << setw(14) << fixed << setprecision(1) << ns
+             << setw(14) << setprecision(2) << ns / log2(to) << setw(14)
+             << visitsPerOperation(visited, to - from) << "\n";
+        sizes.push_back(to);
+        from = to;
+    }
+
+    // Remove the keys again, largest tree first.
+    for (int step = sizes.size() - 1; step >= 0; --step) {
+        unsigned int to = (step == 0) ? 0 : sizes[step - 1];
+
+        double visited = 0;
+        Clock::time_point start = Clock::now();
+        for (unsigned int i = sizes[step]; i > to; --i) {
+            avl.remove(keys[i - 1]);
+            visited += avl.nodesVisited();
+        }
+        double ns = elapsedNs(start) / (sizes[step] - to);
+
+        cout << setw(12) << sizes[step] << setw(8) << "remove" << setw(14) << fixed << setprecision(1) << ns
+             << setw(14) << setprecision(2) << ns / log2(sizes[step]) << setw(14)
+             << visitsPerOperation(visited, sizes[step] - to)
+             << "\n";
+    }
+    cout << endl;
+}
+
+// Runs a churn workload on a tree of n keys: fill it, then slide the window of
+// live keys along by removing the oldest key and inserting a new one n times,
+// then destroy it. Reports the time per operation of each phase.
+template <class Tree>
+void benchmarkChurn(const char* name, unsigned int n) {
+    vector<BinarySearchTree::DataType> keys = makeKeys(2 * n, true);
+    Tree* tree = new Tree;
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int i = 0; i < n; ++i) tree->insert(keys[i]);
+    double fill_ns = elapsedNs(start) / n;
+
+    start = Clock::now();
+    for (unsigned int i = 0; i < n; ++i) {
+        tree->remove(keys[i]);
+        tree->insert(keys[i + n]);
+    }
+    double churn_ns = elapsedNs(start) / (2 * n);
+
+    start = Clock::now();
+    delete tree;
+    double destroy_ns = elapsedNs(start) / n;
+
+    cout << setw(12) << name << setw(12) << n << setw(14) << fixed << setprecision(1) << fill_ns
+         << setw(14) << churn_ns << setw(14) << destroy_ns << "\n";
+}
+
+// Compares trees whose nodes come from new/delete with trees using a NodePool.
+void benchmarkAllocators(unsigned int max_keys) {
+    cout << "Node allocators (ns/op)\n"
+         << setw(12) << "allocator" << setw(12) << "size" << setw(14) << "fill" << setw(14) << "churn"
+         << setw(14) << "destroy" << "\n";
+
+    for (unsigned int n = 1000; n <= max_keys; n *= 10) {
+        benchmarkChurn<HeapAVLTree>("new/delete", n);
+        benchmarkChurn<AVLTree>("pool", n);
+    }
+    cout << endl;
+}
+
+// Compares the ways to load n keys into an empty tree, for n from 1000 up to
+// max_keys: inserting them one at a time, build_from_sorted on sorted keys, and
+// build on shuffled keys, which sorts a copy first.
+void benchmarkBulkBuild(unsigned int max_keys) {
+    cout << "Loading a tree (ns/key)\n"
+         << setw(12) << "size" << setw(14) << "insert" << setw(14) << "sorted" << setw(14) << "shuffled" << "\n";
+
+    for (unsigned int n = 1000; n <= max_keys; n *= 10) {
+        vector<BinarySearchTree::DataType> sorted = makeKeys(n, false);
+        vector<BinarySearchTree::DataType> shuffled = makeKeys(n, true);
+
+        Clock::time_point start = Clock::now();
+        {
+            AVLTree avl;
+            for (unsigned int i = 0; i < n; ++i) avl.insert(sorted[i]);
+        }
+        double insert_ns = elapsedNs(start) / n;
+
+        start = Clock::now();
+        {
+            AVLTree avl;
+            avl.build_from_sorted(sorted.begin(), sorted.end());
+        }
+        double sorted_ns = elapsedNs(start) / n;
+
+        start = Clock::now();
+        {
+            AVLTree avl(shuffled.begin(), shuffled.end());
+        }
+        double shuffled_ns = elapsedNs(start) / n;
+
+        cout << setw(12) << n << setw(14) << fixed << setprecision(1) << insert_ns << setw(14) << sorted_ns
+             << setw(14) << shuffled_ns << "\n";
+    }
+    cout << endl;
+}
+
+// Compares inserting and then removing batches of k new keys one key at a time
+// with insert_batch and erase_batch, on a tree of max_keys keys, for k from 1000
+// up to max_keys.
+void benchmarkBatches(unsigned int max_keys) {
+    vector<BinarySearchTree::DataType> tree_keys(max_keys);
+    for (unsigned int i = 0; i < max_keys; ++i) tree_keys[i] = 2 * i;
+    vector<BinarySearchTree::DataType> new_keys = makeKeys(max_keys, true);
+    for (unsigned int i = 0; i < max_keys; ++i) new_keys[i] = 2 * new_keys[i] + 1;
+
+    cout << "Batches on " << max_keys << " keys (ns/key)\n"
+         << setw(12) << "batch" << setw(14) << "insert" << setw(14) << "insert_batch" << setw(14) << "remove"
+         << setw(14) << "erase_batch" << "\n";
+
+    for (unsigned int k = 1000; k <= max_keys; k *= 10) {
+        AVLTree avl(tree_keys.begin(), tree_keys.end());
+        vector<BinarySearchTree::DataType>::iterator first = new_keys.begin(), last = new_keys.begin() + k;
+
+        Clock::time_point start = Clock::now();
+        for (vector<BinarySearchTree::DataType>::iterator it = first; it != last; ++it) avl.insert(*it);
+        double insert_ns = elapsedNs(start) / k;
+
+        start = Clock::now();
+        for (vector<BinarySearchTree::DataType>::iterator it = first; it != last; ++it) avl.remove(*it);
+        double remove_ns = elapsedNs(start) / k;
+
+        start = Clock::now();
+        avl.insert_batch(first, last);
+        double insert_batch_ns = elapsedNs(start) / k;
+
+        start = Clock::now();
+        avl.erase_batch(first, last);
+        double erase_batch_ns = elapsedNs(start) / k;
+
+        cout << setw(12) << k << setw(14) << fixed << setprecision(1) << insert_ns << setw(14) << insert_batch_ns
+             << setw(14) << remove_ns << setw(14) << erase_batch_ns << "\n";
+    }
+    cout << endl;
+}
+
+// Compares merging a tree of m keys into a tree of max_keys keys with set_union
+// against inserting its keys one at a time, for m from 1000 up to max_keys. Half
+// of the merged keys are already in the large tree.
+void benchmarkUnion(unsigned int max_keys) {
+    vector<BinarySearchTree::DataType> large_keys(max_keys);
+    for (unsigned int i = 0; i < max_keys; ++i) large_keys[i] = 2 * i;
+
+    cout << "Union into " << max_keys << " keys (ns/merged key)\n"
+         << setw(12) << "m" << setw(14) << "insert" << setw(14) << "set_union" << "\n";
+
+    for (unsigned int m = 1000; m <= max_keys; m *= 10) {
+        vector<BinarySearchTree::DataType> small_keys(m);
+        for (unsigned int i = 0; i < m; ++i) small_keys[i] = (unsigned long long)i * 2 * max_keys / m + (i % 2);
+
+        AVLTree large(large_keys.begin(), large_keys.end()), small(small_keys.begin(), small_keys.end());
+        Clock::time_point start = Clock::now();
+        for (AVLTree::iterator it = small.begin(); it != small.end(); ++it) large.insert(*it);
+        double insert_ns = elapsedNs(start) / m;
+
+        AVLTree large2(large_keys.begin(), large_keys.end()), small2(small_keys.begin(), small_keys.end());
+        start = Clock::now();
+        large2.set_union(small2);
+        double union_ns = elapsedNs(start) / m;
+
+        cout << setw(12) << m << setw(14) << fixed << setprecision(1) << insert_ns << setw(14) << union_ns << "\n";
+    }
+    cout << endl;
+}
+
+// Compares range scans of k keys on a tree of max_keys keys, for k from 1000 up
+// to 1M: the AVL tree's scan(), a loop over its iterators, and a loop over the
+// iterators of a std::set. Each range starts at a random key, and the time is
+// reported per key visited, so the search for the first key is amortized over k.
+void benchmarkRangeScans(unsigned int max_keys) {
+    vector<BinarySearchTree::DataType> keys = makeKeys(max_keys, true);
+    AVLTree avl;
+    set<BinarySearchTree::DataType> std_set;
+    for (unsigned int i = 0; i < max_keys; ++i) {
+        avl.insert(keys[i]);
+        std_set.insert(keys[i]);
+    }
+
+    cout << "Range scans on " << max_keys << " keys (ns/key)\n"
+         << setw(12) << "k" << setw(14) << "scan" << setw(14) << "iterator" << setw(14) << "std::set" << "\n";
+
+    mt19937 rng(140);
+    long long checksum = 0;
+    for (unsigned int k = 1000; k <= max_keys && k <= 1000000; k *= 10) {
+        unsigned int scans = 10000000 / k;
+        vector<BinarySearchTree::DataType> starts(scans);
+        for (unsigned int i = 0; i < scans; ++i) starts[i] = rng() % (max_keys - k + 1);
+
+        Clock::time_point start = Clock::now();
+        for (unsigned int i = 0; i < scans; ++i) {
+            avl.scan(starts[i], starts[i] + k, [&](int key) { checksum += key; });
+        }
+        double scan_ns = elapsedNs(start) / ((double)scans * k);
+
+        start = Clock::now();
+        for (unsigned int i = 0; i < scans; ++i) {
+            AVLTree::iterator it = avl.lower_bound(starts[i]);
+            for (unsigned int j = 0; j < k; ++j, ++it) checksum += *it;
+        }
+        double iterator_ns = elapsedNs(start) / ((double)scans * k);
+
+        start = Clock::now();
+        for (unsigned int i = 0; i < scans; ++i) {
+            set<BinarySearchTree::DataType>::const_iterator it = std_set.lower_bound(starts[i]);
+            for (unsigned int j = 0; j < k; ++j, ++it) checksum += *it;
+        }
+        double set_ns = elapsedNs(start) / ((double)scans * k);
+
+        cout << setw(12) << k << setw(14) << fixed << setprecision(2) << scan_ns << setw(14) << iterator_ns
+             << setw(14) << set_ns << "\n";
+    }
+
+    // print the checksum so that the scans cannot be optimized away
+    cout << "(checksum " << checksum << ")\n" << endl;
+}
+
+// Fills a tree of one engine with the first n of keys in order, looks every one
+// of them up in the order of lookups, and removes them again, and prints the
+// time per operation of each phase and the nodes visited per lookup.
+template <class Tree>
+void benchmarkEngine(const char* name, const vector<BinarySearchTree::DataType>& keys,
+                     const vector<BinarySearchTree::DataType>& lookups, unsigned int n) {
+    Tree* tree = new Tree;
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int i = 0; i < n; ++i) tree->insert(keys[i]);
+    double insert_ns = elapsedNs(start) / n;
+
+    unsigned int found = 0;
+    double visited = 0;
+    start = Clock::now();
+    for (unsigned int i = 0; i < n; ++i) found += tree->exists(lookups[i]);
+    double exists_ns = elapsedNs(start) / n;
+    for (unsigned int i = 0; i < n; i += 97) {
+        tree->exists(lookups[i]);
+        visited += tree->nodesVisited();
+    }
+
+    start = Clock::now();
+    for (unsigned int i = 0; i < n; ++i) tree->remove(keys[i]);
+    double remove_ns = elapsedNs(start) / n;
+    delete tree;
+
+    cout << setw(12) << n << setw(12) << name << setw(14) << fixed << setprecision(1) << insert_ns << setw(14)
+         << exists_ns << setw(14) << remove_ns << setw(14) << visitsPerOperation(visited, (n + 96) / 97)
+         << (found == n ? "" : "  (lookups missed)") << "\n";
+}
+
+// Compares the pointer-per-key AVLTree with the BPlusTree, whose nodes hold many
+// keys each, and with the CompactAVLTree, whose nodes link by index, on random keys for sizes from 1000 up to max_keys. The lookups are
+// all hits, in a different random order than the inserts.
+void benchmarkEngines(unsigned int max_keys) {
+    cout << "AVL tree vs B+-tree vs compact AVL tree, random keys (ns/op)\n"
+         << setw(12) << "size" << setw(12) << "engine" << setw(14) << "insert" << setw(14) << "exists"
+         << setw(14) << "remove" << setw(14) << "nodes/lookup" << "\n";
+
+    for (unsigned int n = 1000; n <= max_keys; n *= 10) {
+        vector<BinarySearchTree::DataType> keys = makeKeys(n, true);
+        vector<BinarySearchTree::DataType> lookups = keys;
+        shuffle(lookups.begin(), lookups.end(), mt19937(141));
+
+        benchmarkEngine<AVLTree>("avl", keys, lookups, n);
+        benchmarkEngine<BPlusTree>("b+tree", keys, lookups, n);
+        benchmarkEngine<CompactAVLTree>("compact", keys, lookups, n);
+    }
+    cout << endl;
+}
+
+// Reports the memory per key of a CompactAVLTree of random keys, for sizes from
+// 1000 up to max_keys, next to the size of a node of AVLTree, which the pool
+// hands out with no further overhead.
+void benchmarkCompactMemory(unsigned int max_keys) {
+    cout << "Memory of compact AVL trees (bytes/key)\n"
+         << setw(12) << "size" << setw(14) << "avl" << setw(14) << "compact" << "\n";
+
+    for (unsigned int n = 1000; n <= max_keys; n *= 10) {
+        vector<BinarySearchTree::DataType> keys = makeKeys(n, true);
+        CompactAVLTree compact;
+        for (unsigned int i = 0; i < n; ++i) compact.insert(keys[i]);
+
+        cout << setw(12) << n << setw(14) << sizeof(AVLTree::Node) << setw(14) << fixed << setprecision(1)
+             << (double)compact.memoryUsed() / n << "\n";
+    }
+    cout << endl;
+}
+
+// Compares lookups that start from the index over the top levels of an AVLTree
+// with lookups that walk from the root, in a tree ordered by std::greater, which
+// has no index. The tree holds the even keys below 2n, and 9 of 10 lookups are
+// for odd keys, which miss.
+void benchmarkTopIndex(unsigned int max_keys) {
+    cout << "Lookups through the top-level index, 90% misses (ns/lookup)\n"
+         << setw(12) << "size" << setw(14) << "index" << setw(14) << "no index" << "\n";
+
+    for (unsigned int n = 1000; n <= max_keys; n *= 10) {
+        vector<BinarySearchTree::DataType> keys = makeKeys(n, true);
+        AVLTree indexed;
+        BasicAVLTree<int, greater<int> > plain;
+        for (unsigned int i = 0; i < n; ++i) {
+            indexed.insert(2 * keys[i]);
+            plain.insert(2 * keys[i]);
+        }
+
+        mt19937 rng(140);
+        vector<BinarySearchTree::DataType> lookups(1000000);
+        for (unsigned int i = 0; i < lookups.size(); ++i) lookups[i] = 2 * (rng() % n) + (i % 10 != 0);
+
+        unsigned int found = 0;
+        Clock::time_point start = Clock::now();
+        for (unsigned int i = 0; i < lookups.size(); ++i) found += indexed.exists(lookups[i]);
+        double indexed_ns = elapsedNs(start) / lookups.size();
+
+        start = Clock::now();
+        for (unsigned int i = 0; i < lookups.size(); ++i) found -= plain.exists(lookups[i]);
+        double plain_ns = elapsedNs(start) / lookups.size();
+
+        cout << setw(12) << n << setw(14) << fixed << setprecision(1) << indexed_ns << setw(14) << plain_ns
+             << (found == 0 ? "" : "  (lookups disagree)") << "\n";
+    }
+    cout << endl;
+}
+
+// Compares lookups in an AVLTree with lookups in the FrozenTree that freeze()
+// makes of it, for sizes from 1000 up to max_keys. The tree holds the even keys
+// below 2n, and half of the lookups miss. The memory is that of the nodes or
+// the array, per key.
+void benchmarkFrozen(unsigned int max_keys) {
+    cout << "Frozen trees (ns/lookup, bytes/key)\n"
+         << setw(12) << "size" << setw(14) << "freeze" << setw(14) << "tree" << setw(14) << "frozen"
+         << setw(14) << "tree bytes" << setw(14) << "frozen bytes" << "\n";
+
+    for (unsigned int n = 1000; n <= max_keys; n *= 10) {
+        vector<BinarySearchTree::DataType> keys = makeKeys(n, true);
+        AVLTree avl;
+        for (unsigned int i = 0; i < n; ++i) avl.insert(2 * keys[i]);
+
+        Clock::time_point start = Clock::now();
+        FrozenTree frozen = avl.freeze();
+        double freeze_ns = elapsedNs(start) / n;
+
+        mt19937 rng(140);
+        vector<BinarySearchTree::DataType> lookups(1000000);
+        for (unsigned int i = 0; i < lookups.size(); ++i) lookups[i] = rng() % (2 * n);
+
+        unsigned int found = 0;
+        start = Clock::now();
+        for (unsigned int i = 0; i < lookups.size(); ++i) found += avl.exists(lookups[i]);
+        double tree_ns = elapsedNs(start) / lookups.size();
+
+        start = Clock::now();
+        for (unsigned int i = 0; i < lookups.size(); ++i) found -= frozen.exists(lookups[i]);
+        double frozen_ns = elapsedNs(start) / lookups.size();
+
+        cout << setw(12) << n << setw(14) << fixed << setprecision(1) << freeze_ns << setw(14) << tree_ns
+             << setw(14) << frozen_ns << setw(14) << sizeof(AVLTree::Node) << setw(14)
+             << (double)frozen.memoryUsed() / n << (found == 0 ? "" : "  (lookups disagree)") << "\n";
+    }
+    cout << endl;
+}
+
+// Compares ways to bring back a tree of n random keys, for sizes from 1000 up to
+// max_keys: inserting the keys one by one, load() of a snapshot that save()
+// wrote, and mapping the snapshot with and without verifying it. Then compares
+// lookups in the loaded tree with lookups in the mapped file, half of them misses.
+void benchmarkSnapshots(unsigned int max_keys) {
+    string path = "/tmp/avl-bench-" + to_string(getpid()) + ".snapshot";
+    cout << "Snapshots (ms to start, ns/lookup)\n"
+         << setw(12) << "size" << setw(12) << "inserts" << setw(12) << "save" << setw(12) << "load"
+         << setw(12) << "map" << setw(12) << "map+verify" << setw(14) << "tree lookup" << setw(14) << "mapped lookup"
+         << "\n";
+
+    for (unsigned int n = 1000; n <= max_keys; n *= 10) {
+        vector<BinarySearchTree::DataType> keys = makeKeys(n, true);
+        for (unsigned int i = 0; i < n; ++i) keys[i] *= 2;
+
+        Clock::time_point start = Clock::now();
+        AVLTree* inserted = new AVLTree;
+        for (unsigned int i = 0; i < n; ++i) inserted->insert(keys[i]);
+        double insert_ms = elapsedNs(start) / 1e6;
+
+        start = Clock::now();
+        bool ok = inserted->save(path);
+        double save_ms = elapsedNs(start) / 1e6;
+        delete inserted;
+
+        AVLTree loaded;
+        start = Clock::now();
+        ok = ok && loaded.load(path);
+        double load_ms = elapsedNs(start) / 1e6;
+
+        MappedSnapshot mapped;
+        start = Clock::now();
+        ok = ok && mapped.open(path, false);
+        double map_ms = elapsedNs(start) / 1e6;
+        start = Clock::now();
+        ok = ok && mapped.open(path);
+        double verify_ms = elapsedNs(start) / 1e6;
+
+        mt19937 rng(140);
+        vector<BinarySearchTree::DataType> lookups(1000000);
+        for (unsigned int i = 0; i < lookups.size(); ++i) lookups[i] = rng() % (2 * n);
+
+        unsigned int found = 0;
+        start = Clock::now();
+        for (unsigned int i = 0; i < lookups.size(); ++i) found += loaded.exists(lookups[i]);
+        double tree_ns = elapsedNs(start) / lookups.size();
+        start = Clock::now();
+        for (unsigned int i = 0; i < lookups.size(); ++i) found -= mapped.exists(lookups[i]);
+        double mapped_ns = elapsedNs(start) / lookups.size();
+
+        cout << setw(12) << n << setw(12) << fixed << setprecision(1) << insert_ms << setw(12) << save_ms
+             << setw(12) << load_ms << setw(12) << map_ms << setw(12) << verify_ms << setw(14) << tree_ns
+             << setw(14) << mapped_ns << (!ok ? "  (snapshot failed)" : found == 0 ? "" : "  (lookups disagree)")
+             << "\n";
+    }
+    remove(path.c_str());
+    cout << endl;
+}
+
+// Compares inserting and then removing n shuffled keys in an AVLTree with doing
+// the same in a DurableAVLTree, up to the final sync(), for trees of up to 1M
+// keys. The durable tree pays for its log records and one fsync per group, and
+// compacts in the background once its log passes 64MB.
+void benchmarkDurable(unsigned int max_keys) {
+    string path = "/tmp/avl-bench-" + to_string(getpid()) + ".durable";
+    cout << "Durability (ns/op)\n"
+         << setw(12) << "size" << setw(12) << "memory" << setw(12) << "durable" << setw(12) << "ratio"
+         << setw(12) << "sync us" << setw(12) << "log MB" << "\n";
+
+    for (unsigned int n = 1000; n <= max_keys && n <= 1000000; n *= 10) {
+        vector<BinarySearchTree::DataType> keys = makeKeys(n, true);
+
+        Clock::time_point start = Clock::now();
+        AVLTree tree;
+        for (unsigned int i = 0; i < n; ++i) tree.insert(keys[i]);
+        for (unsigned int i = 0; i < n; ++i) tree.remove(keys[i]);
+        double memory_ns = elapsedNs(start) / (2.0 * n);
+
+        DurableAVLTree durable;
+        bool ok = durable.open(path);
+        start = Clock::now();
+        for (unsigned int i = 0; ok && i < n; ++i) durable.insert(keys[i]);
+        for (unsigned int i = 0; ok && i < n; ++i) durable.remove(keys[i]);
+        Clock::time_point synced = Clock::now();
+        ok = ok && durable.sync();
+        double sync_us = elapsedNs(synced) / 1e3;
+        double durable_ns = elapsedNs(start) / (2.0 * n);
+        double log_mb = durable.logBytes() / 1e6;
+        durable.close();
+
+        cout << setw(12) << n << setw(12) << fixed << setprecision(1) << memory_ns << setw(12) << durable_ns
+             << setw(12) << setprecision(2) << durable_ns / memory_ns << setw(12) << setprecision(1) << sync_us
+             << setw(12) << log_mb << (ok ? "" : "  (log failed)") << "\n";
+
+        remove((path + ".snapshot").c_str());
+        remove((path + ".wal").c_str());
+    }
+    cout << endl;
+}
+
+// Compares building a tree of max_keys sorted keys, and merging 8 trees that
+// interleave max_keys keys, with the sequential build_from_sorted and set_union
+// (threads 0) against their parallel versions on pools of 1 thread up to twice
+// the hardware threads. The parallel union merges all 8 trees in one call, and
+// the sequential one merges them one after another.
+void benchmarkParallel(unsigned int max_keys) {
+    const unsigned int TREES = 8;
+    vector<BinarySearchTree::DataType> keys = makeKeys(max_keys, false);
+    vector<vector<BinarySearchTree::DataType> > parts(TREES);
+    for (unsigned int i = 0; i < max_keys; ++i) parts[i % TREES].push_back(keys[i]);
+
+    cout << "Parallel build and union of " << max_keys << " keys (ns/key, "
+         << thread::hardware_concurrency() << " hardware threads)\n"
+         << setw(12) << "threads" << setw(14) << "build" << setw(14) << "union" << "\n";
+
+    unsigned int max_threads = 2 * max(1u, thread::hardware_concurrency());
+    for (unsigned int threads = 0; threads <= max_threads; threads = threads ? 2 * threads : 1) {
+        TaskPool pool(max(1u, threads));
+
+        AVLTree built;
+        Clock::time_point start = Clock::now();
+        if (threads == 0) built.build_from_sorted(keys.begin(), keys.end());
+        else built.build_from_sorted(keys.begin(), keys.end(), pool);
+        double build_ns = elapsedNs(start) / max_keys;
+
+        vector<AVLTree*> trees;
+        for (unsigned int t = 0; t < TREES; ++t) trees.push_back(new AVLTree(parts[t].begin(), parts[t].end()));
+        AVLTree merged;
+        start = Clock::now();
+        if (threads == 0) {
+            for (unsigned int t = 0; t < TREES; ++t) merged.set_union(*trees[t]);
+        }
+        else merged.set_union(trees, pool);
+        double union_ns = elapsedNs(start) / max_keys;
+        for (unsigned int t = 0; t < TREES; ++t) delete trees[t];
+
+        cout << setw(12) << threads << setw(14) << fixed << setprecision(1) << build_ns << setw(14) << union_ns << "\n";
+    }
+    cout << endl;
+}
+
+// Runs OPS operations split across threads threads on a tree holding every even
+// key below 2 * keys, where read_percent of them look up a random key and the rest
+// insert or remove one, and returns the throughput in millions of operations per
+// second. Tree is given exists, insert and remove, which may lock.
+template <class Tree>
+double runMixedOps(Tree& tree, unsigned int keys, unsigned int threads, unsigned int read_percent) {
+    const unsigned int OPS = 2000000;
+    vector<thread> workers;
+    Clock::time_point start = Clock::now();
+    for (unsigned int t = 0; t < threads; ++t) {
+        workers.push_back(thread([&tree, keys, threads, read_percent, t]() {
+            mt19937 rng(t);
+            for (unsigned int op = 0; op < OPS / threads; ++op) {
+                unsigned int key = rng() % (2 * keys);
+                unsigned int kind = rng() % 100;
+                if (kind < read_percent) tree.exists(key);
+                else if (kind % 2 == 0) tree.insert(key);
+                else tree.remove(key);
+            }
+        }));
+    }
+    for (unsigned int t = 0; t < threads; ++t) workers[t].join();
+    return OPS / (elapsedNs(start) / 1000);
+}
+
+// AVLTree behind one mutex, which is how a plain tree is shared between threads.
+struct LockedAVLTree {
+    AVLTree tree;
+    mutex lock;
+
+    bool exists(int key) { lock_guard<mutex> guard(lock); return tree.exists(key); }
+    bool insert(int key) { lock_guard<mutex> guard(lock); return tree.insert(key); }
+    bool remove(int key) { lock_guard<mutex> guard(lock); return tree.remove(key); }
+};
+
+// Compares the throughput of ConcurrentAVLTree against an AVLTree behind one mutex,
+// on a tree of up to 1M keys, from 1 thread up to twice the hardware threads, for
+// each read percentage in read_percents.
+void benchmarkConcurrent(unsigned int max_keys, const vector<unsigned int>& read_percents) {
+    unsigned int keys = min(max_keys, 1000000u);
+    vector<BinarySearchTree::DataType> initial = makeKeys(keys, true);
+
+    cout << "Concurrent reads and writes on " << keys << " keys (Mops/s, "
+         << thread::hardware_concurrency() << " hardware threads)\n"
+         << setw(12) << "reads %" << setw(12) << "threads" << setw(14) << "locked" << setw(14) << "concurrent" << "\n";
+
+    unsigned int max_threads = 2 * max(1u, thread::hardware_concurrency());
+    for (unsigned int read_percent : read_percents) {
+        for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+            LockedAVLTree locked;
+            ConcurrentAVLTree concurrent;
+            for (unsigned int i = 0; i < keys; ++i) {
+                locked.tree.insert(2 * initial[i]);
+                concurrent.insert(2 * initial[i]);
+            }
+
+            double locked_mops = runMixedOps(locked, keys, threads, read_percent);
+            double concurrent_mops = runMixedOps(concurrent, keys, threads, read_percent);
+            cout << setw(12) << read_percent << setw(12) << threads << setw(14) << fixed << setprecision(2)
+                 << locked_mops << setw(14) << concurrent_mops << "\n";
+        }
+    }
+    cout << endl;
+}
+
+// The operations the workloads time, each of them in its own histogram.
+enum Operation { OP_INSERT, OP_REMOVE, OP_EXISTS, OP_MIN, OP_MAX, OP_DEPTH, OPERATIONS };
+const char* const OPERATION_NAMES[OPERATIONS] = {"insert", "remove", "exists", "min", "max", "depth"};
+
+// Histogram of latencies in ns, with 16 buckets per power of two, so a
+// percentile is within 1/16 of the truth whatever the number of samples, and a
+// run of 100M operations records them in a few KB.
+class LatencyHistogram {
+public:
+    LatencyHistogram() : count_(0), total_ns_(0) {
+        for (unsigned int i = 0; i < BUCKETS; ++i) counts_[i] = 0;
+    }
+
+    void record(uint64_t ns) {
+        counts_[min(bucket(ns), BUCKETS - 1)]++;
+        count_++;
+        total_ns_ += ns;
+    }
+
+    uint64_t count() const { return count_; }
+    double totalNs() const { return total_ns_; }
+
+    // Returns the smallest latency of the bucket that holds the percentile p (0..1).
+    uint64_t percentile(double p) const {
+        uint64_t rank = (uint64_t)(p * count_), seen = 0;
+        for (unsigned int i = 0; i < BUCKETS; ++i) {
+            seen += counts_[i];
+            if (seen > rank) return lowest(i);
+        }
+        return 0;
+    }
+
+private:
+    static const unsigned int BUCKETS = 16 * 44;
+
+    // Latencies below 32 ns have a bucket each, and every power of two above is
+    // split into 16 buckets by the 4 bits below its highest bit.
+    static unsigned int bucket(uint64_t ns) {
+        if (ns < 32) return ns;
+        unsigned int high = 63 - __builtin_clzll(ns);
+        return (high - 4) * 16 + (unsigned int)(ns >> (high - 4));
+    }
+    static uint64_t lowest(unsigned int bucket) {
+        if (bucket < 32) return bucket;
+        return (uint64_t)(bucket % 16 + 16) << (bucket / 16 - 1);
+    }
+
+    uint64_t counts_[BUCKETS];
+    uint64_t count_;
+    double total_ns_;
+};
+
+// Draws ranks in [0, n) where rank k comes up in proportion to 1 / (k + 1)^theta,
+// with the method of Gray et al. that YCSB uses: O(n) to set up, and O(1) and no
+// memory per draw, so it scales to any n.
+class ZipfianGenerator {
+public:
+    ZipfianGenerator(unsigned int n, double theta, unsigned int seed)
+        : n_(n), theta_(theta), alpha_(1 / (1 - theta)), zetan_(0), rng_(seed), uniform_(0, 1) {
+        for (unsigned int i = 1; i <= n; ++i) zetan_ += 1 / pow((double)i, theta);
+        eta_ = (1 - pow(2.0 / n, 1 - theta)) / (1 - (1 + pow(0.5, theta)) / zetan_);
+    }
+
+    unsigned int next() {
+        double u = uniform_(rng_);
+        double uz = u * zetan_;
+        if (uz < 1) return 0;
+        if (uz < 1 + pow(0.5, theta_)) return 1;
+        return min(n_ - 1, (unsigned int)(n_ * pow(eta_ * u - eta_ + 1, alpha_)));
+    }
+
+private:
+    unsigned int n_;
+    double theta_, alpha_, zetan_, eta_;
+    mt19937 rng_;
+    uniform_real_distribution<double> uniform_;
+};
+
+// std::set with the operations of the trees, as the baseline of the workloads.
+struct StdSet {
+    set<BinarySearchTree::DataType> values;
+
+    bool insert(int key) { return values.insert(key).second; }
+    bool remove(int key) { return values.erase(key) == 1; }
+    bool exists(int key) const { return values.count(key) == 1; }
+    int min() const { return *values.begin(); }
+    int max() const { return *values.rbegin(); }
+    unsigned int size() const { return values.size(); }
+};
+
+// Whether a tree has depth() to time, which std::set does not.
+template <class Tree>
+struct HasDepth {
+    static const bool value = true;
+};
+template <>
+struct HasDepth<StdSet> {
+    static const bool value = false;
+};
+
+template <class Tree>
+unsigned int treeDepth(const Tree& tree) { return tree.depth(); }
+template <>
+unsigned int treeDepth<StdSet>(const StdSet& tree) { return 0; }
+
+enum Workload { SEQUENTIAL, REVERSE, RANDOM, ZIPFIAN, CHURN, MIXED, WORKLOADS };
+const char* const WORKLOAD_NAMES[WORKLOADS] = {"sequential", "reverse", "random", "zipfian", "churn", "mixed"};
+
+// The results of one operation in one run, which a run hands back through a
+// pipe, so plain data.
+struct OperationResult {
+    uint64_t count;
+    double total_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+};
+
+struct RunResult {
+    OperationResult operations[OPERATIONS];
+    long peak_rss_kb;
+    uint64_t checksum; // Sum of the results of the operations, so none is optimized away.
+};
+
+// Times single operations on a tree, taking off what reading the clock costs.
+template <class Tree>
+class TimedTree {
+public:
+    TimedTree(Tree& tree, double clock_ns) : tree_(tree), clock_ns_(clock_ns), checksum_(0) {}
+
+    void insert(int key) { Clock::time_point start = Clock::now(); checksum_ += tree_.insert(key); done(OP_INSERT, start); }
+    void remove(int key) { Clock::time_point start = Clock::now(); checksum_ += tree_.remove(key); done(OP_REMOVE, start); }
+    void exists(int key) { Clock::time_point start = Clock::now(); checksum_ += tree_.exists(key); done(OP_EXISTS, start); }
+    void min() { Clock::time_point start = Clock::now(); checksum_ += tree_.min(); done(OP_MIN, start); }
+    void max() { Clock::time_point start = Clock::now(); checksum_ += tree_.max(); done(OP_MAX, start); }
+    void depth() { Clock::time_point start = Clock::now(); checksum_ += treeDepth(tree_); done(OP_DEPTH, start); }
+
+    void report(RunResult& result) const {
+        for (unsigned int op = 0; op < OPERATIONS; ++op) {
+            OperationResult& out = result.operations[op];
+            out.count = histograms_[op].count();
+            out.total_ns = histograms_[op].totalNs();
+            out.p50_ns = histograms_[op].percentile(0.5);
+            out.p99_ns = histograms_[op].percentile(0.99);
+        }
+        result.checksum = checksum_;
+    }
+
+private:
+    void done(Operation op, Clock::time_point start) {
+        double ns = elapsedNs(start) - clock_ns_;
+        histograms_[op].record(ns > 0 ? (uint64_t)ns : 0);
+    }
+
+    Tree& tree_;
+    double clock_ns_;
+    uint64_t checksum_;
+    LatencyHistogram histograms_[OPERATIONS];
+};
+
+// Times the tree's min, max and, once as it walks the whole tree, depth.
+template <class Tree>
+void timeExtremes(TimedTree<Tree>& timed, unsigned int times) {
+    for (unsigned int i = 0; i < times; ++i) {
+        timed.min();
+        timed.max();
+    }
+    if (HasDepth<Tree>::value) timed.depth();
+}
+
+// Runs one workload of n keys on a new tree, timing every operation on it:
+//   sequential, reverse, random: inserts the keys 0..n-1 ascending, descending or
+//     shuffled, looks each up and removes each in the same order.
+//   zipfian: inserts n shuffled keys, then looks up n keys drawn with a Zipfian
+//     skew (theta 0.99), the hottest keys scattered over the key range.
+//   churn: inserts n keys untimed, then n operations that remove the oldest key
+//     two times out of three and insert a new one the third, so the tree shrinks.
+//   mixed: inserts n of the keys below 2n untimed, then n operations on random
+//     keys below 2n: 70% exists, 10% insert, 10% remove, 5% min and 5% max.
+template <class Tree>
+void runWorkload(Workload workload, unsigned int n, double clock_ns, RunResult& result) {
+    Tree* tree = new Tree;
+    TimedTree<Tree> timed(*tree, clock_ns);
+    vector<BinarySearchTree::DataType> keys;
+
+    switch (workload) {
+    case SEQUENTIAL:
+    case REVERSE:
+    case RANDOM:
+        keys = makeKeys(n, workload == RANDOM);
+        if (workload == REVERSE) reverse(keys.begin(), keys.end());
+        for (unsigned int i = 0; i < n; ++i) timed.insert(keys[i]);
+        for (unsigned int i = 0; i < n; ++i) timed.exists(keys[i]);
+        timeExtremes(timed, min(n, 100000u));
+        for (unsigned int i = 0; i < n; ++i) timed.remove(keys[i]);
+        break;
+
+    case ZIPFIAN: {
+        keys = makeKeys(n, true);
+        for (unsigned int i = 0; i < n; ++i) timed.insert(keys[i]);
+        ZipfianGenerator zipf(n, 0.99, 140);
+        for (unsigned int i = 0; i < n; ++i) timed.exists(keys[zipf.next()]);
+        break;
+    }
+
+    case CHURN:
+        keys = makeKeys(2 * n, true);
+        for (unsigned int i = 0; i < n; ++i) tree->insert(keys[i]);
+        for (unsigned int i = 0, removed = 0, added = n; i < n; ++i) {
+            if (i % 3 == 2) timed.insert(keys[added++]);
+            else timed.remove(keys[removed++]);
+        }
+        break;
+
+    case MIXED: {
+        keys = makeKeys(2 * n, true);
+        for (unsigned int i = 0; i < n; ++i) tree->insert(keys[i]);
+        mt19937 rng(140);
+        for (unsigned int i = 0; i < n; ++i) {
+            unsigned int kind = rng() % 100, key = rng() % (2 * n);
+            if (kind < 70) timed.exists(key);
+            else if (kind < 80) timed.insert(key);
+            else if (kind < 90) timed.remove(key);
+            else if (tree->size() == 0) continue;
+            else if (kind < 95) timed.min();
+            else timed.max();
+        }
+        timeExtremes(timed, 0);
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    timed.report(result);
+    delete tree;
+}
+
+// Runs a workload in a child process, so that the peak RSS it reports is that of
+// the run alone, and sets result. Returns false if the child failed.
+template <class Tree>
+bool runIsolated(Workload workload, unsigned int n, double clock_ns, RunResult& result) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    cout.flush();
+
+    pid_t child = fork();
+    if (child < 0) return false;
+    if (child == 0) {
+        close(fds[0]);
+        RunResult run = RunResult();
+        runWorkload<Tree>(workload, n, clock_ns, run);
+
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        run.peak_rss_kb = usage.ru_maxrss / 1024;
+#else
+        run.peak_rss_kb = usage.ru_maxrss;
+#endif
+        ssize_t written = write(fds[1], &run, sizeof(run));
+        _exit(written == sizeof(run) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    size_t got = 0;
+    while (got < sizeof(result)) {
+        ssize_t part = read(fds[0], reinterpret_cast<char*>(&result) + got, sizeof(result) - got);
+        if (part <= 0) break;
+        got += part;
+    }
+    close(fds[0]);
+
+    int status;
+    waitpid(child, &status, 0);
+    return got == sizeof(result) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Returns what reading the clock costs, in ns, which every timed operation pays
+// on top of its own cost.
+double clockOverheadNs() {
+    const unsigned int READS = 1000000;
+    Clock::time_point start = Clock::now();
+    for (unsigned int i = 0; i < READS; ++i) Clock::now();
+    return elapsedNs(start) / READS;
+}
+
+enum ReportFormat { TABLE, CSV, JSON };
+
+// Prints the rows of the workload suite as a table, CSV or a JSON array.
+class WorkloadReport {
+public:
+    explicit WorkloadReport(ReportFormat format) : format_(format), rows_(0) {}
+
+    void begin(double clock_ns) {
+        if (format_ == TABLE) {
+            cout << "Workloads (clock overhead of " << fixed << setprecision(1) << clock_ns
+                 << " ns taken off every operation)\n"
+                 << setw(12) << "workload" << setw(12) << "size" << setw(10) << "engine" << setw(8) << "op"
+                 << setw(12) << "count" << setw(14) << "ops/s" << setw(10) << "p50 ns" << setw(10) << "p99 ns"
+                 << setw(14) << "peak RSS MB" << "\n";
+        }
+        else if (format_ == CSV) cout << "workload,size,engine,op,count,ops_per_sec,p50_ns,p99_ns,peak_rss_kb\n";
+        else cout << "[";
+    }
+
+    void row(Workload workload, unsigned int n, const char* engine, Operation op, const RunResult& run) {
+        const OperationResult& result = run.operations[op];
+        double ops_per_sec = result.total_ns > 0 ? result.count / result.total_ns * 1e9 : 0;
+
+        if (format_ == TABLE) {
+            cout << setw(12) << WORKLOAD_NAMES[workload] << setw(12) << n << setw(10) << engine << setw(8)
+                 << OPERATION_NAMES[op] << setw(12) << result.count << setw(14) << fixed << setprecision(0)
+                 << ops_per_sec << setw(10) << result.p50_ns << setw(10) << result.p99_ns << setw(14)
+                 << setprecision(1) << run.peak_rss_kb / 1024.0 << "\n";
+        }
+        else if (format_ == CSV) {
+            cout << WORKLOAD_NAMES[workload] << ',' << n << ',' << engine << ',' << OPERATION_NAMES[op] << ','
+                 << result.count << ',' << fixed << setprecision(0) << ops_per_sec << ',' << result.p50_ns << ','
+                 << result.p99_ns << ',' << run.peak_rss_kb << "\n";
+        }
+        else {
+            cout << (rows_ == 0 ? "\n" : ",\n") << "  {\"workload\": \"" << WORKLOAD_NAMES[workload]
+                 << "\", \"size\": " << n << ", \"engine\": \"" << engine << "\", \"op\": \""
+                 << OPERATION_NAMES[op] << "\", \"count\": " << result.count << ", \"ops_per_sec\": " << fixed
+                 << setprecision(0) << ops_per_sec << ", \"p50_ns\": " << result.p50_ns << ", \"p99_ns\": "
+                 << result.p99_ns << ", \"peak_rss_kb\": " << run.peak_rss_kb << "}";
+        }
+        rows_++;
+    }
+
+    void end() {
+        if (format_ == TABLE) cout << endl;
+        else if (format_ == JSON) cout << "\n]" << endl;
+    }
+
+private:
+    ReportFormat format_;
+    unsigned int rows_;
+};
+
+// Runs one workload in a process of its own and prints a row for every
+// operation it timed.
+template <class Tree>
+void runWorkloadRows(WorkloadReport& report, Workload workload, unsigned int n, const char* engine, double clock_ns) {
+    RunResult run;
+    if (!runIsolated<Tree>(workload, n, clock_ns, run)) {
+        cerr << "avl-bench: the " << WORKLOAD_NAMES[workload] << " run of " << n << " keys on " << engine
+             << " failed" << endl;
+        return;
+    }
+    for (unsigned int op = 0; op < OPERATIONS; ++op) {
+        if (run.operations[op].count > 0) report.row(workload, n, engine, (Operation)op, run);
+    }
+}
+
+// Runs every workload on the AVLTree and on std::set, for sizes from 1000 up to
+// max_keys in steps of 10x, each run in a process of its own, and prints a row
+// for every operation a run timed. Every workload draws its keys from fixed
+// seeds, so two runs of the suite do the same operations in the same order.
+void benchmarkWorkloads(unsigned int max_keys, ReportFormat format) {
+    double clock_ns = clockOverheadNs();
+    WorkloadReport report(format);
+    report.begin(clock_ns);
+
+    for (unsigned int n = 1000; n <= max_keys; n *= 10) {
+        for (unsigned int workload = 0; workload < WORKLOADS; ++workload) {
+            runWorkloadRows<AVLTree>(report, (Workload)workload, n, "avl", clock_ns);
+            runWorkloadRows<StdSet>(report, (Workload)workload, n, "std::set", clock_ns);
+        }
+    }
+    report.end();
+}
+
+
+//======================================================================
+//================================ MAIN ================================
+//======================================================================
+int main(int argc, char** argv) {
+
+    // "avl-bench workloads [max_keys [table|csv|json]]" runs the workload suite
+    // alone, with its rows in the format given, a table by default.
+    if (argc > 1 && strcmp(argv[1], "workloads") == 0) {
+        unsigned int max_keys = 1000000;
+        if (argc > 2) max_keys = max(1000ul, strtoul(argv[2], nullptr, 10));
+        ReportFormat format = TABLE;
+        if (argc > 3 && strcmp(argv[3], "csv") == 0) format = CSV;
+        else if (argc > 3 && strcmp(argv[3], "json") == 0) format = JSON;
+        benchmarkWorkloads(max_keys, format);
+        return 0;
+    }
+
+    // The largest tree to build, 10M keys unless given on the command line.
+    unsigned int max_keys = 10000000;
+    if (argc > 1) max_keys = strtoul(argv[1], nullptr, 10);
+    if (max_keys < 1000) max_keys = 1000;
+
+    // The percentage of reads for the concurrent benchmark, which tries a few
+    // mixes unless one is given after the size.
+    vector<unsigned int> read_percents = {100, 90, 50};
+    if (argc > 2) read_percents.assign(1, min(100ul, strtoul(argv[2], nullptr, 10)));
+
+    benchmarkScaling("Sequential", max_keys, false);
+    benchmarkScaling("Random", max_keys, true);
+    benchmarkAllocators(max_keys);
+    benchmarkBulkBuild(max_keys);
+    benchmarkBatches(max_keys);
+    benchmarkUnion(max_keys);
+    benchmarkRangeScans(max_keys);
+    benchmarkEngines(max_keys);
+    benchmarkCompactMemory(max_keys);
+    benchmarkTopIndex(max_keys);
+    benchmarkFrozen(max_keys);
+    benchmarkSnapshots(max_keys);
+    benchmarkDurable(max_keys);
+    benchmarkParallel(max_keys);
+    benchmarkConcurrent(max_keys, read_percents);
+
+    return 0;
+}
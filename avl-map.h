@@ -0,0 +1,245 @@
+#ifndef LAB3_AVL_MAP_H
+#define LAB3_AVL_MAP_H
+
+#include <functional>
+#include <tuple>
+#include <utility>
+
+#include "avl-tree.h"
+
+// Orders the key/value pairs of a map by their keys. A pair can also be compared
+// directly with a key, so lookups never have to build a pair.
+template <class Key, class Value, class Compare>
+struct MapKeyCompare {
+    typedef std::pair<const Key, Value> value_type;
+
+    Compare compare;
+
+    bool operator()(const value_type& a, const value_type& b) const { return compare(a.first, b.first); }
+    bool operator()(const Key& a, const value_type& b) const { return compare(a, b.first); }
+    bool operator()(const value_type& a, const Key& b) const { return compare(a.first, b); }
+};
+
+// Ordered map from Key to Value, stored as key/value pairs in the nodes of an
+// AVL tree. Every operation does a single descent of the tree, and values are
+// constructed in their node rather than copied or moved into it. The tree is a
+// private base, since its set operations on pairs make no sense for a map; only
+// the operations below are part of the map.
+template <class Key, class Value, class Compare = std::less<Key>,
+          class Allocator = NodePool<std::pair<const Key, Value> > >
+class BasicAVLMap : private BasicAVLTree<std::pair<const Key, Value>, MapKeyCompare<Key, Value, Compare>, Allocator> {
+public:
+    typedef Key key_type;
+    typedef Value mapped_type;
+    typedef std::pair<const Key, Value> value_type;
+    typedef BasicAVLTree<value_type, MapKeyCompare<Key, Value, Compare>, Allocator> Tree;
+    typedef typename Tree::Node Node;
+
+    // Iterators visit the pairs in key order, and the values can be changed through
+    // a (non-const) iterator.
+    typedef TreeIterator<Node, value_type> iterator;
+    typedef TreeIterator<Node, const value_type> const_iterator;
+
+    // Returns iterators to the pair with the smallest key, and to past the largest.
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // Returns an iterator to the first pair whose key is not less than key
+    // (lower_bound) or greater than key (upper_bound), or end() if there is none.
+    iterator lower_bound(const Key& key);
+    iterator upper_bound(const Key& key);
+    const_iterator lower_bound(const Key& key) const;
+    const_iterator upper_bound(const Key& key) const;
+
+    // Returns the range of pairs whose key is equivalent to key, which is empty
+    // or holds one pair.
+    std::pair<iterator, iterator> equal_range(const Key& key);
+
+    // Calls visit(pair) for every pair whose key is in [lo, hi) in order. This
+    // takes O(log n + k) for k pairs and never allocates.
+    template <class Visitor>
+    void scan(const Key& lo, const Key& hi, Visitor visit) const;
+
+    // Returns a pointer to the value mapped to key, or nullptr if key is not in the map.
+    Value* find(const Key& key);
+    const Value* find(const Key& key) const;
+
+    // Constructs a key/value pair from args in a new node, and links it in if its key
+    // is not in the map yet (otherwise the new pair is destroyed). Returns the value
+    // mapped to the key and whether it was inserted.
+    template <class... Args>
+    std::pair<Value*, bool> emplace(Args&&... args);
+
+    // Inserts key with a value constructed from args if key is not in the map yet.
+    // If it is, nothing is constructed and args are left untouched. Returns the value
+    // mapped to key and whether it was inserted.
+    template <class... Args>
+    std::pair<Value*, bool> try_emplace(const Key& key, Args&&... args);
+    template <class... Args>
+    std::pair<Value*, bool> try_emplace(Key&& key, Args&&... args);
+
+    // Maps key to value, inserting key if it is not in the map yet and assigning to
+    // the existing value otherwise. Returns the value and whether key was inserted.
+    template <class V>
+    std::pair<Value*, bool> insert_or_assign(const Key& key, V&& value);
+    template <class V>
+    std::pair<Value*, bool> insert_or_assign(Key&& key, V&& value);
+
+    // Returns the value mapped to key, inserting a default-constructed value first
+    // if key is not in the map yet.
+    Value& operator[](const Key& key);
+    Value& operator[](Key&& key);
+
+    // Removes key and its value from the map. Returns true if key was in the map,
+    // and false otherwise.
+    bool erase(const Key& key);
+
+    // The operations of the tree that mean the same for a map.
+    using Tree::clear;
+    using Tree::size;
+    using Tree::depth;
+    using Tree::nodesVisited;
+    using Tree::stats;
+    using Tree::resetStats;
+
+private:
+    friend class AVLMapTest;
+};
+
+// Ordered map with the default comparator and pooled nodes.
+template <class Key, class Value>
+using AVLMap = BasicAVLMap<Key, Value>;
+
+template <class Key, class Value, class Compare, class Allocator>
+typename BasicAVLMap<Key, Value, Compare, Allocator>::iterator BasicAVLMap<Key, Value, Compare, Allocator>::begin() {
+    return iterator(Tree::begin().node(), &this->root_);
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+typename BasicAVLMap<Key, Value, Compare, Allocator>::iterator BasicAVLMap<Key, Value, Compare, Allocator>::end() {
+    return iterator(nullptr, &this->root_);
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+typename BasicAVLMap<Key, Value, Compare, Allocator>::const_iterator BasicAVLMap<Key, Value, Compare, Allocator>::begin() const {
+    return Tree::begin();
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+typename BasicAVLMap<Key, Value, Compare, Allocator>::const_iterator BasicAVLMap<Key, Value, Compare, Allocator>::end() const {
+    return Tree::end();
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+typename BasicAVLMap<Key, Value, Compare, Allocator>::iterator BasicAVLMap<Key, Value, Compare, Allocator>::lower_bound(const Key& key) {
+    return iterator(this->lowerBoundNode(key), &this->root_);
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+typename BasicAVLMap<Key, Value, Compare, Allocator>::iterator BasicAVLMap<Key, Value, Compare, Allocator>::upper_bound(const Key& key) {
+    return iterator(this->upperBoundNode(key), &this->root_);
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+typename BasicAVLMap<Key, Value, Compare, Allocator>::const_iterator BasicAVLMap<Key, Value, Compare, Allocator>::lower_bound(const Key& key) const {
+    return const_iterator(this->lowerBoundNode(key), &this->root_);
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+typename BasicAVLMap<Key, Value, Compare, Allocator>::const_iterator BasicAVLMap<Key, Value, Compare, Allocator>::upper_bound(const Key& key) const {
+    return const_iterator(this->upperBoundNode(key), &this->root_);
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+std::pair<typename BasicAVLMap<Key, Value, Compare, Allocator>::iterator, typename BasicAVLMap<Key, Value, Compare, Allocator>::iterator>
+BasicAVLMap<Key, Value, Compare, Allocator>::equal_range(const Key& key) {
+    iterator first = lower_bound(key);
+    iterator last = first;
+    if (last != end() && !this->compare_(key, *last)) ++last;
+    return std::make_pair(first, last);
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+template <class Visitor>
+void BasicAVLMap<Key, Value, Compare, Allocator>::scan(const Key& lo, const Key& hi, Visitor visit) const {
+    this->scanRange(lo, hi, visit);
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+Value* BasicAVLMap<Key, Value, Compare, Allocator>::find(const Key& key) {
+    Node* n = this->findNode(key);
+    return n != nullptr ? &n->val.second : nullptr;
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+const Value* BasicAVLMap<Key, Value, Compare, Allocator>::find(const Key& key) const {
+    Node* n = this->findNode(key);
+    return n != nullptr ? &n->val.second : nullptr;
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+template <class... Args>
+std::pair<Value*, bool> BasicAVLMap<Key, Value, Compare, Allocator>::emplace(Args&&... args) {
+
+    // the key is only known once the pair is built, so build it first
+    Node* n = this->newNode(std::forward<Args>(args)...);
+    std::pair<Node*, bool> result = this->insertUnique(n->val.first, [n]() { return n; });
+
+    if (!result.second) this->deleteNode(n);
+    return std::make_pair(&result.first->val.second, result.second);
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+template <class... Args>
+std::pair<Value*, bool> BasicAVLMap<Key, Value, Compare, Allocator>::try_emplace(const Key& key, Args&&... args) {
+    std::pair<Node*, bool> result = this->insertUnique(key, [&]() {
+        return this->newNode(std::piecewise_construct, std::forward_as_tuple(key),
+                             std::forward_as_tuple(std::forward<Args>(args)...));
+    });
+    return std::make_pair(&result.first->val.second, result.second);
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+template <class... Args>
+std::pair<Value*, bool> BasicAVLMap<Key, Value, Compare, Allocator>::try_emplace(Key&& key, Args&&... args) {
+    std::pair<Node*, bool> result = this->insertUnique(key, [&]() {
+        return this->newNode(std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                             std::forward_as_tuple(std::forward<Args>(args)...));
+    });
+    return std::make_pair(&result.first->val.second, result.second);
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+template <class V>
+std::pair<Value*, bool> BasicAVLMap<Key, Value, Compare, Allocator>::insert_or_assign(const Key& key, V&& value) {
+    std::pair<Value*, bool> result = try_emplace(key, std::forward<V>(value));
+    if (!result.second) *result.first = std::forward<V>(value);
+    return result;
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+template <class V>
+std::pair<Value*, bool> BasicAVLMap<Key, Value, Compare, Allocator>::insert_or_assign(Key&& key, V&& value) {
+    std::pair<Value*, bool> result = try_emplace(std::move(key), std::forward<V>(value));
+    if (!result.second) *result.first = std::forward<V>(value);
+    return result;
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+Value& BasicAVLMap<Key, Value, Compare, Allocator>::operator[](const Key& key) {
+    return *try_emplace(key).first;
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+Value& BasicAVLMap<Key, Value, Compare, Allocator>::operator[](Key&& key) {
+    return *try_emplace(std::move(key)).first;
+}
+
+template <class Key, class Value, class Compare, class Allocator>
+bool BasicAVLMap<Key, Value, Compare, Allocator>::erase(const Key& key) {
+    return this->removeKey(key);
+}
+
+#endif
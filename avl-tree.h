@@ -1,22 +1,1011 @@
 #ifndef LAB3_AVL_TREE_H
 #define LAB3_AVL_TREE_H
 
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
 #include "binary-search-tree.h"
 
-class AVLTree : public BinarySearchTree {
+// Self-balancing binary search tree, with the same keys, comparators, node
+// allocators and node policies as BasicBinarySearchTree.
+template <class Key, class Compare = std::less<Key>, class Allocator = NodePool<Key>,
+          class Augment = NoSubtreeSize>
+class BasicAVLTree : public BasicBinarySearchTree<Key, Compare, Allocator, Augment> {
 public:
-    bool insert(DataType val);
-    bool remove(DataType val);
+    typedef typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::DataType DataType;
+    typedef typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::Node Node;
+    typedef typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::KeyParam KeyParam;
+
+    BasicAVLTree() {}
+
+    // Constructs a tree holding the values in [first, last), as build() does. The
+    // tree is perfectly balanced, and built in O(n) if the values are sorted.
+    template <class ForwardIt>
+    BasicAVLTree(ForwardIt first, ForwardIt last)
+        : BasicBinarySearchTree<Key, Compare, Allocator, Augment>(first, last) {}
+
+    bool insert(const DataType& val);
+    bool insert(DataType&& val);
+    bool remove(KeyParam val);
+
+    // Inserts every value of the batch [first, last) in one pass over the tree: the
+    // batch is sorted, split around each node on the way down, and every touched
+    // subtree is rebalanced once on the way back up, in O(m log(n/m + 1)) for m
+    // values. Returns one flag per value of the batch, in batch order, that is true
+    // if the value was inserted and false if it was already in the tree (or earlier
+    // in the batch).
+    template <class RandomIt>
+    std::vector<bool> insert_batch(RandomIt first, RandomIt last);
+
+    // Removes every value of the batch [first, last) in one pass over the tree, like
+    // insert_batch. Returns one flag per value of the batch, in batch order, that is
+    // true if the value was removed and false if it was not in the tree (or earlier
+    // in the batch).
+    template <class RandomIt>
+    std::vector<bool> erase_batch(RandomIt first, RandomIt last);
+
+    // Moves the values less than key into left and the values greater than key into
+    // right, leaving this tree empty, and destroys the value equivalent to key if
+    // there is one. Returns whether there was. Whatever left and right held before
+    // is removed, and they share this tree's nodes (and node pool) afterwards.
+    // left or right can be this tree itself, but not each other. Takes O(log n)
+    // with Augment = SubtreeSize; otherwise the smaller half is also counted, in
+    // O(log n + min(left.size(), right.size())).
+    bool split(KeyParam key, BasicAVLTree& left, BasicAVLTree& right);
+
+    // Replaces the values of this tree with the values of left, then key, then the
+    // values of right, leaving left and right empty. Every value in left must be
+    // less than key, and every value in right greater. Takes O(log n) when left and
+    // right share a node pool (e.g. after a split); otherwise the values of the
+    // smaller one are moved into the pool of the larger first.
+    void join(BasicAVLTree& left, KeyParam key, BasicAVLTree& right);
+
+    // Set operations that change this tree in place: set_union adds every value
+    // of other, leaving other empty; set_intersection keeps only the values that
+    // are also in other; and set_difference removes every value that is in other.
+    // For trees of m and n values (m <= n), each takes O(m log(n/m + 1)), plus
+    // O(m) for set_union to move the values of the smaller tree into the pool of
+    // the larger one if they do not already share a pool.
+    void set_union(BasicAVLTree& other);
+    void set_intersection(const BasicAVLTree& other);
+    void set_difference(const BasicAVLTree& other);
+
+    // Adds every value of the trees in others, leaving them empty, in parallel on
+    // the workers of pool: halves of the list are merged at the same time, and so
+    // are the two halves of every union of subtrees both taller than log2(grain).
+    // Smaller unions run as in set_union. Every tree is first moved into this
+    // tree's node pool, which takes O(1) per slab for an unshared NodePool.
+    // Defined in parallel-avl-tree.h.
+    void set_union(const std::vector<BasicAVLTree*>& others, TaskPool& pool, unsigned int grain = 1 << 14);
+
+protected:
+
+    // Searches for key, and if no equivalent key is in the tree yet, links in the
+    // node returned by create() and rebalances. Returns the node holding key and
+    // whether it was created. Rotations never move a node's contents, so the
+    // returned node stays valid.
+    template <class K, class Create>
+    std::pair<Node*, bool> insertUnique(const K& key, Create create);
+
+    // Removes the node holding a key equivalent to key. Returns true if successful,
+    // and false otherwise.
+    template <class K>
+    bool removeKey(const K& key);
+
+    // Returns the height of the tree (-1 if it is empty) in O(log n), following the
+    // cached balances down the taller side.
+    int treeHeight() const;
+
+    // Joins the subtrees left and right, of the given heights, with the node middle
+    // between them. Every key in left must be less than middle's, and every key in
+    // right greater. Returns the root of the joined tree and sets joined_height to
+    // its height, in O(|left_height - right_height| + 1).
+    Node* join(Node* left, int left_height, Node* middle, Node* right, int right_height, int& joined_height);
+
+    // Joins the subtrees left and right, of the given heights, where every key in left
+    // is less than every key in right, using the largest node of left as the middle.
+    Node* join(Node* left, int left_height, Node* right, int right_height, int& joined_height);
+
+    // Unlinks the largest node of the subtree root, of the given height, into last.
+    // Returns the root of what is left and sets rest_height to its height.
+    Node* removeLast(Node* root, int height, Node*& last, int& rest_height);
+
+    // Splits the subtree root, of the given height, into the nodes less than key
+    // (left) and the nodes greater than key (right), and sets their heights. Returns
+    // the node equivalent to key, unlinked from both, or nullptr if there is none.
+    template <class K>
+    Node* splitNode(Node* root, int height, const K& key, Node*& left, int& left_height,
+                    Node*& right, int& right_height);
 
 private:
+    typedef typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::NodeAllocator NodeAllocator;
+
+    // Makes this tree and other share a node pool. The pool of the smaller tree is
+    // handed to the larger one's as in adoptPool.
+    void sharePool(BasicAVLTree& other);
+
+    // Makes other share this tree's node pool: splices other's pool into it if
+    // adoptAll can, and otherwise moves the values of other into new nodes from it.
+    void adoptPool(BasicAVLTree& other);
+
+    // Copies the subtree n, moving its values, into new nodes from pool and returns
+    // the copy, with parent as the parent of its root.
+    static Node* moveSubtree(Node* n, Node* parent, NodeAllocator& pool);
+
+    // Merge the subtrees a and b, of the given heights, into one subtree of the
+    // values in both (unionNodes), the values of a that are also in b
+    // (intersectNodes), or the values of a that are not in b (subtractNodes).
+    // They return the root of the result and set merged_height to its height, and
+    // only unionNodes takes nodes from b. The nodes of b whose values are already
+    // in a are not freed but pushed onto discarded, linked through their left
+    // pointers, so that a union touches no allocator.
+    Node* unionNodes(Node* a, int a_height, Node* b, int b_height, int& merged_height, Node*& discarded);
+    Node* intersectNodes(Node* a, int a_height, Node* b, int b_height, int& merged_height);
+    Node* subtractNodes(Node* a, int a_height, Node* b, int b_height, int& merged_height);
+
+    // Like unionNodes, but merges the two halves in parallel on the workers of pool
+    // while both subtrees are at least min_height tall. Each worker pushes the
+    // nodes it discards onto discarded[its worker index].
+    Node* unionNodesParallel(Node* a, int a_height, Node* b, int b_height, int& merged_height,
+                             std::vector<Node*>& discarded, TaskPool& pool, int min_height);
+
+    // Merges the count subtrees at roots, of the given heights, in parallel, with
+    // the values of earlier subtrees kept over equivalent ones of later subtrees.
+    Node* unionTrees(Node** roots, int* heights, unsigned int count, int& merged_height,
+                     std::vector<Node*>& discarded, TaskPool& pool, int min_height);
+
+    // Frees every node of a list linked through left pointers and returns how many there were.
+    unsigned int deleteList(Node* list);
+
+    // Returns the indices of the batch [first, last) sorted by their values, keeping
+    // only the first index of each run of equivalent values.
+    template <class RandomIt>
+    std::vector<unsigned int> sortedBatch(RandomIt first, RandomIt last) const;
+
+    // Merges the sorted batch indices [lo, hi) into the subtree root of the given
+    // height, setting the flag of every index that is inserted (insertBatch) or
+    // removed (eraseBatch). Returns the new root and sets merged_height to its height.
+    template <class RandomIt>
+    Node* insertBatch(Node* root, int height, const unsigned int* lo, const unsigned int* hi,
+                      RandomIt batch, std::vector<bool>& flags, int& merged_height);
+    template <class RandomIt>
+    Node* eraseBatch(Node* root, int height, const unsigned int* lo, const unsigned int* hi,
+                     RandomIt batch, std::vector<bool>& flags, int& merged_height);
+
+    // Inserts val into the tree, moving it into the new node if it is an rvalue.
+    template <class K>
+    bool insertValue(K&& val);
+
+    // An AVL tree with fewer than 2^32 nodes is never taller than this, so a path
+    // from the root to any node fits in a fixed array on the stack.
+    static const int MAX_HEIGHT = 64;
 
     static bool isBalanced(Node* node); // function to determine whether the tree is balanced
-    void balanceSubTree(Node* alpha); // function to balance a subtree
-    static Node* search(Node* root, DataType val); // function that returns a pointer to a given Node
-    void rotateRight(Node* root);
-    void rotateLeft(Node* root);
-    void rotateLeftRight(Node* root);
-    void rotateRightLeft(Node* root);
+    Node* balanceSubTree(Node** link); // function to balance a subtree, returns its new root
+
+    // Rotations take the link that owns the subtree root (the parent's child pointer,
+    // or the root pointer), so they run in O(1) and update the link in place.
+    void rotateRight(Node** link);
+    void rotateLeft(Node** link);
+    void rotateLeftRight(Node** link);
+    void rotateRightLeft(Node** link);
 };
 
+// The tree of ints with pooled nodes, the one that allocates each node with new,
+// and the one that keeps subtree sizes for rank, select and count_range.
+typedef BasicAVLTree<int> AVLTree;
+typedef BasicAVLTree<int, std::less<int>, std::allocator<int> > HeapAVLTree;
+typedef BasicAVLTree<int, std::less<int>, NodePool<int>, SubtreeSize> OrderStatisticAVLTree;
+
+/**
+ * Returns whether a given node is balanced, using its cached balance factor
+ */
+template <class Key, class Compare, class Allocator, class Augment>
+bool BasicAVLTree<Key, Compare, Allocator, Augment>::isBalanced(Node *T)
+{
+    if (T == nullptr) return true;
+    return std::abs(T->avlBalance) < 2;
+}
+
+
+/**
+ * Balances the unbalanced subtree owned by link and returns its new root
+ */
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicAVLTree<Key, Compare, Allocator, Augment>::Node* BasicAVLTree<Key, Compare, Allocator, Augment>::balanceSubTree(Node** link) {
+    Node* alpha = *link;
+    this->stats_.rebalanced();
+
+    // Case 1 & 3: alpha is left heavy
+    if (alpha->avlBalance < 0) {
+
+        // Case 1: A is left heavy (or left/right same height)
+        if (alpha->left->avlBalance <= 0) rotateRight(link);
+
+        // Case 3: A is right heavy
+        else rotateLeftRight(link);
+    }
+
+    // Case 2 & 4: alpha is right heavy
+    else {
+
+        // Case 2: A is right heavy (or left/right same height)
+        if (alpha->right->avlBalance >= 0) rotateLeft(link);
+
+        // Case 4: A is left heavy
+        else rotateRightLeft(link);
+    }
+
+    return *link;
+}
+
+/**
+ * AVL Insert function that maintains the balance of a tree after inserting a node
+ */
+template <class Key, class Compare, class Allocator, class Augment>
+bool BasicAVLTree<Key, Compare, Allocator, Augment>::insert(const DataType& val) {
+    return insertValue(val);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+bool BasicAVLTree<Key, Compare, Allocator, Augment>::insert(DataType&& val) {
+    return insertValue(std::move(val));
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class K>
+bool BasicAVLTree<Key, Compare, Allocator, Augment>::insertValue(K&& val) {
+    return insertUnique(val, [&]() { return this->newNode(std::forward<K>(val)); }).second;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class K, class Create>
+std::pair<typename BasicAVLTree<Key, Compare, Allocator, Augment>::Node*, bool>
+BasicAVLTree<Key, Compare, Allocator, Augment>::insertUnique(const K& key, Create create) {
+
+    // search for the insert location, recording the link to every ancestor on the way down
+    Node** path[MAX_HEIGHT];
+    int depth = 0;
+    Node** link = this->getRootNodeAddress();
+    unsigned int visited = 0;
+    TreeStatsScope scope(this->stats_, TreeStats::INSERT, visited);
+    typename BasicAVLTree::IndexRefresh refresh(this->top_, this->root_, this->size_);
+
+    while (*link != nullptr) {
+        Node* current = *link;
+        visited++;
+
+        path[depth++] = link;
+        if (this->compare_(key, current->val)) link = &current->left;
+        else if (this->compare_(current->val, key)) link = &current->right;
+        else return std::make_pair(current, false); // the value is already in the tree
+    }
+
+    Node* inserted = create();
+    inserted->parent = (depth > 0) ? *path[depth - 1] : nullptr;
+    this->top_.touched(depth);
+    *link = inserted;
+    this->size_++;
+
+    // every ancestor's subtree gained a node, which the rotations below take into account
+    for (int i = 0; i < depth; ++i) Augment::addToSize(*path[i], 1);
+
+    // walk back up the ancestors, updating their cached balance until the subtree height stops growing
+    while (depth > 0) {
+        Node* alpha = *path[--depth];
+
+        if (link == &alpha->left) alpha->avlBalance--;
+        else alpha->avlBalance++;
+
+        // the inserted node evened out this subtree, so its height did not change
+        if (alpha->avlBalance == 0) break;
+
+        // a rotation restores the height the subtree had before the insert
+        if (!isBalanced(alpha)) {
+            this->top_.touched(depth);
+            balanceSubTree(path[depth]);
+            break;
+        }
+
+        link = path[depth];
+    }
+
+    return std::make_pair(inserted, true);
+}
+
+/**
+ * AVL Remove function that maintains the balance of a tree after removing a node
+ */
+template <class Key, class Compare, class Allocator, class Augment>
+bool BasicAVLTree<Key, Compare, Allocator, Augment>::remove(KeyParam val) {
+    return removeKey(val);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class K>
+bool BasicAVLTree<Key, Compare, Allocator, Augment>::removeKey(const K& val) {
+
+    // search for the node to delete, recording the link to every ancestor on the way down
+    Node** path[MAX_HEIGHT];
+    int depth = 0;
+    Node** link = this->getRootNodeAddress();
+    unsigned int visited = 0;
+    TreeStatsScope scope(this->stats_, TreeStats::REMOVE, visited);
+    typename BasicAVLTree::IndexRefresh refresh(this->top_, this->root_, this->size_);
+
+    while (*link != nullptr) {
+        Node* current = *link;
+        visited++;
+
+        if (this->compare_(val, current->val)) {
+            path[depth++] = link;
+            link = &current->left;
+        }
+        else if (this->compare_(current->val, val)) {
+            path[depth++] = link;
+            link = &current->right;
+        }
+        else break;
+    }
+
+    if (*link == nullptr) return false; // the value is not in the tree
+
+    Node* current = *link;
+
+    // the link to current changes, and everything else that changes before rebalancing is below it
+    this->top_.touched(depth);
+
+    // a node with two children is replaced by its predecessor, which is unlinked from below
+    if (current->left != nullptr && current->right != nullptr) {
+        Node** current_link = link;
+        int current_depth = depth;
+        path[depth++] = link;
+        link = &current->left;
+
+        while ((*link)->right != nullptr) {
+            visited++;
+            path[depth++] = link;
+            link = &(*link)->right;
+        }
+
+        visited++;
+        Node* predecessor = *link;
+
+        // the predecessor has no right child, so its left child takes its place
+        *link = predecessor->left;
+        if (predecessor->left != nullptr) predecessor->left->parent = predecessor->parent;
+
+        // the predecessor takes current's place and subtree size, so no value has to be moved
+        predecessor->left = current->left;
+        predecessor->right = current->right;
+        predecessor->parent = current->parent;
+        predecessor->avlBalance = current->avlBalance;
+        static_cast<Augment&>(*predecessor) = static_cast<Augment&>(*current);
+        if (predecessor->left != nullptr) predecessor->left->parent = predecessor;
+        predecessor->right->parent = predecessor;
+        *current_link = predecessor;
+
+        // the recorded link to current's left child now belongs to the predecessor
+        if (link == &current->left) link = &predecessor->left;
+        else path[current_depth + 1] = &predecessor->left;
+    }
+
+    // current now has at most one child, which takes its place
+    else {
+        Node* child = (current->left != nullptr) ? current->left : current->right;
+        if (child != nullptr) child->parent = current->parent;
+        *link = child;
+    }
+
+    this->deleteNode(current);
+    this->size_--;
+
+    // every recorded ancestor's subtree lost a node, which the rotations below take into account
+    for (int i = 0; i < depth; ++i) Augment::addToSize(*path[i], -1);
+
+    // walk back up the ancestors, updating their cached balance until the subtree height stops shrinking
+    while (depth > 0) {
+        Node* alpha = *path[--depth];
+
+        if (link == &alpha->left) alpha->avlBalance++;
+        else alpha->avlBalance--;
+
+        // the other subtree is now taller, so the height of this subtree did not change
+        if (std::abs(alpha->avlBalance) == 1) break;
+
+        // rebalance, and stop if the rotation left the subtree height unchanged
+        if (!isBalanced(alpha)) {
+            this->top_.touched(depth);
+            if (balanceSubTree(path[depth])->avlBalance != 0) break;
+        }
+
+        link = path[depth];
+    }
+
+    return true;
+
+}
+
+
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class RandomIt>
+std::vector<bool> BasicAVLTree<Key, Compare, Allocator, Augment>::insert_batch(RandomIt first, RandomIt last) {
+    std::vector<bool> flags(last - first, false);
+    std::vector<unsigned int> order = sortedBatch(first, last);
+    for (unsigned int i = 0; i < order.size(); ++i) flags[order[i]] = true;
+
+    int merged_height;
+    this->root_ = insertBatch(this->root_, treeHeight(), order.data(), order.data() + order.size(), first, flags,
+                              merged_height);
+    this->top_.rebuild(this->root_, this->size_);
+    return flags;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class RandomIt>
+std::vector<bool> BasicAVLTree<Key, Compare, Allocator, Augment>::erase_batch(RandomIt first, RandomIt last) {
+    std::vector<bool> flags(last - first, false);
+    std::vector<unsigned int> order = sortedBatch(first, last);
+
+    int merged_height;
+    this->root_ = eraseBatch(this->root_, treeHeight(), order.data(), order.data() + order.size(), first, flags,
+                             merged_height);
+    this->top_.rebuild(this->root_, this->size_);
+    return flags;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class RandomIt>
+std::vector<unsigned int> BasicAVLTree<Key, Compare, Allocator, Augment>::sortedBatch(RandomIt first, RandomIt last) const {
+    std::vector<unsigned int> order(last - first);
+    for (unsigned int i = 0; i < order.size(); ++i) order[i] = i;
+
+    // a stable sort keeps equivalent values in batch order, so the first one is kept
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+        return this->compare_(first[a], first[b]);
+    });
+
+    unsigned int unique = 0;
+    for (unsigned int i = 0; i < order.size(); ++i) {
+        if (unique == 0 || this->compare_(first[order[unique - 1]], first[order[i]])) order[unique++] = order[i];
+    }
+    order.resize(unique);
+    return order;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class RandomIt>
+typename BasicAVLTree<Key, Compare, Allocator, Augment>::Node* BasicAVLTree<Key, Compare, Allocator, Augment>::insertBatch(
+        Node* root, int height, const unsigned int* lo, const unsigned int* hi, RandomIt batch,
+        std::vector<bool>& flags, int& merged_height) {
+    if (lo == hi) { // base case
+        merged_height = height;
+        return root;
+    }
+
+    Node* middle = root;
+    Node* left = nullptr;
+    Node* right = nullptr;
+    int left_height = -1, right_height = -1;
+    const unsigned int* less_end;
+    const unsigned int* greater_begin;
+
+    // below a leaf, the middle value of the batch becomes the root of a new subtree
+    if (root == nullptr) {
+        less_end = lo + (hi - lo) / 2;
+        greater_begin = less_end + 1;
+        middle = this->newNode(batch[*less_end]);
+        this->size_++;
+    }
+
+    // otherwise split the batch around the root, whose value is not inserted again
+    else {
+        left = root->left;
+        right = root->right;
+        left_height = height - (root->avlBalance > 0 ? 2 : 1);
+        right_height = height - (root->avlBalance < 0 ? 2 : 1);
+
+        less_end = std::lower_bound(lo, hi, root->val, [&](unsigned int i, const Key& val) {
+            return this->compare_(batch[i], val);
+        });
+        greater_begin = less_end;
+        if (greater_begin != hi && !this->compare_(root->val, batch[*greater_begin])) flags[*greater_begin++] = false;
+    }
+
+    left = insertBatch(left, left_height, lo, less_end, batch, flags, left_height);
+    right = insertBatch(right, right_height, greater_begin, hi, batch, flags, right_height);
+    return join(left, left_height, middle, right, right_height, merged_height);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class RandomIt>
+typename BasicAVLTree<Key, Compare, Allocator, Augment>::Node* BasicAVLTree<Key, Compare, Allocator, Augment>::eraseBatch(
+        Node* root, int height, const unsigned int* lo, const unsigned int* hi, RandomIt batch,
+        std::vector<bool>& flags, int& merged_height) {
+    if (lo == hi || root == nullptr) { // base case
+        merged_height = height;
+        return root;
+    }
+
+    int left_height = height - (root->avlBalance > 0 ? 2 : 1);
+    int right_height = height - (root->avlBalance < 0 ? 2 : 1);
+
+    // split the batch around the root, and check whether the root itself is removed
+    const unsigned int* less_end = std::lower_bound(lo, hi, root->val, [&](unsigned int i, const Key& val) {
+        return this->compare_(batch[i], val);
+    });
+    const unsigned int* greater_begin = less_end;
+    bool found = greater_begin != hi && !this->compare_(root->val, batch[*greater_begin]);
+    if (found) flags[*greater_begin++] = true;
+
+    Node* left = eraseBatch(root->left, left_height, lo, less_end, batch, flags, left_height);
+    Node* right = eraseBatch(root->right, right_height, greater_begin, hi, batch, flags, right_height);
+    if (!found) return join(left, left_height, root, right, right_height, merged_height);
+
+    this->deleteNode(root);
+    this->size_--;
+    return join(left, left_height, right, right_height, merged_height);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+bool BasicAVLTree<Key, Compare, Allocator, Augment>::split(KeyParam key, BasicAVLTree& left, BasicAVLTree& right) {
+    Node* root = this->root_;
+    int height = treeHeight();
+    unsigned int total = this->size_;
+    this->root_ = nullptr;
+    this->size_ = 0;
+
+    // the halves take over this tree's nodes, so they have to share its pool
+    if (&left != this) {
+        left.clear();
+        left.allocator_ = this->allocator_;
+    }
+    if (&right != this) {
+        right.clear();
+        right.allocator_ = this->allocator_;
+    }
+
+    int left_height, right_height;
+    Node* found = splitNode(root, height, key, left.root_, left_height, right.root_, right_height);
+    if (found != nullptr) {
+        this->deleteNode(found);
+        total--;
+    }
+
+    // without subtree sizes, count the smaller half by walking both in step
+    if (Augment::countsSubtrees) left.size_ = Augment::sizeOf(left.root_);
+    else {
+        typename BasicAVLTree::iterator left_it = left.begin(), right_it = right.begin();
+        unsigned int counted = 0;
+        while (left_it != left.end() && right_it != right.end()) {
+            ++left_it;
+            ++right_it;
+            counted++;
+        }
+        left.size_ = (left_it == left.end()) ? counted : total - counted;
+    }
+    right.size_ = total - left.size_;
+
+    this->top_.rebuild(this->root_, this->size_);
+    left.top_.rebuild(left.root_, left.size_);
+    right.top_.rebuild(right.root_, right.size_);
+    return found != nullptr;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicAVLTree<Key, Compare, Allocator, Augment>::join(BasicAVLTree& left, KeyParam key, BasicAVLTree& right) {
+    left.sharePool(right);
+
+    int left_height = left.treeHeight(), right_height = right.treeHeight();
+    Node* left_root = left.root_;
+    Node* right_root = right.root_;
+    unsigned int total = left.size_ + right.size_ + 1;
+    left.root_ = right.root_ = nullptr;
+    left.size_ = right.size_ = 0;
+
+    if (this != &left && this != &right) {
+        this->clear();
+        this->allocator_ = left.allocator_;
+    }
+
+    int joined_height;
+    this->root_ = join(left_root, left_height, this->newNode(key), right_root, right_height, joined_height);
+    this->size_ = total;
+    this->top_.rebuild(this->root_, this->size_);
+    left.top_.rebuild(left.root_, left.size_);
+    right.top_.rebuild(right.root_, right.size_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicAVLTree<Key, Compare, Allocator, Augment>::set_union(BasicAVLTree& other) {
+    if (&other == this) return;
+    sharePool(other);
+
+    int other_height = other.treeHeight();
+    Node* other_root = other.root_;
+    unsigned int total = this->size_ + other.size_;
+    other.root_ = nullptr;
+    other.size_ = 0;
+
+    int merged_height;
+    Node* discarded = nullptr;
+    this->root_ = unionNodes(this->root_, treeHeight(), other_root, other_height, merged_height, discarded);
+    this->size_ = total - deleteList(discarded);
+    this->top_.rebuild(this->root_, this->size_);
+    other.top_.rebuild(other.root_, other.size_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicAVLTree<Key, Compare, Allocator, Augment>::set_intersection(const BasicAVLTree& other) {
+    if (&other == this) return;
+
+    int merged_height;
+    this->root_ = intersectNodes(this->root_, treeHeight(), other.root_, other.treeHeight(), merged_height);
+    this->top_.rebuild(this->root_, this->size_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicAVLTree<Key, Compare, Allocator, Augment>::set_difference(const BasicAVLTree& other) {
+    if (&other == this) {
+        this->clear();
+        return;
+    }
+
+    int merged_height;
+    this->root_ = subtractNodes(this->root_, treeHeight(), other.root_, other.treeHeight(), merged_height);
+    this->top_.rebuild(this->root_, this->size_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicAVLTree<Key, Compare, Allocator, Augment>::sharePool(BasicAVLTree& other) {
+    if (this->allocator_ == other.allocator_) return;
+
+    // if the values have to be moved, move the smaller tree, so that this costs O(min(m, n))
+    if (other.size_ <= this->size_) adoptPool(other);
+    else other.adoptPool(*this);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicAVLTree<Key, Compare, Allocator, Augment>::adoptPool(BasicAVLTree& other) {
+    if (this->allocator_ == other.allocator_) return;
+
+    if (!adoptAll(this->allocator_, other.allocator_)) {
+        Node* copy = moveSubtree(other.root_, nullptr, this->allocator_);
+        unsigned int size = other.size_;
+        other.clear();
+        other.root_ = copy;
+        other.size_ = size;
+    }
+    other.allocator_ = this->allocator_;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicAVLTree<Key, Compare, Allocator, Augment>::Node* BasicAVLTree<Key, Compare, Allocator, Augment>::moveSubtree(
+        Node* n, Node* parent, NodeAllocator& pool) {
+    if (n == nullptr) return nullptr; // base case
+
+    Node* copy = pool.allocate(1);
+    new (copy) Node(std::move(n->val));
+    copy->avlBalance = n->avlBalance;
+    static_cast<Augment&>(*copy) = static_cast<Augment&>(*n);
+    copy->parent = parent;
+    copy->left = moveSubtree(n->left, copy, pool);
+    copy->right = moveSubtree(n->right, copy, pool);
+    return copy;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class K>
+typename BasicAVLTree<Key, Compare, Allocator, Augment>::Node* BasicAVLTree<Key, Compare, Allocator, Augment>::splitNode(
+        Node* root, int height, const K& key, Node*& left, int& left_height, Node*& right, int& right_height) {
+    if (root == nullptr) { // base case
+        left = right = nullptr;
+        left_height = right_height = -1;
+        return nullptr;
+    }
+
+    int root_left_height = height - (root->avlBalance > 0 ? 2 : 1);
+    int root_right_height = height - (root->avlBalance < 0 ? 2 : 1);
+    Node* found;
+
+    // key is in the left subtree, so root and its right subtree end up on the right
+    if (this->compare_(key, root->val)) {
+        Node* root_right = root->right;
+        found = splitNode(root->left, root_left_height, key, left, left_height, right, right_height);
+        right = join(right, right_height, root, root_right, root_right_height, right_height);
+    }
+
+    // key is in the right subtree, so root and its left subtree end up on the left
+    else if (this->compare_(root->val, key)) {
+        Node* root_left = root->left;
+        found = splitNode(root->right, root_right_height, key, left, left_height, right, right_height);
+        left = join(root_left, root_left_height, root, left, left_height, left_height);
+    }
+
+    // key is at the root, so its subtrees are the halves
+    else {
+        left = root->left;
+        right = root->right;
+        left_height = root_left_height;
+        right_height = root_right_height;
+        if (left != nullptr) left->parent = nullptr;
+        if (right != nullptr) right->parent = nullptr;
+        found = root;
+    }
+
+    return found;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicAVLTree<Key, Compare, Allocator, Augment>::Node* BasicAVLTree<Key, Compare, Allocator, Augment>::unionNodes(
+        Node* a, int a_height, Node* b, int b_height, int& merged_height, Node*& discarded) {
+    if (b == nullptr) { // base cases
+        merged_height = a_height;
+        return a;
+    }
+    if (a == nullptr) {
+        b->parent = nullptr;
+        merged_height = b_height;
+        return b;
+    }
+
+    // split a around the root of b, and merge the halves with b's subtrees
+    Node* b_left = b->left;
+    Node* b_right = b->right;
+    int b_left_height = b_height - (b->avlBalance > 0 ? 2 : 1);
+    int b_right_height = b_height - (b->avlBalance < 0 ? 2 : 1);
+
+    Node *a_left, *a_right;
+    int a_left_height, a_right_height;
+    Node* middle = splitNode(a, a_height, b->val, a_left, a_left_height, a_right, a_right_height);
+
+    // a value in both trees keeps the node of this tree
+    if (middle != nullptr) {
+        b->left = discarded;
+        discarded = b;
+    }
+    else middle = b;
+
+    int left_height, right_height;
+    Node* left = unionNodes(a_left, a_left_height, b_left, b_left_height, left_height, discarded);
+    Node* right = unionNodes(a_right, a_right_height, b_right, b_right_height, right_height, discarded);
+    return join(left, left_height, middle, right, right_height, merged_height);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+unsigned int BasicAVLTree<Key, Compare, Allocator, Augment>::deleteList(Node* list) {
+    unsigned int deleted = 0;
+    while (list != nullptr) {
+        Node* next = list->left;
+        this->deleteNode(list);
+        list = next;
+        deleted++;
+    }
+    return deleted;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicAVLTree<Key, Compare, Allocator, Augment>::Node* BasicAVLTree<Key, Compare, Allocator, Augment>::intersectNodes(
+        Node* a, int a_height, Node* b, int b_height, int& merged_height) {
+    if (a == nullptr || b == nullptr) { // base case, where nothing of a is in b
+        this->size_ -= this->deleteSubtree(a);
+        merged_height = -1;
+        return nullptr;
+    }
+
+    // split a around the root of b, and keep the root's value only if a has it
+    Node *a_left, *a_right;
+    int a_left_height, a_right_height;
+    Node* middle = splitNode(a, a_height, b->val, a_left, a_left_height, a_right, a_right_height);
+
+    int left_height, right_height;
+    Node* left = intersectNodes(a_left, a_left_height, b->left, b_height - (b->avlBalance > 0 ? 2 : 1), left_height);
+    Node* right = intersectNodes(a_right, a_right_height, b->right, b_height - (b->avlBalance < 0 ? 2 : 1), right_height);
+    if (middle == nullptr) return join(left, left_height, right, right_height, merged_height);
+    return join(left, left_height, middle, right, right_height, merged_height);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicAVLTree<Key, Compare, Allocator, Augment>::Node* BasicAVLTree<Key, Compare, Allocator, Augment>::subtractNodes(
+        Node* a, int a_height, Node* b, int b_height, int& merged_height) {
+    if (a == nullptr || b == nullptr) { // base case, where nothing of a is in b
+        if (a != nullptr) a->parent = nullptr;
+        merged_height = a_height;
+        return a;
+    }
+
+    // split a around the root of b, and drop the root's value if a has it
+    Node *a_left, *a_right;
+    int a_left_height, a_right_height;
+    Node* middle = splitNode(a, a_height, b->val, a_left, a_left_height, a_right, a_right_height);
+    if (middle != nullptr) {
+        this->deleteNode(middle);
+        this->size_--;
+    }
+
+    int left_height, right_height;
+    Node* left = subtractNodes(a_left, a_left_height, b->left, b_height - (b->avlBalance > 0 ? 2 : 1), left_height);
+    Node* right = subtractNodes(a_right, a_right_height, b->right, b_height - (b->avlBalance < 0 ? 2 : 1), right_height);
+    return join(left, left_height, right, right_height, merged_height);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+int BasicAVLTree<Key, Compare, Allocator, Augment>::treeHeight() const {
+    int tree_height = -1;
+    for (Node* current = this->root_; current != nullptr; tree_height++) {
+        current = (current->avlBalance < 0) ? current->left : current->right;
+    }
+    return tree_height;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicAVLTree<Key, Compare, Allocator, Augment>::Node* BasicAVLTree<Key, Compare, Allocator, Augment>::join(
+        Node* left, int left_height, Node* middle, Node* right, int right_height, int& joined_height) {
+
+    // subtrees of about the same height simply become the children of middle
+    if (std::abs(left_height - right_height) <= 1) {
+        middle->left = left;
+        middle->right = right;
+        middle->parent = nullptr;
+        if (left != nullptr) left->parent = middle;
+        if (right != nullptr) right->parent = middle;
+        middle->avlBalance = right_height - left_height;
+        Augment::recount(middle);
+        joined_height = 1 + std::max(left_height, right_height);
+        return middle;
+    }
+
+    // otherwise walk down the inner spine of the taller tree (the right spine of left,
+    // or the left spine of right) to the first subtree that is at most one level
+    // taller than the shorter tree, recording the links and heights on the way
+    bool left_taller = left_height > right_height;
+    int side = left_taller ? 1 : -1; // sign of a balance that leans towards the spine
+    Node* root = left_taller ? left : right;
+    Node* shorter = left_taller ? right : left;
+    int shorter_height = left_taller ? right_height : left_height;
+
+    Node** path[MAX_HEIGHT];
+    int heights[MAX_HEIGHT];
+    int depth = 0;
+    Node** link = &root;
+    int spine_height = left_taller ? left_height : right_height;
+
+    while (spine_height > shorter_height + 1) {
+        Node* current = *link;
+        path[depth] = link;
+        heights[depth++] = spine_height;
+        spine_height -= (side * current->avlBalance >= 0) ? 1 : 2;
+        link = left_taller ? &current->right : &current->left;
+    }
+
+    // middle takes that subtree's place, with the shorter tree on its other side
+    Node* inner = *link;
+    middle->left = left_taller ? inner : shorter;
+    middle->right = left_taller ? shorter : inner;
+    middle->parent = *path[depth - 1];
+    if (inner != nullptr) inner->parent = middle;
+    if (shorter != nullptr) shorter->parent = middle;
+    middle->avlBalance = side * (shorter_height - spine_height);
+    Augment::recount(middle);
+    *link = middle;
+
+    // the spine is now one level taller at the bottom, so walk back up and rebalance,
+    // where a rotation that leaves a balance of 0 takes the extra level away again
+    int grown_height = spine_height + 1;
+    while (depth > 0) {
+        Node* alpha = *path[--depth];
+        int other_height = spine_height - side * alpha->avlBalance;
+
+        alpha->avlBalance = side * (grown_height - other_height);
+        Augment::recount(alpha);
+        spine_height = heights[depth];
+        grown_height = 1 + std::max(grown_height, other_height);
+        if (!isBalanced(alpha) && balanceSubTree(path[depth])->avlBalance == 0) grown_height--;
+    }
+
+    root->parent = nullptr;
+    joined_height = grown_height;
+    return root;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicAVLTree<Key, Compare, Allocator, Augment>::Node* BasicAVLTree<Key, Compare, Allocator, Augment>::join(
+        Node* left, int left_height, Node* right, int right_height, int& joined_height) {
+    if (left == nullptr) {
+        if (right != nullptr) right->parent = nullptr;
+        joined_height = right_height;
+        return right;
+    }
+
+    Node* last;
+    int rest_height;
+    Node* rest = removeLast(left, left_height, last, rest_height);
+    return join(rest, rest_height, last, right, right_height, joined_height);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicAVLTree<Key, Compare, Allocator, Augment>::Node* BasicAVLTree<Key, Compare, Allocator, Augment>::removeLast(
+        Node* root, int height, Node*& last, int& rest_height) {
+
+    // the largest node has no right child, so its left subtree is what is left
+    if (root->right == nullptr) {
+        last = root;
+        rest_height = height - 1;
+        if (root->left != nullptr) root->left->parent = nullptr;
+        return root->left;
+    }
+
+    int left_height = height - (root->avlBalance > 0 ? 2 : 1);
+    int right_height = height - (root->avlBalance < 0 ? 2 : 1);
+    Node* right = removeLast(root->right, right_height, last, right_height);
+    return join(root->left, left_height, root, right, right_height, rest_height);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicAVLTree<Key, Compare, Allocator, Augment>::rotateRight(Node** link) {
+
+    // perform right rotation
+    Node *alpha = *link;
+    Node *A = alpha->left;
+    alpha->left = A->right;
+    A->right = alpha;
+
+    // A takes over alpha's parent, and alpha takes over A's right child
+    A->parent = alpha->parent;
+    alpha->parent = A;
+    if (alpha->left != nullptr) alpha->left->parent = alpha;
+
+    // update the cached balances and sizes, alpha first since it is now A's child
+    alpha->avlBalance = alpha->avlBalance + 1 - std::min(A->avlBalance, 0);
+    A->avlBalance = A->avlBalance + 1 + std::max(alpha->avlBalance, 0);
+    Augment::recount(alpha);
+    Augment::recount(A);
+
+    // A takes alpha's place in its parent (or as the root)
+    *link = A;
+    this->stats_.rotated();
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicAVLTree<Key, Compare, Allocator, Augment>::rotateLeft(Node** link) {
+
+    // perform left rotation
+    Node *alpha = *link;
+    Node *A = alpha->right;
+    alpha->right = A->left;
+    A->left = alpha;
+
+    // A takes over alpha's parent, and alpha takes over A's left child
+    A->parent = alpha->parent;
+    alpha->parent = A;
+    if (alpha->right != nullptr) alpha->right->parent = alpha;
+
+    // update the cached balances and sizes, alpha first since it is now A's child
+    alpha->avlBalance = alpha->avlBalance - 1 - std::max(A->avlBalance, 0);
+    A->avlBalance = A->avlBalance - 1 + std::min(alpha->avlBalance, 0);
+    Augment::recount(alpha);
+    Augment::recount(A);
+
+    // A takes alpha's place in its parent (or as the root)
+    *link = A;
+    this->stats_.rotated();
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicAVLTree<Key, Compare, Allocator, Augment>::rotateLeftRight(Node** link) {
+    rotateLeft(&(*link)->left);
+    rotateRight(link);
+    this->stats_.doubleRotated();
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicAVLTree<Key, Compare, Allocator, Augment>::rotateRightLeft(Node** link) {
+    rotateRight(&(*link)->right);
+    rotateLeft(link);
+    this->stats_.doubleRotated();
+}
+
 #endif
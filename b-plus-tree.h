@@ -0,0 +1,525 @@
+#ifndef LAB3_B_PLUS_TREE_H
+#define LAB3_B_PLUS_TREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "node-pool.h"
+#include "tree-stats.h"
+
+// Size of a node of a BPlusTree, four cache lines. A lookup binary searches each
+// node it passes, which reads about three of its lines.
+const std::size_t B_PLUS_TREE_NODE_BYTES = 256;
+
+// What every node of a B+-tree starts with.
+template <class Key>
+struct BPlusTreeNode {
+    unsigned int count;  // Number of keys in the node.
+};
+
+// A leaf holds the values themselves, in order, and links to the next leaf so
+// that a range can be read without going back up the tree.
+template <class Key>
+struct BPlusTreeLeaf : BPlusTreeNode<Key> {
+    struct Header : BPlusTreeNode<Key> {
+        BPlusTreeLeaf* next;
+    };
+
+    // As many keys as fit in a node, but at least 4 so a split leaves both halves useful.
+    static const unsigned int CAPACITY = sizeof(Header) + 4 * sizeof(Key) > B_PLUS_TREE_NODE_BYTES
+        ? 4 : (B_PLUS_TREE_NODE_BYTES - sizeof(Header)) / sizeof(Key);
+
+    BPlusTreeLeaf* next;  // Pointer to the leaf with the next larger keys.
+    Key keys[CAPACITY];   // Values of the leaf, of which the first count are used.
+};
+
+// An inner node routes a lookup: child i holds the values less than keys[i], and
+// the values from keys[i - 1] on.
+template <class Key>
+struct BPlusTreeInner : BPlusTreeNode<Key> {
+    static const std::size_t ENTRY_BYTES = sizeof(Key) + sizeof(BPlusTreeNode<Key>*);
+
+    // As many keys as fit next to one more child, but at least 4.
+    static const unsigned int CAPACITY = sizeof(BPlusTreeNode<Key>) + 5 * ENTRY_BYTES > B_PLUS_TREE_NODE_BYTES
+        ? 4 : (B_PLUS_TREE_NODE_BYTES - sizeof(BPlusTreeNode<Key>) - sizeof(BPlusTreeNode<Key>*)) / ENTRY_BYTES;
+
+    Key keys[CAPACITY];                             // Separators, of which the first count are used.
+    BPlusTreeNode<Key>* children[CAPACITY + 1];     // Subtrees, of which the first count + 1 are used.
+};
+
+// Set of keys kept in a B+-tree: every value sits in a leaf of many values, and
+// the inner nodes above only route lookups, so a node fills a few cache lines
+// and a lookup in a tree of millions of keys reads a handful of nodes instead of
+// a pointer-chasing path of one node per level. It has the insert, remove and
+// exists of AVLTree, and is meant as a drop-in engine where lookups dominate.
+//
+// Nodes are split when they overflow and merged with, or refilled from, a
+// sibling when they fall below half full, so every leaf is at the same depth.
+// Leaves and inner nodes come from two allocators rebound from Allocator; the
+// default NodePool keeps each node on cache lines of its own.
+template <class Key, class Compare = std::less<Key>, class Allocator = NodePool<Key> >
+class BasicBPlusTree {
+public:
+    typedef Key DataType;
+    typedef BPlusTreeNode<Key> Node;
+    typedef BPlusTreeLeaf<Key> Leaf;
+    typedef BPlusTreeInner<Key> Inner;
+
+    BasicBPlusTree();
+    ~BasicBPlusTree();
+
+    // Removes every value from the tree, in O(1) when the nodes come from a NodePool.
+    void clear();
+
+    // Returns the number of values in the tree.
+    unsigned int size() const;
+
+    // Returns the number of levels of nodes, 0 for an empty tree.
+    unsigned int height() const;
+
+    // Returns the number of nodes visited by the last call to insert, remove or
+    // exists, counting every node the operation read on its way down. Only kept
+    // when built with LAB3_TREE_STATS; otherwise it returns 0.
+    unsigned int nodesVisited() const;
+
+    // Returns true if val is in the tree; otherwise, it returns false.
+    bool exists(const DataType& val) const;
+
+    // Calls visit(value) for every value in [lo, hi) in order.
+    template <class Visitor>
+    void scan(const DataType& lo, const DataType& hi, Visitor visit) const;
+
+    // Inserts val into the tree. Returns false if val already exists in the tree,
+    // and true otherwise.
+    bool insert(const DataType& val);
+
+    // Removes val from the tree. Returns true if successful, and false otherwise.
+    bool remove(const DataType& val);
+
+private:
+    friend class BPlusTreeTest;
+
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Leaf> LeafAllocator;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Inner> InnerAllocator;
+
+    // Pointer to the root node of the tree, a leaf if height_ is 1.
+    Node* root_;
+
+    // Number of levels of nodes.
+    unsigned int height_;
+
+    // Number of values in the tree.
+    unsigned int size_;
+
+    // Number of nodes visited by the last insert, remove or exists.
+    mutable VisitCount visited_;
+
+    LeafAllocator leaf_allocator_;
+    InnerAllocator inner_allocator_;
+    Compare compare_;
+
+    // A node that is not the root has at least this many keys.
+    static const unsigned int LEAF_MIN = Leaf::CAPACITY / 2;
+    static const unsigned int INNER_MIN = Inner::CAPACITY / 2;
+
+    // Allocate an empty node, and destroy a node and return its memory.
+    Leaf* newLeaf();
+    Inner* newInner();
+    void deleteLeaf(Leaf* n);
+    void deleteInner(Inner* n);
+
+    // Destroys every node of the subtree n, whose nodes sit in levels levels.
+    void deleteSubtree(Node* n, unsigned int levels);
+
+    // Returns the index of the child of n whose subtree may hold val.
+    unsigned int childIndex(const Inner* n, const Key& val) const;
+
+    // Returns the leaf whose range holds val.
+    const Leaf* findLeaf(const Key& val) const;
+
+    // Inserts val into the subtree n of levels levels. Sets inserted to whether
+    // val was new. If n had to be split, returns the new node holding the upper
+    // half, and sets separator to the smallest value below it; otherwise returns
+    // nullptr.
+    Node* insertInto(Node* n, unsigned int levels, const Key& val, Key& separator, bool& inserted);
+
+    // Inserts val into the full leaf n at pos, splitting it, or separator and its
+    // right child into the full inner node n at pos. Return the new right half,
+    // and set separator to the value that now routes to it.
+    Leaf* splitLeaf(Leaf* n, unsigned int pos, const Key& val, Key& separator);
+    Inner* splitInner(Inner* n, unsigned int pos, Key& separator, Node* right);
+
+    // Removes val from the subtree n of levels levels, and returns whether it was
+    // there. Leaves n with fewer than the minimum number of keys if needed; the
+    // caller fixes that.
+    bool removeFrom(Node* n, unsigned int levels, const Key& val);
+
+    // Brings child i of n, in level levels, back to the minimum number of keys, by
+    // moving one key over from a sibling or by merging it with one.
+    void refill(Inner* n, unsigned int i, unsigned int levels);
+
+    // Sets copy constructor and assignment operator to private.
+    BasicBPlusTree(const BasicBPlusTree& other);
+    BasicBPlusTree& operator=(const BasicBPlusTree& other);
+};
+
+typedef BasicBPlusTree<int> BPlusTree;
+
+template <class Key, class Compare, class Allocator>
+BasicBPlusTree<Key, Compare, Allocator>::BasicBPlusTree() : root_(nullptr), height_(0), size_(0) {}
+
+template <class Key, class Compare, class Allocator>
+BasicBPlusTree<Key, Compare, Allocator>::~BasicBPlusTree() {
+    clear();
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicBPlusTree<Key, Compare, Allocator>::clear() {
+
+    // pools can drop all of their nodes at once, and the two are of the same
+    // kind, so either both do or neither does
+    if (!std::is_trivially_destructible<Key>::value || !releaseAll(leaf_allocator_) || !releaseAll(inner_allocator_)) {
+        deleteSubtree(root_, height_);
+    }
+
+    root_ = nullptr;
+    height_ = 0;
+    size_ = 0;
+}
+
+template <class Key, class Compare, class Allocator>
+unsigned int BasicBPlusTree<Key, Compare, Allocator>::size() const {
+    return size_;
+}
+
+template <class Key, class Compare, class Allocator>
+unsigned int BasicBPlusTree<Key, Compare, Allocator>::height() const {
+    return height_;
+}
+
+template <class Key, class Compare, class Allocator>
+unsigned int BasicBPlusTree<Key, Compare, Allocator>::nodesVisited() const {
+    return visited_.value();
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicBPlusTree<Key, Compare, Allocator>::Leaf* BasicBPlusTree<Key, Compare, Allocator>::newLeaf() {
+    Leaf* n = leaf_allocator_.allocate(1);
+    new (n) Leaf;
+    n->count = 0;
+    n->next = nullptr;
+    return n;
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicBPlusTree<Key, Compare, Allocator>::Inner* BasicBPlusTree<Key, Compare, Allocator>::newInner() {
+    Inner* n = inner_allocator_.allocate(1);
+    new (n) Inner;
+    n->count = 0;
+    return n;
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicBPlusTree<Key, Compare, Allocator>::deleteLeaf(Leaf* n) {
+    n->~Leaf();
+    leaf_allocator_.deallocate(n, 1);
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicBPlusTree<Key, Compare, Allocator>::deleteInner(Inner* n) {
+    n->~Inner();
+    inner_allocator_.deallocate(n, 1);
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicBPlusTree<Key, Compare, Allocator>::deleteSubtree(Node* n, unsigned int levels) {
+    if (n == nullptr) return;
+    if (levels == 1) {
+        deleteLeaf(static_cast<Leaf*>(n));
+        return;
+    }
+
+    // the tree is only O(log n) levels deep, so recursing is safe
+    Inner* inner = static_cast<Inner*>(n);
+    for (unsigned int i = 0; i <= inner->count; ++i) deleteSubtree(inner->children[i], levels - 1);
+    deleteInner(inner);
+}
+
+template <class Key, class Compare, class Allocator>
+unsigned int BasicBPlusTree<Key, Compare, Allocator>::childIndex(const Inner* n, const Key& val) const {
+    return std::upper_bound(n->keys, n->keys + n->count, val, compare_) - n->keys;
+}
+
+template <class Key, class Compare, class Allocator>
+const typename BasicBPlusTree<Key, Compare, Allocator>::Leaf* BasicBPlusTree<Key, Compare, Allocator>::findLeaf(
+        const Key& val) const {
+    const Node* n = root_;
+    for (unsigned int level = height_; level > 1; --level) {
+        const Inner* inner = static_cast<const Inner*>(n);
+        n = inner->children[childIndex(inner, val)];
+    }
+    return static_cast<const Leaf*>(n);
+}
+
+template <class Key, class Compare, class Allocator>
+bool BasicBPlusTree<Key, Compare, Allocator>::exists(const DataType& val) const {
+    // every lookup reads one node per level
+    visited_.set(height_);
+    if (root_ == nullptr) return false;
+
+    const Leaf* leaf = findLeaf(val);
+    const Key* pos = std::lower_bound(leaf->keys, leaf->keys + leaf->count, val, compare_);
+    return pos != leaf->keys + leaf->count && !compare_(val, *pos);
+}
+
+template <class Key, class Compare, class Allocator>
+template <class Visitor>
+void BasicBPlusTree<Key, Compare, Allocator>::scan(const DataType& lo, const DataType& hi, Visitor visit) const {
+    if (root_ == nullptr) return;
+
+    // find the first value not less than lo, then follow the leaves until hi
+    const Leaf* leaf = findLeaf(lo);
+    unsigned int i = std::lower_bound(leaf->keys, leaf->keys + leaf->count, lo, compare_) - leaf->keys;
+    for (; leaf != nullptr; leaf = leaf->next, i = 0) {
+        for (; i < leaf->count; ++i) {
+            if (!compare_(leaf->keys[i], hi)) return;
+            visit(leaf->keys[i]);
+        }
+    }
+}
+
+template <class Key, class Compare, class Allocator>
+bool BasicBPlusTree<Key, Compare, Allocator>::insert(const DataType& val) {
+    if (root_ == nullptr) {
+        root_ = newLeaf();
+        height_ = 1;
+    }
+
+    visited_.set(height_);
+    Key separator;
+    bool inserted = false;
+    Node* right = insertInto(root_, height_, val, separator, inserted);
+
+    // a split root gets a new root above it, which is how the tree grows
+    if (right != nullptr) {
+        Inner* root = newInner();
+        root->count = 1;
+        root->keys[0] = separator;
+        root->children[0] = root_;
+        root->children[1] = right;
+        root_ = root;
+        height_++;
+    }
+
+    if (inserted) size_++;
+    return inserted;
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicBPlusTree<Key, Compare, Allocator>::Node* BasicBPlusTree<Key, Compare, Allocator>::insertInto(
+        Node* n, unsigned int levels, const Key& val, Key& separator, bool& inserted) {
+    if (levels == 1) {
+        Leaf* leaf = static_cast<Leaf*>(n);
+        unsigned int pos = std::lower_bound(leaf->keys, leaf->keys + leaf->count, val, compare_) - leaf->keys;
+        if (pos < leaf->count && !compare_(val, leaf->keys[pos])) return nullptr;
+
+        inserted = true;
+        if (leaf->count == Leaf::CAPACITY) return splitLeaf(leaf, pos, val, separator);
+
+        std::move_backward(leaf->keys + pos, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+        leaf->keys[pos] = val;
+        leaf->count++;
+        return nullptr;
+    }
+
+    Inner* inner = static_cast<Inner*>(n);
+    unsigned int i = childIndex(inner, val);
+    Node* right = insertInto(inner->children[i], levels - 1, val, separator, inserted);
+    if (right == nullptr) return nullptr;
+
+    // the child split, so its new right half goes in after it
+    if (inner->count == Inner::CAPACITY) return splitInner(inner, i, separator, right);
+
+    std::move_backward(inner->keys + i, inner->keys + inner->count, inner->keys + inner->count + 1);
+    std::copy_backward(inner->children + i + 1, inner->children + inner->count + 1, inner->children + inner->count + 2);
+    inner->keys[i] = separator;
+    inner->children[i + 1] = right;
+    inner->count++;
+    return nullptr;
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicBPlusTree<Key, Compare, Allocator>::Leaf* BasicBPlusTree<Key, Compare, Allocator>::splitLeaf(
+        Leaf* n, unsigned int pos, const Key& val, Key& separator) {
+
+    // the upper half moves to a new leaf, then val goes into whichever half it belongs to
+    unsigned int half = Leaf::CAPACITY / 2;
+    Leaf* right = newLeaf();
+    std::move(n->keys + half, n->keys + n->count, right->keys);
+    right->count = n->count - half;
+    n->count = half;
+    right->next = n->next;
+    n->next = right;
+
+    Leaf* target = (pos <= half) ? n : right;
+    if (target == right) pos -= half;
+    std::move_backward(target->keys + pos, target->keys + target->count, target->keys + target->count + 1);
+    target->keys[pos] = val;
+    target->count++;
+
+    separator = right->keys[0];
+    return right;
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicBPlusTree<Key, Compare, Allocator>::Inner* BasicBPlusTree<Key, Compare, Allocator>::splitInner(
+        Inner* n, unsigned int pos, Key& separator, Node* right) {
+
+    // lay out the keys and children with separator and right in place, then keep the
+    // lower half, move the upper half to a new node, and send the middle key up
+    Key keys[Inner::CAPACITY + 1];
+    Node* children[Inner::CAPACITY + 2];
+    std::move(n->keys, n->keys + pos, keys);
+    keys[pos] = separator;
+    std::move(n->keys + pos, n->keys + n->count, keys + pos + 1);
+    std::copy(n->children, n->children + pos + 1, children);
+    children[pos + 1] = right;
+    std::copy(n->children + pos + 1, n->children + n->count + 1, children + pos + 2);
+
+    unsigned int total = n->count + 1;
+    unsigned int middle = total / 2;
+    Inner* upper = newInner();
+    n->count = middle;
+    std::move(keys, keys + middle, n->keys);
+    std::copy(children, children + middle + 1, n->children);
+    upper->count = total - middle - 1;
+    std::move(keys + middle + 1, keys + total, upper->keys);
+    std::copy(children + middle + 1, children + total + 1, upper->children);
+
+    separator = std::move(keys[middle]);
+    return upper;
+}
+
+template <class Key, class Compare, class Allocator>
+bool BasicBPlusTree<Key, Compare, Allocator>::remove(const DataType& val) {
+    visited_.set(height_);
+    if (root_ == nullptr) return false;
+
+    if (!removeFrom(root_, height_, val)) return false;
+    size_--;
+
+    // a root left with a single child is dropped, which is how the tree shrinks
+    if (height_ > 1 && root_->count == 0) {
+        Inner* root = static_cast<Inner*>(root_);
+        root_ = root->children[0];
+        deleteInner(root);
+        height_--;
+    }
+    else if (height_ == 1 && root_->count == 0) {
+        deleteLeaf(static_cast<Leaf*>(root_));
+        root_ = nullptr;
+        height_ = 0;
+    }
+    return true;
+}
+
+template <class Key, class Compare, class Allocator>
+bool BasicBPlusTree<Key, Compare, Allocator>::removeFrom(Node* n, unsigned int levels, const Key& val) {
+    if (levels == 1) {
+        Leaf* leaf = static_cast<Leaf*>(n);
+        unsigned int pos = std::lower_bound(leaf->keys, leaf->keys + leaf->count, val, compare_) - leaf->keys;
+        if (pos == leaf->count || compare_(val, leaf->keys[pos])) return false;
+
+        std::move(leaf->keys + pos + 1, leaf->keys + leaf->count, leaf->keys + pos);
+        leaf->count--;
+        return true;
+    }
+
+    Inner* inner = static_cast<Inner*>(n);
+    unsigned int i = childIndex(inner, val);
+    if (!removeFrom(inner->children[i], levels - 1, val)) return false;
+
+    unsigned int min = (levels == 2) ? LEAF_MIN : INNER_MIN;
+    if (inner->children[i]->count < min) refill(inner, i, levels - 1);
+    return true;
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicBPlusTree<Key, Compare, Allocator>::refill(Inner* n, unsigned int i, unsigned int levels) {
+
+    // work on the child and its left sibling, or its right one if it is the first,
+    // with separator j between them
+    unsigned int j = (i > 0) ? i - 1 : i;
+    Node* left = n->children[j];
+    Node* right = n->children[j + 1];
+    bool short_left = (j == i);
+
+    if (levels == 1) {
+        Leaf* l = static_cast<Leaf*>(left);
+        Leaf* r = static_cast<Leaf*>(right);
+
+        if (l->count + r->count <= Leaf::CAPACITY) {
+            std::move(r->keys, r->keys + r->count, l->keys + l->count);
+            l->count += r->count;
+            l->next = r->next;
+            deleteLeaf(r);
+        }
+        else if (short_left) {
+            l->keys[l->count++] = std::move(r->keys[0]);
+            std::move(r->keys + 1, r->keys + r->count, r->keys);
+            r->count--;
+            n->keys[j] = r->keys[0];
+            return;
+        }
+        else {
+            std::move_backward(r->keys, r->keys + r->count, r->keys + r->count + 1);
+            r->keys[0] = std::move(l->keys[--l->count]);
+            r->count++;
+            n->keys[j] = r->keys[0];
+            return;
+        }
+    }
+    else {
+        Inner* l = static_cast<Inner*>(left);
+        Inner* r = static_cast<Inner*>(right);
+
+        // keys move between siblings through the separator above them
+        if (l->count + 1 + r->count <= Inner::CAPACITY) {
+            l->keys[l->count] = std::move(n->keys[j]);
+            std::move(r->keys, r->keys + r->count, l->keys + l->count + 1);
+            std::copy(r->children, r->children + r->count + 1, l->children + l->count + 1);
+            l->count += r->count + 1;
+            deleteInner(r);
+        }
+        else if (short_left) {
+            l->keys[l->count] = std::move(n->keys[j]);
+            l->children[l->count + 1] = r->children[0];
+            l->count++;
+            n->keys[j] = std::move(r->keys[0]);
+            std::move(r->keys + 1, r->keys + r->count, r->keys);
+            std::copy(r->children + 1, r->children + r->count + 1, r->children);
+            r->count--;
+            return;
+        }
+        else {
+            std::move_backward(r->keys, r->keys + r->count, r->keys + r->count + 1);
+            std::copy_backward(r->children, r->children + r->count + 1, r->children + r->count + 2);
+            r->keys[0] = std::move(n->keys[j]);
+            r->children[0] = l->children[l->count];
+            r->count++;
+            n->keys[j] = std::move(l->keys[--l->count]);
+            return;
+        }
+    }
+
+    // right was merged into left, so its separator and link go
+    std::move(n->keys + j + 1, n->keys + n->count, n->keys + j);
+    std::copy(n->children + j + 2, n->children + n->count + 1, n->children + j + 1);
+    n->count--;
+}
+
+#endif
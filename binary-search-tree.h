@@ -1,19 +1,103 @@
 #ifndef LAB3_BINARY_SEARCH_TREE_H
 #define LAB3_BINARY_SEARCH_TREE_H
 
-class BinarySearchTree {
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <queue>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "node-pool.h"
+#include "top-level-index.h"
+#include "tree-iterator.h"
+#include "tree-stats.h"
+
+// Types of the operations that freeze, save or load a tree, or build it in
+// parallel. Only the code that calls them includes frozen-tree.h, snapshot.h or
+// parallel-avl-tree.h, so the tree itself needs no threads or system headers.
+class TaskPool;
+template <class Key, class Compare> class BasicFrozenTree;
+template <class Key> class SnapshotWriter;
+template <class Key, class Compare> class SnapshotReader;
+
+// Policies for the Augment parameter of the trees, which the nodes derive from.
+// NoSubtreeSize adds nothing to a node. SubtreeSize keeps the number of nodes
+// in the subtree under each node, so that a tree can find the rank of a key and
+// the key at a rank in O(log n), at the cost of one more field per node.
+struct NoSubtreeSize {
+    static const bool countsSubtrees = false;
+
+    // Sizes are not kept, so this is only called where countsSubtrees is checked first.
+    template <class Node> static unsigned int sizeOf(const Node*) { return 0; }
+
+    template <class Node> static void addToSize(Node*, int) {}
+    template <class Node> static void recount(Node*) {}
+};
+
+struct SubtreeSize {
+    static const bool countsSubtrees = true;
+
+    SubtreeSize() : subtreeSize(1) {}
+
+    unsigned int subtreeSize;  // Number of nodes in the subtree rooted at this node.
+
+    // Returns the number of nodes in the subtree rooted at n, or 0 if n is NULL.
+    template <class Node> static unsigned int sizeOf(const Node* n) { return n != nullptr ? n->subtreeSize : 0; }
+
+    // Adds delta to the size of the subtree rooted at n.
+    template <class Node> static void addToSize(Node* n, int delta) { n->subtreeSize += delta; }
+
+    // Recomputes the size of the subtree rooted at n from the sizes of its children.
+    template <class Node> static void recount(Node* n) { n->subtreeSize = 1 + sizeOf(n->left) + sizeOf(n->right); }
+};
+
+// A node of the tree. It is declared outside of the tree so that trees using
+// different comparators and allocators share the same node type.
+template <class Key, class Augment = NoSubtreeSize>
+struct BinarySearchTreeNode : Augment {
+    typedef Key DataType;
+
+    // Sets the left and right children to NULL, and initializes val from args,
+    // so a value passed as an rvalue is moved into the node.
+    template <class... Args>
+    explicit BinarySearchTreeNode(Args&&... args)
+        : left(nullptr), right(nullptr), parent(nullptr), avlBalance(0), val(std::forward<Args>(args)...) {}
+
+    BinarySearchTreeNode* left;    // Pointer to the left node.
+    BinarySearchTreeNode* right;   // Pointer to the right node.
+    BinarySearchTreeNode* parent;  // Pointer to the parent node, used by iterators.
+    int avlBalance;                // Height of the right subtree minus height of the left subtree.
+    DataType val;                  // Value of the node, last so that an int packs next to avlBalance.
+};
+
+// Binary search tree of Keys ordered by Compare. Its nodes come from Allocator
+// rebound to the node type, which by default is a NodePool; std::allocator
+// gives one new/delete per node instead.
+//
+// With Augment = SubtreeSize, the tree also answers rank, select and count_range.
+template <class Key, class Compare = std::less<Key>, class Allocator = NodePool<Key>,
+          class Augment = NoSubtreeSize>
+class BasicBinarySearchTree {
 public:
-    typedef int DataType;
+    typedef Key DataType;
+    typedef BinarySearchTreeNode<Key, Augment> Node;
 
-    struct Node {
-        // Sets the left and right children to NULL, and initializes val.
-        Node(DataType newval);
+    // Scalar keys are cheapest to pass by value, and everything else is passed
+    // by const reference so that large keys are never copied by a lookup.
+    typedef typename std::conditional<std::is_scalar<Key>::value, Key, const Key&>::type KeyParam;
 
-        DataType val;    // Value of the node.
-        Node* left;      // Pointer to the left node.
-        Node* right;     // Pointer to the right node.
-        int avlBalance;
-    };
+    // Iterators visit the values in order. Values cannot be changed through them,
+    // since that could break the order of the tree.
+    typedef TreeIterator<Node, const Key> iterator;
+    typedef iterator const_iterator;
 
 private:
     friend class BinarySearchTreeTest;
@@ -22,36 +106,175 @@ private:
     // function that recursively gets the maximum depth for a given node.
     int getNodeDepth(Node* n) const;
 
+    // function that recursively recomputes the avlBalance below a given node and
+    // returns its height (-1 for an empty subtree).
+    int updateNodeHeight(Node* n);
+
+protected:
     // Pointer to the root node of the tree.
     Node* root_;
 
     // Number of nodes in the tree.
     unsigned int size_;
 
+    // Allocator that every node of the tree comes from.
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Node> NodeAllocator;
+    NodeAllocator allocator_;
+
+    // Orders the keys of the tree, counting its calls in builds with LAB3_TREE_STATS.
+    typename StatsCompare<Compare>::type compare_;
+
+    // Counters behind stats(), which count nothing unless LAB3_TREE_STATS is defined.
+    mutable TreeStatsRecorder stats_;
+
+    // Index over the top levels of the tree, which exists() starts from. Every
+    // change to the links of the tree has to be reported to it, and the change
+    // has to refresh it before it returns, since lookups never do.
+    typedef TopLevelIndex<Key, Compare, Node> Index;
+    typedef TopLevelIndexRefresh<Index, Node> IndexRefresh;
+    Index top_;
+
+    // Allocates and constructs a node whose value is built from args.
+    template <class... Args>
+    Node* newNode(Args&&... args);
+
+    // Returns the node holding a key equivalent to key, or nullptr if there is none.
+    // Compare must be able to compare key with the values of the tree.
+    template <class K>
+    Node* findNode(const K& key) const;
+
+    // Returns the first node whose key is not less than key (lowerBoundNode) or
+    // greater than key (upperBoundNode), or nullptr if there is none.
+    template <class K>
+    Node* lowerBoundNode(const K& key) const;
+    template <class K>
+    Node* upperBoundNode(const K& key) const;
+
+    // Calls visit(value) for every value in [lo, hi) in order.
+    template <class K, class Visitor>
+    void scanRange(const K& lo, const K& hi, Visitor& visit) const;
+
+    // Inserts val into the tree, moving it into the new node if it is an rvalue.
+    template <class K>
+    bool insertValue(K&& val);
+
+    // Destroys a node and returns its memory to the allocator.
+    void deleteNode(Node* n);
+
+    // Destroys every node of the subtree n in O(size of the subtree) without
+    // recursion. Returns the number of nodes destroyed.
+    unsigned int deleteSubtree(Node* n);
+
+    // Adds delta to the subtree size of n and of every ancestor of n, if the nodes
+    // keep subtree sizes.
+    static void addToAncestorSizes(Node* n, int delta);
+
+    // Builds a perfectly balanced subtree below parent from the next n values of
+    // first, in order, with nodes from allocator, and returns its root. Leaves
+    // first after the last value used.
+    template <class ForwardIt>
+    Node* buildSubtree(ForwardIt& first, unsigned int n, Node* parent, NodeAllocator& allocator);
+
+    // Builds the same subtree as buildSubtree from the n values at first, forking
+    // subtrees of more than grain values onto the workers of pool. Each worker
+    // takes its nodes from allocators[its worker index].
+    template <class RandomIt>
+    Node* buildSubtreeParallel(RandomIt first, unsigned int n, Node* parent, std::vector<NodeAllocator>& allocators,
+                               TaskPool& pool, unsigned int grain);
+
+    // Links a node built from sorted values to its left and right subtrees, of
+    // left_size and right_size nodes, and sets its balance and subtree size.
+    static void linkBuiltNode(Node* n, Node* left, Node* right, Node* parent, unsigned int left_size,
+                              unsigned int right_size);
+
+private:
     // Sets copy constructor and assignment operator to private.
-    BinarySearchTree(const BinarySearchTree& other) {}
-    BinarySearchTree& operator=(const BinarySearchTree& other) {}
+    BasicBinarySearchTree(const BasicBinarySearchTree& other);
+    BasicBinarySearchTree& operator=(const BasicBinarySearchTree& other);
 
 
 public:
     // Default constructor to initialize the root.
-    BinarySearchTree();
+    BasicBinarySearchTree();
+
+    // Constructs a tree holding the values in [first, last), as build() does.
+    template <class ForwardIt>
+    BasicBinarySearchTree(ForwardIt first, ForwardIt last);
 
     // Destructor of the class BinarySearchTree. It deallocates the memory
     // space allocated for the binary search tree.
-    ~BinarySearchTree();
+    ~BasicBinarySearchTree();
+
+
+    // Removes every node from the tree in O(n) without recursion, or in O(1) when
+    // the nodes come from a NodePool.
+    void clear();
+
+    // Replaces the values of the tree with the values in [first, last), which must
+    // be sorted with no two of them equivalent. Builds a perfectly balanced tree,
+    // with its balances already set, in O(n) and without a single comparison.
+    template <class ForwardIt>
+    void build_from_sorted(ForwardIt first, ForwardIt last);
+
+    // Like build_from_sorted, but builds the two halves of every subtree of more
+    // than grain values in parallel on the workers of pool. Each worker allocates
+    // its nodes from a pool of its own, which are all handed to the tree at the
+    // end, so the nodes of a subtree built by one worker stay next to each other.
+    // Defined in parallel-avl-tree.h.
+    template <class RandomIt>
+    void build_from_sorted(RandomIt first, RandomIt last, TaskPool& pool, unsigned int grain = 1 << 14);
 
+    // Replaces the values of the tree with the values in [first, last) in any order.
+    // Sorted input is built in O(n), and anything else is copied and sorted first
+    // in O(n log n). Equivalent values are kept once. Returns the number of values
+    // that were dropped as duplicates.
+    template <class ForwardIt>
+    unsigned int build(ForwardIt first, ForwardIt last);
 
     // Returns the number of nodes in the tree.
     unsigned int size() const;
 
+    // Returns a read-only copy of the values in one flat array in Eytzinger order,
+    // in O(n), for trees that are only looked up from now on. It answers exists,
+    // lower_bound and range scans faster than the tree, in sizeof(Key) bytes per
+    // value. The tree itself is left as it is. Needs frozen-tree.h.
+    BasicFrozenTree<Key, Compare> freeze() const;
+
+    // Writes the values of the tree to the file path as a snapshot (see snapshot.h),
+    // in order and in one pass through a buffer. The file is replaced only once
+    // the whole snapshot is on disk. Returns false, leaving path as it was, if it
+    // could not be written. Keys must be trivially copyable. Needs snapshot.h, as
+    // load does.
+    bool save(const std::string& path) const;
+
+    // Replaces the values of the tree with those of the snapshot at path, building
+    // the tree from the file in one pass in O(n), as build_from_sorted does.
+    // Returns false, leaving the tree empty, if the file cannot be read, is not a
+    // snapshot of this key type, or fails its checksum or order check. A snapshot
+    // can also be searched without loading it, through a BasicMappedSnapshot.
+    bool load(const std::string& path);
+
+    // Returns the number of nodes visited by the last call to insert, remove or
+    // exists, counting every node the operation read on its way down. Like
+    // stats(), this is counted only with LAB3_TREE_STATS defined, and is 0
+    // otherwise, so that lookups write nothing.
+    unsigned int nodesVisited() const;
+
+    // Returns what the operations of the tree have done since it was created or
+    // resetStats() was last called: counts and histograms of the nodes visited by
+    // insert, remove and exists, of rotations, comparisons and node allocations.
+    // Counting is compiled in only with LAB3_TREE_STATS defined, and costs
+    // nothing otherwise, when the snapshot is all zeros.
+    TreeStats stats() const;
+    void resetStats();
+
     // Returns the maximum value of a node in the tree. You can assume that
     // this function will never be called on an empty tree.
-    DataType max() const;
+    const DataType& max() const;
     
     // Returns the minimum value of a node in the tree. You can assume that
     // this function will never be called on an empty tree.
-    DataType min() const;
+    const DataType& min() const;
     
     // Returns the maximum depth of the tree. A tree with only the root node has a
     // depth of 0. You can assume that this function will never be called on an
@@ -64,8 +287,46 @@ public:
     
     // Returns true if a node with the value val exists in the tree; otherwise,
     // it returns false.
-    bool exists(DataType val) const;
+    bool exists(KeyParam val) const;
     
+    // Returns iterators to the smallest value, and to past the largest value.
+    iterator begin() const;
+    iterator end() const;
+
+    // Returns an iterator to the first value that is not less than val (lower_bound)
+    // or greater than val (upper_bound), or end() if there is none.
+    iterator lower_bound(KeyParam val) const;
+    iterator upper_bound(KeyParam val) const;
+
+    // Returns the range of values equivalent to val, which is empty or holds one value.
+    std::pair<iterator, iterator> equal_range(KeyParam val) const;
+
+    // Calls visit(value) for every value in [lo, hi) in order. This takes
+    // O(log n + k) for k values and never allocates.
+    template <class Visitor>
+    void scan(KeyParam lo, KeyParam hi, Visitor visit) const;
+
+    // Copies the values in order into buffer, and hands each full buffer, and then
+    // the last partial one, to sink(const DataType* values, std::size_t count),
+    // which returns false to stop the export early. The walk follows the parent
+    // links, so it needs no recursion or stack at any depth, never allocates and
+    // leaves the tree untouched. capacity must be at least 1. Returns the number
+    // of values handed to sink.
+    template <class Sink>
+    std::size_t exportInOrder(DataType* buffer, std::size_t capacity, Sink sink) const;
+
+    // Returns the number of values less than val. Needs Augment = SubtreeSize, and
+    // takes O(depth).
+    unsigned int rank(KeyParam val) const;
+
+    // Returns an iterator to the k-th smallest value (counting from 0), or end()
+    // if k >= size(). Needs Augment = SubtreeSize, and takes O(depth).
+    iterator select(unsigned int k) const;
+
+    // Returns the number of values in [lo, hi). Needs Augment = SubtreeSize, and
+    // takes O(depth).
+    unsigned int count_range(KeyParam lo, KeyParam hi) const;
+
     // Returns a pointer to the root node
     Node* getRootNode();
     
@@ -73,15 +334,715 @@ public:
     Node** getRootNodeAddress();
 
     // Inserts the value val into the tree. Returns false if val already exists in
-    // the tree, and true otherwise.
-    bool insert(DataType val);
+    // the tree, and true otherwise. An rvalue is moved into the new node.
+    bool insert(const DataType& val);
+    bool insert(DataType&& val);
 
     // Removes the node with the value val from the tree. Returns true if successful,
     // and false otherwise.
-    bool remove(DataType val);
+    bool remove(KeyParam val);
 
-    // Update the avlBalance starting at node n (optional)
-    void updateNodeBalance(Node* n); //?
+    // Recomputes the avlBalance of n and of every node below it in O(size of the
+    // subtree). AVLTree keeps the balances up to date on every insert and remove,
+    // so this is only needed after using the plain BinarySearchTree operations.
+    void updateNodeBalance(Node* n);
 };
 
+// The tree of ints with pooled nodes, the one that allocates each node with new,
+// and the one that keeps subtree sizes.
+typedef BasicBinarySearchTree<int> BinarySearchTree;
+typedef BasicBinarySearchTree<int, std::less<int>, std::allocator<int> > HeapBinarySearchTree;
+typedef BasicBinarySearchTree<int, std::less<int>, NodePool<int>, SubtreeSize> OrderStatisticBinarySearchTree;
+
+template <class Key, class Compare, class Allocator, class Augment>
+int BasicBinarySearchTree<Key, Compare, Allocator, Augment>::getNodeDepth(Node* n) const {
+    if (n->left == nullptr && n->right == nullptr) return 0; // base case
+
+    int left_subtree_height = 0, right_subtree_height = 0;
+
+    if (n->left != nullptr) left_subtree_height = getNodeDepth(n->left);
+    if (n->right != nullptr) right_subtree_height = getNodeDepth(n->right);
+
+    if (left_subtree_height >= right_subtree_height) return 1 + left_subtree_height;
+    else return 1 + right_subtree_height;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+int BasicBinarySearchTree<Key, Compare, Allocator, Augment>::updateNodeHeight(Node* n) {
+    if (n == nullptr) return -1; // base case
+
+    int left_subtree_height = updateNodeHeight(n->left);
+    int right_subtree_height = updateNodeHeight(n->right);
+    n->avlBalance = right_subtree_height - left_subtree_height;
+
+    if (left_subtree_height >= right_subtree_height) return 1 + left_subtree_height;
+    else return 1 + right_subtree_height;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+BasicBinarySearchTree<Key, Compare, Allocator, Augment>::BasicBinarySearchTree() {
+    root_ = nullptr;
+    size_ = 0;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class ForwardIt>
+BasicBinarySearchTree<Key, Compare, Allocator, Augment>::BasicBinarySearchTree(ForwardIt first, ForwardIt last) {
+    root_ = nullptr;
+    size_ = 0;
+    build(first, last);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+BasicBinarySearchTree<Key, Compare, Allocator, Augment>::~BasicBinarySearchTree() {
+    clear();
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicBinarySearchTree<Key, Compare, Allocator, Augment>::clear() {
+
+    // a pool can drop all of its nodes at once, since they need no destructor
+    if (!std::is_trivially_destructible<Node>::value || !releaseAll(allocator_)) deleteSubtree(root_);
+    else stats_.deallocated(size_);
+
+    root_ = nullptr;
+    size_ = 0;
+    top_.rebuild(root_, size_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+unsigned int BasicBinarySearchTree<Key, Compare, Allocator, Augment>::deleteSubtree(Node* n) {
+
+    // free the nodes in a single pass: rotate away any left child so the root
+    // never has one, then delete the root and move to its right child
+    unsigned int deleted = 0;
+
+    while (n != nullptr) {
+        if (n->left != nullptr) {
+            Node* left = n->left;
+            n->left = left->right;
+            left->right = n;
+            n = left;
+        }
+        else {
+            Node* right = n->right;
+            deleteNode(n);
+            deleted++;
+            n = right;
+        }
+    }
+
+    return deleted;
+}
+
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class ForwardIt>
+void BasicBinarySearchTree<Key, Compare, Allocator, Augment>::build_from_sorted(ForwardIt first, ForwardIt last) {
+    clear();
+    size_ = std::distance(first, last);
+    root_ = buildSubtree(first, size_, nullptr, allocator_);
+    stats_.allocated(size_);
+    top_.rebuild(root_, size_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class ForwardIt>
+unsigned int BasicBinarySearchTree<Key, Compare, Allocator, Augment>::build(ForwardIt first, ForwardIt last) {
+
+    // input that is already strictly increasing can be built directly
+    auto out_of_order = [this](const Key& a, const Key& b) { return !compare_(a, b); };
+    if (std::adjacent_find(first, last, out_of_order) == last) {
+        build_from_sorted(first, last);
+        return 0;
+    }
+
+    // otherwise sort a copy, and keep only the first of each run of equivalent values
+    std::vector<Key> sorted(first, last);
+    std::sort(sorted.begin(), sorted.end(), compare_);
+    typename std::vector<Key>::iterator unique_end = std::unique(sorted.begin(), sorted.end(), out_of_order);
+
+    build_from_sorted(std::make_move_iterator(sorted.begin()), std::make_move_iterator(unique_end));
+    return sorted.end() - unique_end;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class ForwardIt>
+typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::Node* BasicBinarySearchTree<Key, Compare, Allocator, Augment>::buildSubtree(ForwardIt& first, unsigned int n, Node* parent,
+                                                                                                                                                   NodeAllocator& allocator) {
+    if (n == 0) return nullptr; // base case
+
+    // the smaller half goes left, so the right subtree is at most one level taller
+    unsigned int left_size = (n - 1) / 2;
+    unsigned int right_size = n / 2;
+
+    // build in order, so that the values are read from first in order
+    Node* left = buildSubtree(first, left_size, nullptr, allocator);
+    Node* subtree_root = allocator.allocate(1);
+    new (subtree_root) Node(*first);
+    ++first;
+    Node* right = buildSubtree(first, right_size, subtree_root, allocator);
+    if (left != nullptr) left->parent = subtree_root;
+
+    linkBuiltNode(subtree_root, left, right, parent, left_size, right_size);
+    return subtree_root;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicBinarySearchTree<Key, Compare, Allocator, Augment>::linkBuiltNode(Node* n, Node* left, Node* right, Node* parent,
+                                                                            unsigned int left_size, unsigned int right_size) {
+    n->left = left;
+    n->right = right;
+    n->parent = parent;
+
+    // a perfectly balanced subtree of n nodes has a height of floor(log2(n))
+    int left_height = -1, right_height = -1;
+    for (unsigned int i = left_size; i != 0; i >>= 1) left_height++;
+    for (unsigned int i = right_size; i != 0; i >>= 1) right_height++;
+    n->avlBalance = right_height - left_height;
+    Augment::recount(n);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class... Args>
+typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::Node* BasicBinarySearchTree<Key, Compare, Allocator, Augment>::newNode(Args&&... args) {
+    Node* n = allocator_.allocate(1);
+    new (n) Node(std::forward<Args>(args)...);
+    stats_.allocated(1);
+    return n;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicBinarySearchTree<Key, Compare, Allocator, Augment>::deleteNode(Node* n) {
+    n->~Node();
+    allocator_.deallocate(n, 1);
+    stats_.deallocated(1);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicBinarySearchTree<Key, Compare, Allocator, Augment>::addToAncestorSizes(Node* n, int delta) {
+    if (!Augment::countsSubtrees) return;
+    for (; n != nullptr; n = n->parent) Augment::addToSize(n, delta);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+unsigned int BasicBinarySearchTree<Key, Compare, Allocator, Augment>::size() const {
+    return size_;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+unsigned int BasicBinarySearchTree<Key, Compare, Allocator, Augment>::nodesVisited() const {
+    return stats_.lastVisited();
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+TreeStats BasicBinarySearchTree<Key, Compare, Allocator, Augment>::stats() const {
+    return stats_.snapshot(compare_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicBinarySearchTree<Key, Compare, Allocator, Augment>::resetStats() {
+    stats_.reset(compare_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+const typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::DataType& BasicBinarySearchTree<Key, Compare, Allocator, Augment>::max() const {
+
+    Node* current = root_;
+    while (current->right != nullptr) current = current->right; // search to the right until max value is found
+    return current->val;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+const typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::DataType& BasicBinarySearchTree<Key, Compare, Allocator, Augment>::min() const {
+
+    Node* current = root_;
+    while (current->left != nullptr) current = current->left; // search to the left until min value is found
+    return current->val;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+unsigned int BasicBinarySearchTree<Key, Compare, Allocator, Augment>::depth() const {
+    return getNodeDepth(root_);
+}
+
+// helper function for printing a tree in order, following the parent links
+// rather than recursing, so that a degenerate tree cannot overflow the stack
+template <class Key, class Augment>
+void inOrderTraversal(BinarySearchTreeNode<Key, Augment> *T) {
+    typedef TreeIterator<BinarySearchTreeNode<Key, Augment>, const Key> Iterator;
+    if (T == nullptr) return;
+
+    // the walk ends at the value that follows the largest one of the subtree
+    Iterator first(T, nullptr), last(T, nullptr);
+    while (first.node()->left != nullptr) first = Iterator(first.node()->left, nullptr);
+    while (last.node()->right != nullptr) last = Iterator(last.node()->right, nullptr);
+    ++last;
+
+    for (Iterator it = first; it != last; ++it) {
+        std::cout << *it << '(' << it.node()->avlBalance << ')' << ", ";
+    }
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicBinarySearchTree<Key, Compare, Allocator, Augment>::print() const {
+
+    // Keep track of the nodes, to print in a
+    // breadth first (level order) traversal.
+    std::queue<Node*> q;
+
+    // Seed the jobs with the root.
+    if (root_ != nullptr)
+        q.push(root_);
+
+    // Walk through the tree, adding nodes to the
+    // queue level-by-level.
+    std::cout << "(";
+    while (!q.empty()) {
+
+        // Get the current node from the queue, and remove it.
+        Node* cur = q.front();
+        q.pop();
+
+        // Print out the nodes value.
+        //std::cout << cur->val << '(' << (cur->avlBalance) << ')' <<" ";
+        std::cout << cur->val << " ";
+        // Check to see if the current node has left or right children,
+        // if they exist, add them to the queue.
+        if (cur->left != nullptr)
+            q.push(cur->left);
+        if (cur->right != nullptr)
+            q.push(cur->right);
+    }
+    std::cout << ")" << std::endl;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+bool BasicBinarySearchTree<Key, Compare, Allocator, Augment>::save(const std::string& path) const {
+    SnapshotWriter<Key> writer;
+    if (!writer.open(path, size_)) return false;
+    for (iterator it = begin(); it != end(); ++it) writer.write(*it);
+    return writer.commit();
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+bool BasicBinarySearchTree<Key, Compare, Allocator, Augment>::load(const std::string& path) {
+    clear();
+
+    SnapshotReader<Key, Compare> reader;
+    if (!reader.open(path) || reader.size() > UINT_MAX) return false;
+
+    // the reader checks the order and checksum as the tree is built, and only says at the end
+    size_ = reader.size();
+    root_ = buildSubtree(reader, size_, nullptr, allocator_);
+    stats_.allocated(size_);
+    if (!reader.finish()) {
+        clear();
+        return false;
+    }
+    top_.rebuild(root_, size_);
+    return true;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+BasicFrozenTree<Key, Compare> BasicBinarySearchTree<Key, Compare, Allocator, Augment>::freeze() const {
+    return BasicFrozenTree<Key, Compare>(begin(), end());
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+bool BasicBinarySearchTree<Key, Compare, Allocator, Augment>::exists(KeyParam val) const {
+
+    // the index answers for the top levels, or tells which subtree below them to search
+    unsigned int visited = 0;
+    TreeStatsScope scope(stats_, TreeStats::EXISTS, visited);
+    bool found = false;
+    Node* current = top_.find(val, root_, found);
+    if (found) return true;
+
+    while (current != nullptr) {
+        visited++;
+        if (compare_(val, current->val)) current = current->left;
+        else if (compare_(current->val, val)) current = current->right;
+        else return true;
+    }
+
+    return false;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class K>
+typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::Node* BasicBinarySearchTree<Key, Compare, Allocator, Augment>::findNode(const K& key) const {
+    Node* current = root_;
+
+    while (current != nullptr) {
+        if (compare_(key, current->val)) current = current->left;
+        else if (compare_(current->val, key)) current = current->right;
+        else return current;
+    }
+
+    return nullptr;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::Node* BasicBinarySearchTree<Key, Compare, Allocator, Augment>::getRootNode() {
+    return root_;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::Node** BasicBinarySearchTree<Key, Compare, Allocator, Augment>::getRootNodeAddress() {
+    return &root_;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::iterator BasicBinarySearchTree<Key, Compare, Allocator, Augment>::begin() const {
+    Node* current = root_;
+    if (current != nullptr) {
+        while (current->left != nullptr) current = current->left;
+    }
+    return iterator(current, &root_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::iterator BasicBinarySearchTree<Key, Compare, Allocator, Augment>::end() const {
+    return iterator(nullptr, &root_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class K>
+typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::Node* BasicBinarySearchTree<Key, Compare, Allocator, Augment>::lowerBoundNode(const K& key) const {
+    Node* current = root_;
+    Node* bound = nullptr;
+
+    // the bound is the last node we went left at, or the node equal to key
+    while (current != nullptr) {
+        if (compare_(current->val, key)) current = current->right;
+        else {
+            bound = current;
+            current = current->left;
+        }
+    }
+
+    return bound;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class K>
+typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::Node* BasicBinarySearchTree<Key, Compare, Allocator, Augment>::upperBoundNode(const K& key) const {
+    Node* current = root_;
+    Node* bound = nullptr;
+
+    // the bound is the last node we went left at
+    while (current != nullptr) {
+        if (compare_(key, current->val)) {
+            bound = current;
+            current = current->left;
+        }
+        else current = current->right;
+    }
+
+    return bound;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::iterator BasicBinarySearchTree<Key, Compare, Allocator, Augment>::lower_bound(KeyParam val) const {
+    return iterator(lowerBoundNode(val), &root_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::iterator BasicBinarySearchTree<Key, Compare, Allocator, Augment>::upper_bound(KeyParam val) const {
+    return iterator(upperBoundNode(val), &root_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+std::pair<typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::iterator, typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::iterator>
+BasicBinarySearchTree<Key, Compare, Allocator, Augment>::equal_range(KeyParam val) const {
+    iterator first = lower_bound(val);
+    iterator last = first;
+    if (last != end() && !compare_(val, *last)) ++last;
+    return std::make_pair(first, last);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class K, class Visitor>
+void BasicBinarySearchTree<Key, Compare, Allocator, Augment>::scanRange(const K& lo, const K& hi, Visitor& visit) const {
+    iterator it(lowerBoundNode(lo), &root_);
+    iterator last = end();
+
+    while (it != last && compare_(*it, hi)) {
+        visit(*it);
+        ++it;
+    }
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class Visitor>
+void BasicBinarySearchTree<Key, Compare, Allocator, Augment>::scan(KeyParam lo, KeyParam hi, Visitor visit) const {
+    scanRange(lo, hi, visit);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class Sink>
+std::size_t BasicBinarySearchTree<Key, Compare, Allocator, Augment>::exportInOrder(DataType* buffer, std::size_t capacity,
+                                                                                  Sink sink) const {
+    std::size_t exported = 0, filled = 0;
+    for (iterator it = begin(), last = end(); it != last; ++it) {
+        buffer[filled++] = *it;
+        if (filled < capacity) continue;
+
+        exported += filled;
+        filled = 0;
+        if (!sink(static_cast<const DataType*>(buffer), capacity)) return exported;
+    }
+
+    if (filled > 0) {
+        exported += filled;
+        sink(static_cast<const DataType*>(buffer), filled);
+    }
+    return exported;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+unsigned int BasicBinarySearchTree<Key, Compare, Allocator, Augment>::rank(KeyParam val) const {
+    static_assert(Augment::countsSubtrees, "rank needs a tree with Augment = SubtreeSize");
+    Node* current = root_;
+    unsigned int less = 0;
+
+    // every time we go right, the left subtree and the current node are less than val
+    while (current != nullptr) {
+        if (compare_(current->val, val)) {
+            less += Augment::sizeOf(current->left) + 1;
+            current = current->right;
+        }
+        else current = current->left;
+    }
+
+    return less;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::iterator BasicBinarySearchTree<Key, Compare, Allocator, Augment>::select(unsigned int k) const {
+    static_assert(Augment::countsSubtrees, "select needs a tree with Augment = SubtreeSize");
+    Node* current = root_;
+
+    // k counts the values of the current subtree that are still to be skipped
+    while (current != nullptr) {
+        unsigned int left_size = Augment::sizeOf(current->left);
+
+        if (k < left_size) current = current->left;
+        else if (k > left_size) {
+            k -= left_size + 1;
+            current = current->right;
+        }
+        else break;
+    }
+
+    return iterator(current, &root_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+unsigned int BasicBinarySearchTree<Key, Compare, Allocator, Augment>::count_range(KeyParam lo, KeyParam hi) const {
+    if (!compare_(lo, hi)) return 0;
+    return rank(hi) - rank(lo);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+bool BasicBinarySearchTree<Key, Compare, Allocator, Augment>::insert(const DataType& val) {
+    return insertValue(val);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+bool BasicBinarySearchTree<Key, Compare, Allocator, Augment>::insert(DataType&& val) {
+    return insertValue(std::move(val));
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class K>
+bool BasicBinarySearchTree<Key, Compare, Allocator, Augment>::insertValue(K&& val) {
+
+    unsigned int visited = 0;
+    TreeStatsScope scope(stats_, TreeStats::INSERT, visited);
+    IndexRefresh refresh(top_, root_, size_);
+
+    // empty BST
+    if (root_ == nullptr) {
+        top_.touched(0);
+        root_ = newNode(std::forward<K>(val));
+        size_++;
+        return true;
+    }
+
+    // general insert
+    Node* current = root_;
+    Node* parent = nullptr;
+
+    // search for insert location
+    while (current != nullptr) {
+
+        parent = current;
+        visited++;
+
+        if (compare_(val, current->val)) current = current->left;
+        else if (compare_(current->val, val)) current = current->right;
+        else return false; // the value is already in the tree
+    }
+
+    // determine whether to insert at left or right, one level below the visited nodes
+    top_.touched(visited);
+    Node* inserted = newNode(std::forward<K>(val));
+    inserted->parent = parent;
+    if (compare_(inserted->val, parent->val)) parent->left = inserted;
+    else parent->right = inserted;
+    addToAncestorSizes(parent, 1);
+    size_++;
+    return true;
+
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+bool BasicBinarySearchTree<Key, Compare, Allocator, Augment>::remove(KeyParam val) {
+
+    // find the node to delete
+    Node* current = root_;
+    Node* parent = nullptr;
+    bool isLeftChild = false;
+    bool isFound = false;
+    unsigned int visited = 0;
+    TreeStatsScope scope(stats_, TreeStats::REMOVE, visited);
+    IndexRefresh refresh(top_, root_, size_);
+
+    while (current != nullptr) {
+        visited++;
+
+        if (compare_(val, current->val)) {
+            parent = current;
+            isLeftChild = true;
+            current = current->left;
+        }
+        else if (compare_(current->val, val)) {
+            parent = current;
+            isLeftChild = false;
+            current = current->right;
+        }
+        else {
+            isFound = true;
+            break;
+        }
+    }
+
+    if (!isFound) return false;
+
+    // every case changes the link to current or current's value, and the rest is below it
+    top_.touched(visited - 1);
+
+    // Case 1: leaf node
+    if (current->left == nullptr  && current->right == nullptr) {
+
+        // Case 1a: root node with no children
+        if (current == root_) {
+            deleteNode(root_);
+            root_ = nullptr;
+            size_--;
+            return true;
+        }
+
+        // Case 1b: general node with no children
+        deleteNode(current);
+        if (isLeftChild) parent->left = nullptr;
+        else parent->right = nullptr;
+        addToAncestorSizes(parent, -1);
+        size_--;
+        return true;
+    }
+
+    // Case 2: one-child node
+    if (current->left != nullptr && current->right == nullptr) {
+
+        // Case 2a: parent node with right child
+        if (current == root_) {
+            Node* temp = root_;
+            root_ = root_->left;
+            root_->parent = nullptr;
+            deleteNode(temp);
+            size_--;
+            return true;
+        }
+
+        // Case 2b: general case with right child
+        if (isLeftChild) parent->left = current->left;
+        else parent->right = current->left;
+        current->left->parent = parent;
+        addToAncestorSizes(parent, -1);
+        deleteNode(current);
+        size_--;
+        return true;
+    }
+
+    else if (current->left == nullptr && current->right != nullptr) {
+
+        // Case 2c: parent node with right child
+        if (current == root_) {
+            Node* temp = root_;
+            root_ = root_->right;
+            root_->parent = nullptr;
+            deleteNode(temp);
+            size_--;
+            return true;
+        }
+
+        // Case 2d: general case with left child
+        if (isLeftChild) parent->left = current->right;
+        else parent->right = current->right;
+        current->right->parent = parent;
+        addToAncestorSizes(parent, -1);
+        deleteNode(current);
+        size_--;
+        return true;
+    }
+
+    // Case 3: two-child node
+    if (current->left != nullptr && current->right != nullptr) {
+
+        // Search for predecessor
+        Node* predecessor = current->left;
+        isLeftChild = true;
+        Node* predecessor_parent = current;
+
+        visited++;
+        while (predecessor->right != nullptr) {
+            visited++;
+            predecessor_parent = predecessor;
+            predecessor = predecessor->right;
+            isLeftChild = false;
+        }
+
+        // Replace the current node's value with the predecessor's value
+        current->val = std::move(predecessor->val);
+
+        // delete predecessor
+        if (predecessor->left == nullptr) { // we already know predecessor->right is nullptr
+            if (isLeftChild) predecessor_parent->left = nullptr;
+            else predecessor_parent-> right = nullptr;
+        }
+        else { // right child is empty but left child is not
+            if (isLeftChild) predecessor_parent->left = predecessor->left;
+            else predecessor_parent->right = predecessor->left;
+            predecessor->left->parent = predecessor_parent;
+        }
+
+        addToAncestorSizes(predecessor_parent, -1);
+        deleteNode(predecessor);
+        size_--;
+        return true;
+
+    }
+
+    return false;
+
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicBinarySearchTree<Key, Compare, Allocator, Augment>::updateNodeBalance(Node* n) {
+    updateNodeHeight(n);
+}
+
 #endif
@@ -0,0 +1,427 @@
+#ifndef LAB3_COMPACT_AVL_TREE_H
+#define LAB3_COMPACT_AVL_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "tree-stats.h"
+
+// A node of a compact AVL tree. Children are 32-bit indices into the tree's
+// arena instead of pointers, 0 standing for no child, and the balance sits in
+// the two low bits of the right index, so a node of an int key is 12 bytes.
+template <class Key>
+struct CompactAVLTreeNode {
+    typedef Key DataType;
+
+    std::uint32_t left;   // Index of the left child.
+    std::uint32_t right;  // Index of the right child shifted left by 2, plus the balance + 1.
+    DataType val;         // Value of the node.
+};
+
+// AVL tree that trades the pointers of AVLTree for indices, for sets whose
+// memory matters more than anything else. There are no parent pointers (so no
+// iterators), and a node costs 8 bytes on top of its key: 12 bytes per int
+// against 32 for a node of AVLTree.
+//
+// The nodes live in an arena of fixed-size blocks, which grows one block at a
+// time and so holds at most one block of unused slots beyond the freed ones. The
+// first block starts small and doubles until it is full size, so that small
+// trees stay small too. Freed nodes are reused by the next inserts, and the
+// memory is only released by clear() or the destructor. A tree holds at most
+// 2^30 - 1 values.
+template <class Key, class Compare = std::less<Key> >
+class BasicCompactAVLTree {
+public:
+    typedef Key DataType;
+    typedef CompactAVLTreeNode<Key> Node;
+
+    BasicCompactAVLTree();
+
+    // Removes every value from the tree and releases the arena.
+    void clear();
+
+    // Returns the number of values in the tree.
+    unsigned int size() const;
+
+    // Returns the number of bytes the arena takes up, including unused slots.
+    std::size_t memoryUsed() const;
+
+    // Returns the number of nodes visited by the last call to insert, remove or
+    // exists, counting every node the operation read on its way down. Only kept
+    // when built with LAB3_TREE_STATS; otherwise it returns 0.
+    unsigned int nodesVisited() const;
+
+    // Returns true if val is in the tree; otherwise, it returns false.
+    bool exists(const DataType& val) const;
+
+    // Calls visit(value) for every value in [lo, hi) in order.
+    template <class Visitor>
+    void scan(const DataType& lo, const DataType& hi, Visitor visit) const;
+
+    // Inserts val into the tree. Returns false if val already exists in the tree,
+    // and true otherwise.
+    bool insert(const DataType& val);
+
+    // Removes val from the tree. Returns true if successful, and false otherwise.
+    bool remove(const DataType& val);
+
+private:
+    friend class CompactAVLTreeTest;
+
+    // The arena is made of blocks of 2^BLOCK_BITS nodes, but the first one starts
+    // with MIN_BLOCK_SIZE of them.
+    static const unsigned int BLOCK_BITS = 16;
+    static const std::uint32_t BLOCK_SIZE = 1u << BLOCK_BITS;
+    static const std::uint32_t MIN_BLOCK_SIZE = 16;
+
+    // Indices take 30 bits, so the largest one is this.
+    static const std::uint32_t MAX_INDEX = (1u << 30) - 1;
+
+    // An AVL tree of fewer than 2^30 nodes is never taller than this.
+    static const int MAX_HEIGHT = 48;
+
+    // Blocks of the arena, the first of which starts with the unused index 0.
+    std::vector<std::unique_ptr<Node[]> > blocks_;
+
+    std::uint32_t root_;  // Index of the root node, 0 if the tree is empty.
+    std::uint32_t next_;  // Next index never used yet.
+    std::uint32_t slots_; // Number of indices the blocks hold.
+    std::uint32_t free_;  // First freed node, linked through left, or 0.
+    unsigned int size_;   // Number of values in the tree.
+
+    // Number of nodes visited by the last insert, remove or exists.
+    mutable VisitCount visited_;
+
+    Compare compare_;
+
+    // Returns the node at index i.
+    Node& at(std::uint32_t i) { return blocks_[i >> BLOCK_BITS][i & (BLOCK_SIZE - 1)]; }
+    const Node& at(std::uint32_t i) const { return blocks_[i >> BLOCK_BITS][i & (BLOCK_SIZE - 1)]; }
+
+    // Get or set the right child and the balance (-1, 0 or 1) of the node at index i.
+    std::uint32_t right(std::uint32_t i) const { return at(i).right >> 2; }
+    int balance(std::uint32_t i) const { return (int)(at(i).right & 3) - 1; }
+    void setRight(std::uint32_t i, std::uint32_t child) { at(i).right = (child << 2) | (at(i).right & 3); }
+    void setBalance(std::uint32_t i, int balance) { at(i).right = (at(i).right & ~3u) | (std::uint32_t)(balance + 1); }
+
+    // Returns the child of i on the right if right is true, or on the left.
+    std::uint32_t child(std::uint32_t i, bool right) const { return right ? this->right(i) : at(i).left; }
+    void setChild(std::uint32_t i, bool right, std::uint32_t child);
+
+    // Makes room for the index next_ in the arena.
+    void grow();
+
+    // Returns the index of a new leaf holding val, or puts the node at index i back.
+    std::uint32_t newNode(const Key& val);
+    void deleteNode(std::uint32_t i);
+
+    // Rotate the subtree i and return the index of its new root.
+    std::uint32_t rotateLeft(std::uint32_t i);
+    std::uint32_t rotateRight(std::uint32_t i);
+
+    // Restores the balance of the subtree i, whose balance is now 2 or -2
+    // (given), by rotating. Returns the index of its new root, and sets shrank
+    // to whether the subtree is now one level shorter than before rotating.
+    std::uint32_t rebalance(std::uint32_t i, int balance, bool& shrank);
+
+    // Sets copy constructor and assignment operator to private.
+    BasicCompactAVLTree(const BasicCompactAVLTree& other);
+    BasicCompactAVLTree& operator=(const BasicCompactAVLTree& other);
+};
+
+typedef BasicCompactAVLTree<int> CompactAVLTree;
+
+template <class Key, class Compare>
+BasicCompactAVLTree<Key, Compare>::BasicCompactAVLTree() : root_(0), next_(1), slots_(0), free_(0), size_(0) {}
+
+template <class Key, class Compare>
+void BasicCompactAVLTree<Key, Compare>::clear() {
+    blocks_.clear();
+    blocks_.shrink_to_fit();
+    root_ = 0;
+    next_ = 1;
+    slots_ = 0;
+    free_ = 0;
+    size_ = 0;
+}
+
+template <class Key, class Compare>
+unsigned int BasicCompactAVLTree<Key, Compare>::size() const {
+    return size_;
+}
+
+template <class Key, class Compare>
+std::size_t BasicCompactAVLTree<Key, Compare>::memoryUsed() const {
+    return (std::size_t)slots_ * sizeof(Node) + blocks_.capacity() * sizeof(blocks_[0]);
+}
+
+template <class Key, class Compare>
+unsigned int BasicCompactAVLTree<Key, Compare>::nodesVisited() const {
+    return visited_.value();
+}
+
+template <class Key, class Compare>
+void BasicCompactAVLTree<Key, Compare>::setChild(std::uint32_t i, bool right, std::uint32_t child) {
+    if (right) setRight(i, child);
+    else at(i).left = child;
+}
+
+template <class Key, class Compare>
+void BasicCompactAVLTree<Key, Compare>::grow() {
+    if (next_ > MAX_INDEX) throw std::bad_alloc();
+
+    if (slots_ >= BLOCK_SIZE) {
+        blocks_.push_back(std::unique_ptr<Node[]>(new Node[BLOCK_SIZE]));
+        slots_ += BLOCK_SIZE;
+        return;
+    }
+
+    // the first block is copied into one twice the size, which keeps every index
+    std::uint32_t size = slots_ == 0 ? MIN_BLOCK_SIZE : 2 * slots_;
+    std::unique_ptr<Node[]> block(new Node[size]);
+    for (std::uint32_t i = 1; i < next_; ++i) block[i] = std::move(blocks_[0][i]);
+    if (blocks_.empty()) blocks_.push_back(std::move(block));
+    else blocks_[0] = std::move(block);
+    slots_ = size;
+}
+
+template <class Key, class Compare>
+std::uint32_t BasicCompactAVLTree<Key, Compare>::newNode(const Key& val) {
+    std::uint32_t i = free_;
+    if (i != 0) free_ = at(i).left;
+    else {
+        if (next_ >= slots_) grow();
+        i = next_++;
+    }
+
+    Node& n = at(i);
+    n.left = 0;
+    n.right = 1; // no right child, balanced
+    n.val = val;
+    return i;
+}
+
+template <class Key, class Compare>
+void BasicCompactAVLTree<Key, Compare>::deleteNode(std::uint32_t i) {
+    at(i).left = free_;
+    free_ = i;
+}
+
+template <class Key, class Compare>
+bool BasicCompactAVLTree<Key, Compare>::exists(const DataType& val) const {
+    std::uint32_t current = root_;
+    unsigned int visited = 0;
+
+    while (current != 0) {
+        visited++;
+        const Node& n = at(current);
+        if (compare_(val, n.val)) current = n.left;
+        else if (compare_(n.val, val)) current = n.right >> 2;
+        else break;
+    }
+
+    visited_.set(visited);
+    return current != 0;
+}
+
+template <class Key, class Compare>
+template <class Visitor>
+void BasicCompactAVLTree<Key, Compare>::scan(const DataType& lo, const DataType& hi, Visitor visit) const {
+
+    // the path to the next value to visit, as in an in-order walk with a stack
+    std::uint32_t stack[MAX_HEIGHT];
+    int depth = 0;
+
+    std::uint32_t current = root_;
+    while (current != 0) {
+        if (compare_(at(current).val, lo)) current = right(current);
+        else {
+            stack[depth++] = current;
+            current = at(current).left;
+        }
+    }
+
+    while (depth > 0) {
+        current = stack[--depth];
+        if (!compare_(at(current).val, hi)) return;
+        visit(at(current).val);
+
+        for (current = right(current); current != 0; current = at(current).left) stack[depth++] = current;
+    }
+}
+
+template <class Key, class Compare>
+std::uint32_t BasicCompactAVLTree<Key, Compare>::rotateLeft(std::uint32_t i) {
+    std::uint32_t pivot = right(i);
+    setRight(i, at(pivot).left);
+    at(pivot).left = i;
+    return pivot;
+}
+
+template <class Key, class Compare>
+std::uint32_t BasicCompactAVLTree<Key, Compare>::rotateRight(std::uint32_t i) {
+    std::uint32_t pivot = at(i).left;
+    at(i).left = right(pivot);
+    setRight(pivot, i);
+    return pivot;
+}
+
+template <class Key, class Compare>
+std::uint32_t BasicCompactAVLTree<Key, Compare>::rebalance(std::uint32_t i, int balance, bool& shrank) {
+    int side = balance > 0 ? 1 : -1;
+    std::uint32_t heavy = child(i, side > 0);
+    int heavy_balance = this->balance(heavy);
+
+    // the heavy child leans the same way, or not at all (only after a remove): one rotation
+    if (heavy_balance != -side) {
+        std::uint32_t root = (side > 0) ? rotateLeft(i) : rotateRight(i);
+        if (heavy_balance == 0) {
+            setBalance(i, side);
+            setBalance(root, -side);
+            shrank = false;
+        }
+        else {
+            setBalance(i, 0);
+            setBalance(root, 0);
+            shrank = true;
+        }
+        return root;
+    }
+
+    // it leans the other way: its inner child becomes the root of the subtree
+    std::uint32_t inner = child(heavy, side < 0);
+    int inner_balance = this->balance(inner);
+    setChild(i, side > 0, (side > 0) ? rotateRight(heavy) : rotateLeft(heavy));
+    std::uint32_t root = (side > 0) ? rotateLeft(i) : rotateRight(i);
+    setBalance(i, inner_balance == side ? -side : 0);
+    setBalance(heavy, inner_balance == -side ? side : 0);
+    setBalance(root, 0);
+    shrank = true;
+    return root;
+}
+
+template <class Key, class Compare>
+bool BasicCompactAVLTree<Key, Compare>::insert(const DataType& val) {
+
+    // search for the insert location, recording every ancestor and the side taken from it
+    std::uint32_t path[MAX_HEIGHT];
+    bool went_right[MAX_HEIGHT];
+    int depth = 0;
+    std::uint32_t current = root_;
+    unsigned int visited = 0;
+
+    while (current != 0) {
+        visited++;
+        path[depth] = current;
+        if (compare_(val, at(current).val)) went_right[depth] = false;
+        else if (compare_(at(current).val, val)) went_right[depth] = true;
+        else break;
+        current = child(current, went_right[depth++]);
+    }
+
+    visited_.set(visited);
+    if (current != 0) return false; // the value is already in the tree
+
+    std::uint32_t inserted = newNode(val);
+    if (depth == 0) root_ = inserted;
+    else setChild(path[depth - 1], went_right[depth - 1], inserted);
+    size_++;
+
+    // walk back up until the subtree height stops growing
+    while (depth > 0) {
+        std::uint32_t alpha = path[--depth];
+        int balance = this->balance(alpha) + (went_right[depth] ? 1 : -1);
+
+        if (balance == 0 || balance == 1 || balance == -1) {
+            setBalance(alpha, balance);
+            if (balance == 0) break; // the new node evened out this subtree
+            continue;
+        }
+
+        // a rotation restores the height the subtree had before the insert
+        bool shrank;
+        std::uint32_t root = rebalance(alpha, balance, shrank);
+        if (depth == 0) root_ = root;
+        else setChild(path[depth - 1], went_right[depth - 1], root);
+        break;
+    }
+
+    return true;
+}
+
+template <class Key, class Compare>
+bool BasicCompactAVLTree<Key, Compare>::remove(const DataType& val) {
+
+    // search for the node to delete, recording every ancestor and the side taken from it
+    std::uint32_t path[MAX_HEIGHT];
+    bool went_right[MAX_HEIGHT];
+    int depth = 0;
+    std::uint32_t current = root_;
+    unsigned int visited = 0;
+
+    while (current != 0) {
+        visited++;
+        if (compare_(val, at(current).val)) went_right[depth] = false;
+        else if (compare_(at(current).val, val)) went_right[depth] = true;
+        else break;
+        path[depth] = current;
+        current = child(current, went_right[depth++]);
+    }
+
+    visited_.set(visited);
+    if (current == 0) return false; // the value is not in the tree
+
+    // a node with two children takes the value of its predecessor, which is removed instead
+    if (at(current).left != 0 && right(current) != 0) {
+        std::uint32_t target = current;
+        path[depth] = current;
+        went_right[depth++] = false;
+        current = at(current).left;
+
+        while (right(current) != 0) {
+            visited++;
+            path[depth] = current;
+            went_right[depth++] = true;
+            current = right(current);
+        }
+        visited_.set(visited);
+        at(target).val = std::move(at(current).val);
+    }
+
+    // current now has at most one child, which takes its place
+    std::uint32_t replacement = (at(current).left != 0) ? at(current).left : right(current);
+    if (depth == 0) root_ = replacement;
+    else setChild(path[depth - 1], went_right[depth - 1], replacement);
+    deleteNode(current);
+    size_--;
+
+    // walk back up until the subtree height stops shrinking
+    while (depth > 0) {
+        std::uint32_t alpha = path[--depth];
+        int balance = this->balance(alpha) - (went_right[depth] ? 1 : -1);
+
+        if (balance == 1 || balance == -1) {
+            setBalance(alpha, balance);
+            break; // the other subtree is as tall as before
+        }
+        if (balance == 0) {
+            setBalance(alpha, 0);
+            continue;
+        }
+
+        bool shrank;
+        std::uint32_t root = rebalance(alpha, balance, shrank);
+        if (depth == 0) root_ = root;
+        else setChild(path[depth - 1], went_right[depth - 1], root);
+        if (!shrank) break;
+    }
+
+    return true;
+}
+
+#endif
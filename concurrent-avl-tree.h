@@ -0,0 +1,446 @@
+#ifndef LAB3_CONCURRENT_AVL_TREE_H
+#define LAB3_CONCURRENT_AVL_TREE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "epoch-reclamation.h"
+#include "node-pool.h"
+
+// A node of a concurrent AVL tree. Readers only look at key, present, left and
+// right, which are atomics so that a writer can change them under a reader, and
+// check version around what they read: a writer makes it odd while it changes the
+// node and even again after, so a reader that sees the same even version before
+// and after its reads knows they were consistent (a seqlock per node). The rest
+// is only touched by writers.
+template <class Key>
+struct ConcurrentAVLTreeNode {
+    typedef Key DataType;
+
+    explicit ConcurrentAVLTreeNode(const Key& val)
+        : version(0), key(val), present(true), left(nullptr), right(nullptr), parent(nullptr), height(1) {}
+
+    std::atomic<std::uint64_t> version;           // Odd while a writer changes the node.
+    std::atomic<Key> key;                         // Key of the node.
+    std::atomic<bool> present;                    // False once key was removed but the node still routes searches.
+    std::atomic<ConcurrentAVLTreeNode*> left;     // Pointer to the left node.
+    std::atomic<ConcurrentAVLTreeNode*> right;    // Pointer to the right node.
+    ConcurrentAVLTreeNode* parent;                // Pointer to the parent node.
+    int height;                                   // Height of the subtree, 1 for a leaf.
+};
+
+// AVL tree that any number of threads can search while others insert and remove.
+//
+// Readers take no lock. They walk down hand over hand, checking that a node's
+// version is unchanged after reading the next one's, so they only retry (from the
+// root) when a writer changed a node right on their path, and writers never wait
+// for them. Writers take a lock among themselves, and mark only the nodes they
+// actually change (the parent of an inserted or unlinked node, and the nodes of
+// each rotation on the rebalance path), so a write stalls no reader elsewhere in
+// the tree.
+//
+// Keys never move between nodes: a removed key whose node has two children stays
+// behind as a routing node, marked not present, until one of its subtrees empties
+// (or it is inserted again). Readers pin the epoch while they search, so a writer
+// retires unlinked nodes to RetiredNodes, which frees them in batches once no
+// reader can still be on them. Key must be trivially copyable.
+template <class Key, class Compare = std::less<Key>, class Allocator = NodePool<Key> >
+class BasicConcurrentAVLTree {
+public:
+    typedef Key DataType;
+    typedef ConcurrentAVLTreeNode<Key> Node;
+
+    static_assert(std::is_trivially_copyable<Key>::value, "readers copy keys that a writer may change");
+
+    BasicConcurrentAVLTree();
+
+    // Destructor of the class. No thread may use the tree any more.
+    ~BasicConcurrentAVLTree();
+
+    // Returns whether key is in the tree. Takes no lock, and can run at the same
+    // time as any other call.
+    bool exists(const DataType& key) const;
+
+    // Inserts or removes key, and returns whether the tree changed. Writers run one
+    // at a time, but do not stop readers.
+    bool insert(const DataType& key);
+    bool remove(const DataType& key);
+
+    // Returns the number of keys in the tree.
+    unsigned int size() const;
+
+private:
+    friend class ConcurrentAVLTreeTest;
+
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Node> NodeAllocator;
+
+    // Sentinel whose right child is the root, so that a new root is linked in like
+    // any other child and readers notice it the same way.
+    Node holder_;
+
+    // Number of keys present in the tree.
+    std::atomic<unsigned int> size_;
+
+    // Held by insert and remove.
+    std::mutex write_lock_;
+
+    NodeAllocator allocator_;
+    Compare compare_;
+
+    // Unlinked nodes that readers may still be on, used by writers only.
+    RetiredNodes<Node, NodeAllocator> retired_;
+
+    // Routing nodes that a rebalance left with one child or none, still to be
+    // unlinked, used by writers only.
+    std::vector<Node*> routing_;
+
+    // Returns the version of n once no writer is changing it.
+    static std::uint64_t stableVersion(const Node* n);
+
+    // Returns whether n still has the version a reader started with.
+    static bool unchanged(const Node* n, std::uint64_t version);
+
+    // Mark the start and end of a writer's change to n.
+    static void beginChange(Node* n);
+    static void endChange(Node* n);
+
+    // Returns the height of the subtree n, 0 if it is empty.
+    static int heightOf(const Node* n);
+
+    // Replaces the child old_child of parent with new_child. The caller marks parent as changing.
+    static void replaceChild(Node* parent, Node* old_child, Node* new_child);
+
+    // Returns a new node holding key.
+    Node* newNode(const Key& key);
+
+    // Unlinks n, which has at most one child, and retires it. Returns its parent.
+    Node* unlink(Node* n);
+
+    // Restores the heights and balance of every ancestor of a changed subtree,
+    // starting at n, and unlinks the routing nodes left with one child or none.
+    void rebalance(Node* n);
+
+    // Restores the heights and balance from n up, for a subtree whose height changed
+    // by at most one, and queues in routing_ every routing node on the way, or moved
+    // down by a rotation, that has one child or none.
+    void rebalancePath(Node* n);
+
+    // Queues n in routing_ if it is a routing node with one child or none.
+    void queueRouting(Node* n);
+
+    // Rotate the subtree n and return its new root.
+    Node* rotateLeft(Node* n);
+    Node* rotateRight(Node* n);
+
+    // Sets copy constructor and assignment operator to private.
+    BasicConcurrentAVLTree(const BasicConcurrentAVLTree& other);
+    BasicConcurrentAVLTree& operator=(const BasicConcurrentAVLTree& other);
+};
+
+typedef BasicConcurrentAVLTree<int> ConcurrentAVLTree;
+
+template <class Key, class Compare, class Allocator>
+BasicConcurrentAVLTree<Key, Compare, Allocator>::BasicConcurrentAVLTree() : holder_(Key()), size_(0) {}
+
+template <class Key, class Compare, class Allocator>
+BasicConcurrentAVLTree<Key, Compare, Allocator>::~BasicConcurrentAVLTree() {
+    retired_.releaseAll(allocator_);
+
+    std::vector<Node*> nodes;
+    if (holder_.right.load() != nullptr) nodes.push_back(holder_.right.load());
+
+    while (!nodes.empty()) {
+        Node* n = nodes.back();
+        nodes.pop_back();
+        if (n->left.load() != nullptr) nodes.push_back(n->left.load());
+        if (n->right.load() != nullptr) nodes.push_back(n->right.load());
+        n->~Node();
+        allocator_.deallocate(n, 1);
+    }
+}
+
+template <class Key, class Compare, class Allocator>
+std::uint64_t BasicConcurrentAVLTree<Key, Compare, Allocator>::stableVersion(const Node* n) {
+    std::uint64_t version = n->version.load(std::memory_order_acquire);
+    while (version & 1) {
+        std::this_thread::yield();
+        version = n->version.load(std::memory_order_acquire);
+    }
+    return version;
+}
+
+template <class Key, class Compare, class Allocator>
+bool BasicConcurrentAVLTree<Key, Compare, Allocator>::unchanged(const Node* n, std::uint64_t version) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return n->version.load(std::memory_order_relaxed) == version;
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicConcurrentAVLTree<Key, Compare, Allocator>::beginChange(Node* n) {
+    n->version.store(n->version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicConcurrentAVLTree<Key, Compare, Allocator>::endChange(Node* n) {
+    n->version.store(n->version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template <class Key, class Compare, class Allocator>
+bool BasicConcurrentAVLTree<Key, Compare, Allocator>::exists(const DataType& key) const {
+    const std::memory_order relaxed = std::memory_order_relaxed;
+    const std::memory_order acquire = std::memory_order_acquire;  // Sees a new child's fields once it is linked.
+
+    // no node can be freed while this reader may still be on it
+    EpochGuard guard;
+
+    while (true) {
+        const Node* n = &holder_;
+        std::uint64_t version = stableVersion(n);
+        const Node* child = n->right.load(acquire);
+
+        while (true) {
+            if (child == nullptr) {
+                if (unchanged(n, version)) return false;
+                break;
+            }
+
+            // child is only known to be n's child if n is unchanged after child's version is read
+            std::uint64_t child_version = stableVersion(child);
+            if (!unchanged(n, version)) break;
+            n = child;
+            version = child_version;
+
+            Key n_key = n->key.load(relaxed);
+            if (compare_(key, n_key)) child = n->left.load(acquire);
+            else if (compare_(n_key, key)) child = n->right.load(acquire);
+            else {
+                bool present = n->present.load(relaxed);
+                if (unchanged(n, version)) return present;
+                break;
+            }
+        }
+    }
+}
+
+template <class Key, class Compare, class Allocator>
+bool BasicConcurrentAVLTree<Key, Compare, Allocator>::insert(const DataType& key) {
+    std::lock_guard<std::mutex> guard(write_lock_);
+
+    // only writers change the tree, so they can read it without checking versions
+    Node* parent = &holder_;
+    Node* n = holder_.right;
+    bool left = false;
+    while (n != nullptr) {
+        Key n_key = n->key;
+        parent = n;
+        if (compare_(key, n_key)) {
+            n = n->left;
+            left = true;
+        }
+        else if (compare_(n_key, key)) {
+            n = n->right;
+            left = false;
+        }
+        else {
+            if (n->present) return false;
+
+            // a routing node holding key only has to be marked present again
+            beginChange(n);
+            n->present.store(true, std::memory_order_relaxed);
+            endChange(n);
+            size_++;
+            return true;
+        }
+    }
+
+    Node* inserted = newNode(key);
+    inserted->parent = parent;
+    beginChange(parent);
+    (left ? parent->left : parent->right).store(inserted, std::memory_order_release);
+    endChange(parent);
+    size_++;
+
+    rebalance(parent);
+    return true;
+}
+
+template <class Key, class Compare, class Allocator>
+bool BasicConcurrentAVLTree<Key, Compare, Allocator>::remove(const DataType& key) {
+    std::lock_guard<std::mutex> guard(write_lock_);
+
+    Node* n = holder_.right;
+    while (n != nullptr) {
+        Key n_key = n->key;
+        if (compare_(key, n_key)) n = n->left;
+        else if (compare_(n_key, key)) n = n->right;
+        else break;
+    }
+    if (n == nullptr || !n->present) return false;
+
+    beginChange(n);
+    n->present.store(false, std::memory_order_relaxed);
+    endChange(n);
+    size_--;
+
+    // a node with two children stays to route searches, since moving another key
+    // into its place could hide that key from a reader below it
+    if (n->left == nullptr || n->right == nullptr) rebalance(unlink(n));
+    return true;
+}
+
+template <class Key, class Compare, class Allocator>
+unsigned int BasicConcurrentAVLTree<Key, Compare, Allocator>::size() const {
+    return size_.load(std::memory_order_relaxed);
+}
+
+template <class Key, class Compare, class Allocator>
+int BasicConcurrentAVLTree<Key, Compare, Allocator>::heightOf(const Node* n) {
+    return n != nullptr ? n->height : 0;
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicConcurrentAVLTree<Key, Compare, Allocator>::replaceChild(Node* parent, Node* old_child, Node* new_child) {
+    if (parent->left.load(std::memory_order_relaxed) == old_child) parent->left.store(new_child, std::memory_order_release);
+    else parent->right.store(new_child, std::memory_order_release);
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicConcurrentAVLTree<Key, Compare, Allocator>::Node* BasicConcurrentAVLTree<Key, Compare, Allocator>::newNode(
+        const Key& key) {
+    Node* n = allocator_.allocate(1);
+    new (n) Node(key);
+    return n;
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicConcurrentAVLTree<Key, Compare, Allocator>::Node* BasicConcurrentAVLTree<Key, Compare, Allocator>::unlink(
+        Node* n) {
+    Node* parent = n->parent;
+    Node* child = (n->left != nullptr) ? n->left : n->right;
+
+    // n changes too, so that a reader on n retries instead of following it
+    beginChange(parent);
+    beginChange(n);
+    replaceChild(parent, n, child);
+    endChange(n);
+    endChange(parent);
+    if (child != nullptr) child->parent = parent;
+
+    retired_.retire(n, allocator_);
+    return parent;
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicConcurrentAVLTree<Key, Compare, Allocator>::rebalance(Node* n) {
+
+    // unlinking a routing node is a removal of its own, so it waits until the
+    // subtree is balanced again: doing it right away could shrink a subtree by two
+    // levels at once, which one rotation cannot fix
+    routing_.clear();
+    rebalancePath(n);
+    while (!routing_.empty()) {
+        Node* routing = routing_.back();
+        routing_.pop_back();
+
+        // a later rotation may have given it a second child
+        if (!routing->present && (routing->left == nullptr || routing->right == nullptr)) rebalancePath(unlink(routing));
+    }
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicConcurrentAVLTree<Key, Compare, Allocator>::queueRouting(Node* n) {
+    if (n == nullptr || n->present || (n->left != nullptr && n->right != nullptr)) return;
+
+    // a node is queued once, so none is unlinked twice
+    if (std::find(routing_.begin(), routing_.end(), n) == routing_.end()) routing_.push_back(n);
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicConcurrentAVLTree<Key, Compare, Allocator>::rebalancePath(Node* n) {
+    while (n != &holder_) {
+        Node* parent = n->parent;
+        queueRouting(n);
+
+        int old_height = n->height;
+        int balance = heightOf(n->right) - heightOf(n->left);
+        if (balance > 1) {
+            if (heightOf(n->right.load()->left) > heightOf(n->right.load()->right)) rotateRight(n->right);
+            n = rotateLeft(n);
+        }
+        else if (balance < -1) {
+            if (heightOf(n->left.load()->right) > heightOf(n->left.load()->left)) rotateLeft(n->left);
+            n = rotateRight(n);
+        }
+        else n->height = 1 + std::max(heightOf(n->left), heightOf(n->right));
+
+        // a rotation moves nodes down, where they can be left with one child
+        if (balance > 1 || balance < -1) {
+            queueRouting(n->left);
+            queueRouting(n->right);
+        }
+
+        // the ancestors are unaffected once a subtree keeps its height
+        if (n->height == old_height) break;
+        n = parent;
+    }
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicConcurrentAVLTree<Key, Compare, Allocator>::Node* BasicConcurrentAVLTree<Key, Compare, Allocator>::rotateLeft(
+        Node* n) {
+    Node* parent = n->parent;
+    Node* pivot = n->right;
+    Node* moved = pivot->left;
+
+    beginChange(parent);
+    beginChange(n);
+    beginChange(pivot);
+    n->right.store(moved, std::memory_order_release);
+    pivot->left.store(n, std::memory_order_release);
+    replaceChild(parent, n, pivot);
+    endChange(pivot);
+    endChange(n);
+    endChange(parent);
+
+    if (moved != nullptr) moved->parent = n;
+    pivot->parent = parent;
+    n->parent = pivot;
+    n->height = 1 + std::max(heightOf(n->left), heightOf(n->right));
+    pivot->height = 1 + std::max(heightOf(pivot->left), heightOf(pivot->right));
+    return pivot;
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicConcurrentAVLTree<Key, Compare, Allocator>::Node* BasicConcurrentAVLTree<Key, Compare, Allocator>::rotateRight(
+        Node* n) {
+    Node* parent = n->parent;
+    Node* pivot = n->left;
+    Node* moved = pivot->right;
+
+    beginChange(parent);
+    beginChange(n);
+    beginChange(pivot);
+    n->left.store(moved, std::memory_order_release);
+    pivot->right.store(n, std::memory_order_release);
+    replaceChild(parent, n, pivot);
+    endChange(pivot);
+    endChange(n);
+    endChange(parent);
+
+    if (moved != nullptr) moved->parent = n;
+    pivot->parent = parent;
+    n->parent = pivot;
+    n->height = 1 + std::max(heightOf(n->left), heightOf(n->right));
+    pivot->height = 1 + std::max(heightOf(pivot->left), heightOf(pivot->right));
+    return pivot;
+}
+
+#endif
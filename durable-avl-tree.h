@@ -0,0 +1,611 @@
+#ifndef LAB3_DURABLE_AVL_TREE_H
+#define LAB3_DURABLE_AVL_TREE_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "avl-tree.h"
+#include "snapshot.h"
+
+// How a DurableAVLTree trades latency for fewer fsyncs.
+struct DurabilityOptions {
+    DurabilityOptions() : groupSize(4096), groupDelayMicros(1000), compactBytes(64u << 20) {}
+
+    unsigned int groupSize;        // Changes that start a commit without waiting for the delay.
+    unsigned int groupDelayMicros; // Longest a change waits before its group is committed.
+    std::uint64_t compactBytes;    // Log size that starts a compaction, or 0 for only when asked.
+};
+
+// AVLTree whose changes survive a crash. The tree lives in memory as usual, and
+// lives on disk as a snapshot (path.snapshot, as save() writes it) plus a log of
+// the changes made since (path.wal). Opening loads the snapshot and replays the
+// log on top of it.
+//
+// insert and remove change the tree at once and add a record to the group of
+// changes being collected. A committer thread writes each group to the log with
+// one write and one fsync, once groupSize changes are waiting or the oldest has
+// waited groupDelayMicros, so a crash loses at most that last group. sync()
+// waits until every change made before it is on disk; the threads that call it
+// at the same time share one fsync.
+//
+// When the log grows past compactBytes, or compact() is called, the committer
+// starts a new log and a background thread merges the snapshot with the old log
+// (path.wal.old) into a new snapshot, reading only the files. Replaying a log on
+// a snapshot that already holds some of its changes gives the same tree, since
+// only the last change to each key matters, so a compaction can be cut short at
+// any point: opening replays path.wal.old before path.wal, and compacts it again.
+// Until path.wal.old has been folded into the snapshot no new log is started, so
+// a failed compaction is retried on that same file rather than overwriting it.
+//
+// The log is a 32-byte header followed by groups, each a 16-byte header (number
+// of records and a checksum) and its records: one byte for the operation, then
+// the bytes of the key. Replay stops at the first group that is cut short or
+// fails its checksum, which is where the log is then cut and appended to.
+//
+// Every method may be called from any thread; they take one lock, which the
+// committer only holds to swap out a group or a log, never while writing or
+// syncing a file. Keys must be trivially copyable.
+template <class Key, class Compare = std::less<Key> >
+class BasicDurableAVLTree {
+public:
+    typedef Key DataType;
+    typedef BasicAVLTree<Key, Compare> Tree;
+
+    BasicDurableAVLTree();
+
+    // Commits every change, waits for any compaction and closes the files.
+    ~BasicDurableAVLTree();
+
+    // Loads the tree saved under path and starts logging to it; path.snapshot and
+    // path.wal need not exist yet. Returns false, leaving the tree closed and
+    // empty, if a file exists but is not a valid snapshot or log of this key type.
+    bool open(const std::string& path, const DurabilityOptions& options = DurabilityOptions());
+
+    // Commits every change, waits for any compaction and closes the files. The
+    // tree is left empty.
+    void close();
+
+    bool isOpen() const;
+
+    // Change the tree as AVLTree does. A change that does nothing is not logged.
+    // The tree must be open.
+    bool insert(const DataType& val);
+    bool remove(const DataType& val);
+
+    bool exists(const DataType& val) const;
+    unsigned int size() const;
+
+    // Waits until every change made before the call is on disk. Returns false if
+    // writing the log has failed, from which point nothing more is committed.
+    bool sync();
+
+    // Folds the log into the snapshot now, and waits until it is done. Returns
+    // false if the compaction failed, which leaves the old files in place.
+    bool compact();
+
+    // Returns the number of bytes in the current log.
+    std::uint64_t logBytes() const;
+
+private:
+    friend class DurableAVLTreeTest;
+
+    static_assert(std::is_trivially_copyable<Key>::value, "the log stores keys as bytes");
+
+    enum Operation { INSERT = 1, REMOVE = 2 };
+
+    struct LogHeader {
+        char magic[8];            // WAL_MAGIC.
+        std::uint32_t version;    // WAL_VERSION.
+        std::uint32_t byteOrder;  // SNAPSHOT_BYTE_ORDER as the writer stored it.
+        std::uint32_t keySize;    // sizeof(Key).
+        char reserved[12];        // Zeros.
+    };
+
+    struct GroupHeader {
+        std::uint32_t count;      // Number of records in the group.
+        std::uint32_t reserved;   // Zero.
+        std::uint64_t checksum;   // SnapshotChecksum of the records.
+    };
+
+    static const std::size_t RECORD_SIZE = 1 + sizeof(Key);
+
+    // Groups longer than this are taken for garbage rather than allocated.
+    static const std::uint32_t MAX_GROUP = 1u << 26;
+
+    // Applies the records of the log at path to tree, or if tree is nullptr,
+    // appends them to records instead. Returns false if the file cannot be read
+    // or its header is wrong, and sets end to the offset just past the last
+    // whole group.
+    static bool replay(const std::string& path, Tree* tree, std::vector<char>* records, std::uint64_t& end);
+
+    // Merges the snapshot at snapshot_path with the log at log_path into a new
+    // snapshot at snapshot_path, and then deletes the log. Reads only the files.
+    static bool compactFiles(const std::string& snapshot_path, const std::string& log_path);
+
+    // Creates an empty log at path, with its header synced. The log is written at
+    // path.tmp and renamed into place, so a crash never leaves a log without its
+    // header. Returns the open file, or nullptr if it could not be created.
+    static std::FILE* createLog(const std::string& path);
+
+    // Writes one group to the log and syncs it, without the lock. Returns false if that fails.
+    bool writeGroup(const std::vector<char>& records, std::uint32_t count);
+
+    // Adds the record of a change to the group being collected, unless writing the
+    // log has failed. Needs the lock.
+    void append(Operation op, const Key& val);
+
+    // Body of the committer thread.
+    void commitLoop();
+
+    // Moves the log to path.wal.old, starts a new one and compacts the old one.
+    // Called by the committer with the lock held, which it drops while it switches
+    // the files. Returns false if the logs could not be switched.
+    bool startCompaction(std::unique_lock<std::mutex>& guard);
+
+    // Runs a compaction of path.wal.old in the background. Needs the lock.
+    void launchCompactor();
+
+    // Records that a compaction failed, which ends the calls of compact() waiting
+    // for it and holds off the next automatic one until the log has grown by
+    // another compactBytes. Needs the lock.
+    void compactionFailed();
+
+    Tree tree_;
+    std::string path_;
+    DurabilityOptions options_;
+
+    mutable std::mutex lock_;
+    std::condition_variable wake_;      // Wakes the committer.
+    std::condition_variable progress_;  // Wakes the callers of sync() and compact().
+
+    std::FILE* log_;                // The current log, written only by the committer.
+    std::uint64_t log_bytes_;       // Its size.
+    std::vector<char> group_;       // Records of the group being collected.
+    std::uint32_t group_count_;     // Number of them.
+    std::uint64_t appended_;        // Changes ever added to a group.
+    std::uint64_t durable_;         // Changes ever committed.
+    std::uint64_t sync_target_;     // Changes that a caller of sync() waits for.
+    bool failed_;                   // Whether a write to the log has failed.
+
+    bool compact_requested_;        // Whether compact() waits for a new log to be started.
+    bool compacting_;               // Whether the logs are being switched or compacted.
+    bool old_log_;                  // Whether path.wal.old holds changes not in the snapshot.
+    std::uint64_t compact_calls_;   // Calls of compact() ever made.
+    std::uint64_t old_log_calls_;   // Those that path.wal.old holds every change for.
+    std::uint64_t folded_calls_;    // Those whose changes are all in the snapshot.
+    std::uint64_t compact_failures_; // Compactions that failed.
+    std::uint64_t next_compact_bytes_; // Log size that starts the next automatic compaction.
+
+    bool open_;
+    bool stopping_;
+    std::thread committer_;
+    std::thread compactor_;
+
+    // Sets copy constructor and assignment operator to private.
+    BasicDurableAVLTree(const BasicDurableAVLTree& other);
+    BasicDurableAVLTree& operator=(const BasicDurableAVLTree& other);
+};
+
+typedef BasicDurableAVLTree<int> DurableAVLTree;
+
+static const char WAL_MAGIC[8] = {'A', 'V', 'L', 'W', 'A', 'L', '\0', '\0'};
+static const std::uint32_t WAL_VERSION = 1;
+
+template <class Key, class Compare>
+BasicDurableAVLTree<Key, Compare>::BasicDurableAVLTree()
+    : log_(nullptr), log_bytes_(0), group_count_(0), appended_(0), durable_(0), sync_target_(0), failed_(false),
+      compact_requested_(false), compacting_(false), old_log_(false), compact_calls_(0), old_log_calls_(0),
+      folded_calls_(0), compact_failures_(0), next_compact_bytes_(0), open_(false), stopping_(false) {}
+
+template <class Key, class Compare>
+BasicDurableAVLTree<Key, Compare>::~BasicDurableAVLTree() {
+    close();
+}
+
+template <class Key, class Compare>
+bool BasicDurableAVLTree<Key, Compare>::open(const std::string& path, const DurabilityOptions& options) {
+    close();
+    path_ = path;
+    options_ = options;
+
+    // the snapshot, then the log of a compaction that was cut short, then the current log
+    std::uint64_t end = 0;
+    bool old_log = std::ifstream(path_ + ".wal.old").good();
+    bool ok = !std::ifstream(path_ + ".snapshot").good() || tree_.load(path_ + ".snapshot");
+    ok = ok && (!old_log || replay(path_ + ".wal.old", &tree_, nullptr, end));
+
+    // a log too short for its header holds no changes, and is created again
+    std::ifstream wal(path_ + ".wal", std::ios::binary | std::ios::ate);
+    bool has_log = wal.good() && wal.tellg() >= (std::streamoff)sizeof(LogHeader);
+    wal.close();
+
+    if (ok && has_log) {
+        ok = replay(path_ + ".wal", &tree_, nullptr, end);
+
+        // anything after the last whole group was never committed, and is cut off
+        log_ = ok ? std::fopen((path_ + ".wal").c_str(), "r+b") : nullptr;
+        ok = log_ != nullptr && ftruncate(fileno(log_), end) == 0 && std::fseek(log_, 0, SEEK_END) == 0;
+        log_bytes_ = end;
+    }
+    else if (ok) {
+        log_ = createLog(path_ + ".wal");
+        ok = log_ != nullptr;
+        log_bytes_ = sizeof(LogHeader);
+    }
+
+    if (!ok) {
+        if (log_ != nullptr) std::fclose(log_);
+        log_ = nullptr;
+        tree_.clear();
+        return false;
+    }
+
+    group_.clear();
+    group_count_ = 0;
+    appended_ = durable_ = sync_target_ = 0;
+    failed_ = false;
+    compact_requested_ = false;
+    compacting_ = false;
+    old_log_ = old_log;
+    compact_calls_ = old_log_calls_ = folded_calls_ = compact_failures_ = 0;
+    next_compact_bytes_ = options_.compactBytes;
+    stopping_ = false;
+    open_ = true;
+
+    std::lock_guard<std::mutex> guard(lock_);
+    if (old_log) launchCompactor();
+    committer_ = std::thread([this]() { commitLoop(); });
+    return true;
+}
+
+template <class Key, class Compare>
+void BasicDurableAVLTree<Key, Compare>::close() {
+    if (!open_) return;
+
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    committer_.join();
+    if (compactor_.joinable()) compactor_.join();
+
+    if (log_ != nullptr) std::fclose(log_);
+    log_ = nullptr;
+    tree_.clear();
+    open_ = false;
+}
+
+template <class Key, class Compare>
+bool BasicDurableAVLTree<Key, Compare>::isOpen() const {
+    return open_;
+}
+
+template <class Key, class Compare>
+bool BasicDurableAVLTree<Key, Compare>::insert(const DataType& val) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!tree_.insert(val)) return false;
+    append(INSERT, val);
+    return true;
+}
+
+template <class Key, class Compare>
+bool BasicDurableAVLTree<Key, Compare>::remove(const DataType& val) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!tree_.remove(val)) return false;
+    append(REMOVE, val);
+    return true;
+}
+
+template <class Key, class Compare>
+bool BasicDurableAVLTree<Key, Compare>::exists(const DataType& val) const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return tree_.exists(val);
+}
+
+template <class Key, class Compare>
+unsigned int BasicDurableAVLTree<Key, Compare>::size() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return tree_.size();
+}
+
+template <class Key, class Compare>
+std::uint64_t BasicDurableAVLTree<Key, Compare>::logBytes() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return log_bytes_;
+}
+
+template <class Key, class Compare>
+void BasicDurableAVLTree<Key, Compare>::append(Operation op, const Key& val) {
+    if (failed_) return;
+    std::size_t at = group_.size();
+    group_.resize(at + RECORD_SIZE);
+    group_[at] = (char)op;
+    std::memcpy(&group_[at + 1], &val, sizeof(Key));
+    appended_++;
+
+    // the committer is woken only once per group, not for every change
+    if (++group_count_ == options_.groupSize) wake_.notify_one();
+}
+
+template <class Key, class Compare>
+bool BasicDurableAVLTree<Key, Compare>::sync() {
+    std::unique_lock<std::mutex> guard(lock_);
+    std::uint64_t target = appended_;
+    if (target > sync_target_) {
+        sync_target_ = target;
+        wake_.notify_one();
+    }
+    progress_.wait(guard, [&]() { return durable_ >= target || failed_; });
+    return !failed_;
+}
+
+template <class Key, class Compare>
+bool BasicDurableAVLTree<Key, Compare>::compact() {
+    std::unique_lock<std::mutex> guard(lock_);
+
+    // done once a log started after this call has been folded, or once any compaction fails
+    std::uint64_t call = ++compact_calls_;
+    std::uint64_t failures = compact_failures_;
+    compact_requested_ = true;
+    wake_.notify_one();
+    progress_.wait(guard, [&]() { return folded_calls_ >= call || compact_failures_ != failures || failed_; });
+    return folded_calls_ >= call;
+}
+
+template <class Key, class Compare>
+void BasicDurableAVLTree<Key, Compare>::commitLoop() {
+    std::unique_lock<std::mutex> guard(lock_);
+    std::vector<char> records;
+
+    while (true) {
+        // after a failed write there is nothing left to do but stop
+        wake_.wait_for(guard, std::chrono::microseconds(options_.groupDelayMicros), [&]() {
+            return stopping_ || (!failed_ && (group_count_ >= options_.groupSize ||
+                                              (group_count_ > 0 && sync_target_ > durable_) ||
+                                              (compact_requested_ && !compacting_)));
+        });
+
+        // the group is swapped out, so new changes start the next one while this one is written
+        if (group_count_ > 0 && !failed_) {
+            records.swap(group_);
+            group_.clear();
+            std::uint32_t count = group_count_;
+            std::uint64_t committed = appended_;
+            group_count_ = 0;
+
+            guard.unlock();
+            bool ok = writeGroup(records, count);
+            guard.lock();
+
+            if (ok) durable_ = committed;
+            else failed_ = true;
+            progress_.notify_all();
+        }
+
+        // the changes made since the failure are dropped, so that the group stops growing
+        if (failed_) {
+            group_.clear();
+            group_count_ = 0;
+        }
+
+        // the log is switched only between groups, so a compaction holds every change committed before it was asked
+        // for, and only once the previous old log is folded, so that no unfolded log is ever overwritten
+        bool full = options_.compactBytes != 0 && log_bytes_ >= next_compact_bytes_;
+        if ((compact_requested_ || full) && !compacting_ && !failed_ && group_count_ == 0) {
+            if (old_log_) launchCompactor();
+            else if (!startCompaction(guard)) compactionFailed();
+        }
+
+        if (stopping_ && group_count_ == 0) break;
+    }
+}
+
+template <class Key, class Compare>
+bool BasicDurableAVLTree<Key, Compare>::writeGroup(const std::vector<char>& records, std::uint32_t count) {
+    GroupHeader header;
+    header.count = count;
+    header.reserved = 0;
+    SnapshotChecksum checksum;
+    checksum.update(records.data(), records.size());
+    header.checksum = checksum.value();
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, log_) == 1 &&
+              std::fwrite(records.data(), records.size(), 1, log_) == 1 && std::fflush(log_) == 0 &&
+              fdatasync(fileno(log_)) == 0;
+
+    std::lock_guard<std::mutex> guard(lock_);
+    log_bytes_ += sizeof(header) + records.size();
+    return ok;
+}
+
+template <class Key, class Compare>
+bool BasicDurableAVLTree<Key, Compare>::startCompaction(std::unique_lock<std::mutex>& guard) {
+    std::string log_path = path_ + ".wal";
+    std::uint64_t calls = compact_calls_;
+    compact_requested_ = false;
+    compacting_ = true;
+
+    // only the committer touches the log, so the files are switched without the lock; the old log keeps every
+    // committed change until the new snapshot holds them all, and a new log is created only once it is renamed
+    guard.unlock();
+    std::FILE* log = nullptr;
+    bool renamed = std::rename(log_path.c_str(), (log_path + ".old").c_str()) == 0;
+    if (renamed) log = createLog(log_path);
+
+    // without a new log the old one is put back, and if that fails too nothing more can be committed
+    bool restored = !renamed || log != nullptr ||
+                    (std::rename((log_path + ".old").c_str(), log_path.c_str()) == 0 && syncParentDirectory(log_path));
+    if (log != nullptr) std::fclose(log_);
+    guard.lock();
+
+    compacting_ = false;
+    if (log == nullptr) {
+        failed_ = !restored;
+        progress_.notify_all();
+        return false;
+    }
+
+    log_ = log;
+    log_bytes_ = sizeof(LogHeader);
+    next_compact_bytes_ = options_.compactBytes;
+    old_log_ = true;
+    old_log_calls_ = calls;
+    launchCompactor();
+    return true;
+}
+
+template <class Key, class Compare>
+void BasicDurableAVLTree<Key, Compare>::launchCompactor() {
+    if (compactor_.joinable()) compactor_.join();
+    compacting_ = true;
+
+    compactor_ = std::thread([this]() {
+        bool ok = compactFiles(path_ + ".snapshot", path_ + ".wal.old");
+        std::lock_guard<std::mutex> guard(lock_);
+        compacting_ = false;
+        if (ok) {
+            old_log_ = false;
+            folded_calls_ = std::max(folded_calls_, old_log_calls_);
+        }
+        else compactionFailed();
+        progress_.notify_all();
+        wake_.notify_one();
+    });
+}
+
+template <class Key, class Compare>
+void BasicDurableAVLTree<Key, Compare>::compactionFailed() {
+    compact_failures_++;
+    compact_requested_ = false;
+    next_compact_bytes_ = log_bytes_ + options_.compactBytes;
+    progress_.notify_all();
+}
+
+template <class Key, class Compare>
+std::FILE* BasicDurableAVLTree<Key, Compare>::createLog(const std::string& path) {
+    std::string tmp_path = path + ".tmp";
+    std::FILE* file = std::fopen(tmp_path.c_str(), "w+b");
+    if (file == nullptr) return nullptr;
+
+    LogHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, WAL_MAGIC, sizeof(WAL_MAGIC));
+    header.version = WAL_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.keySize = sizeof(Key);
+
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1 || std::fflush(file) != 0 || fsync(fileno(file)) != 0 ||
+        std::rename(tmp_path.c_str(), path.c_str()) != 0 || !syncParentDirectory(path)) {
+        std::fclose(file);
+        std::remove(tmp_path.c_str());
+        return nullptr;
+    }
+    return file;
+}
+
+template <class Key, class Compare>
+bool BasicDurableAVLTree<Key, Compare>::replay(const std::string& path, Tree* tree, std::vector<char>* records,
+                                               std::uint64_t& end) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) return false;
+
+    LogHeader header;
+    if (std::fread(&header, sizeof(header), 1, file) != 1 || std::memcmp(header.magic, WAL_MAGIC, sizeof(WAL_MAGIC)) != 0 ||
+        header.version != WAL_VERSION || header.byteOrder != SNAPSHOT_BYTE_ORDER || header.keySize != sizeof(Key)) {
+        std::fclose(file);
+        return false;
+    }
+    end = sizeof(header);
+
+    std::vector<char> group;
+    GroupHeader group_header;
+    while (std::fread(&group_header, sizeof(group_header), 1, file) == 1 && group_header.count <= MAX_GROUP) {
+        group.resize(group_header.count * RECORD_SIZE);
+        if (!group.empty() && std::fread(group.data(), group.size(), 1, file) != 1) break;
+
+        SnapshotChecksum checksum;
+        checksum.update(group.data(), group.size());
+        if (checksum.value() != group_header.checksum) break;
+
+        if (records != nullptr) records->insert(records->end(), group.begin(), group.end());
+        for (std::size_t at = 0; tree != nullptr && at < group.size(); at += RECORD_SIZE) {
+            Key val;
+            std::memcpy(&val, &group[at + 1], sizeof(Key));
+            if (group[at] == INSERT) tree->insert(val);
+            else tree->remove(val);
+        }
+        end += sizeof(group_header) + group.size();
+    }
+
+    std::fclose(file);
+    return true;
+}
+
+template <class Key, class Compare>
+bool BasicDurableAVLTree<Key, Compare>::compactFiles(const std::string& snapshot_path, const std::string& log_path) {
+    std::vector<char> records;
+    std::uint64_t end;
+    if (!replay(log_path, nullptr, &records, end)) return false;
+
+    // only the last change to each key counts, so sort the changes by key, keeping their order for each key
+    Compare compare;
+    std::vector<std::pair<Key, char> > changes;
+    changes.reserve(records.size() / RECORD_SIZE);
+    for (std::size_t at = 0; at < records.size(); at += RECORD_SIZE) {
+        Key val;
+        std::memcpy(&val, &records[at + 1], sizeof(Key));
+        changes.push_back(std::make_pair(val, records[at]));
+    }
+    std::stable_sort(changes.begin(), changes.end(), [&compare](const std::pair<Key, char>& a,
+                                                                const std::pair<Key, char>& b) {
+        return compare(a.first, b.first);
+    });
+
+    // merge the values of the snapshot, which may not exist yet, with the last change to each key
+    SnapshotReader<Key, Compare> reader;
+    bool has_snapshot = std::ifstream(snapshot_path).good();
+    if (has_snapshot && !reader.open(snapshot_path)) return false;
+    std::uint64_t remaining = has_snapshot ? reader.size() : 0;
+
+    SnapshotWriter<Key> writer;
+    if (!writer.open(snapshot_path)) return false;
+
+    std::size_t i = 0;
+    while (remaining > 0 || i < changes.size()) {
+        if (i == changes.size() || (remaining > 0 && compare(*reader, changes[i].first))) {
+            writer.write(*reader);
+            ++reader;
+            remaining--;
+            continue;
+        }
+
+        // skip to the last change to this key, which replaces the snapshot's value if there is one
+        while (i + 1 < changes.size() && !compare(changes[i].first, changes[i + 1].first)) i++;
+        if (remaining > 0 && !compare(changes[i].first, *reader)) {
+            ++reader;
+            remaining--;
+        }
+        if (changes[i].second == INSERT) writer.write(changes[i].first);
+        i++;
+    }
+
+    if ((has_snapshot && !reader.finish()) || !writer.commit()) return false;
+    return std::remove(log_path.c_str()) == 0 && syncParentDirectory(log_path);
+}
+
+#endif
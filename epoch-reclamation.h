@@ -0,0 +1,220 @@
+#ifndef LAB3_EPOCH_RECLAMATION_H
+#define LAB3_EPOCH_RECLAMATION_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Epoch-based reclamation, which lets writers free nodes that lock-free readers
+// may still be looking at once every such reader is done.
+//
+// A global epoch counter only moves forward. A reader pins the current epoch for
+// as long as it may hold pointers into a structure (see EpochGuard), and the epoch
+// can only advance from e to e + 1 once every pinned reader has seen e. So a node
+// unlinked while the epoch was e can only still be seen by readers pinned at e or
+// before, and none are left once the epoch reaches e + 2.
+//
+// There is one domain for the whole program. Each thread that pins gets a record
+// of its own the first time, which it gives back when it exits.
+class EpochDomain {
+public:
+    // Returns the domain of the program.
+    static EpochDomain& global();
+
+    // Returns the current epoch.
+    std::uint64_t epoch() const;
+
+    // Advances the epoch if every pinned thread has seen the current one. Returns
+    // whether it advanced.
+    bool tryAdvance();
+
+    // Pins the current epoch for the calling thread, or unpins it. Pins nest, and
+    // only the outermost pair has any effect.
+    void pin();
+    void unpin();
+
+private:
+    // What one thread has pinned: its epoch shifted left by one, with the low bit set
+    // while pinned, and 0 otherwise.
+    struct Record {
+        std::atomic<std::uint64_t> state;
+        std::atomic<bool> in_use;
+        Record* next;
+        unsigned int depth;  // Nesting of pins, only used by the owning thread.
+        char padding[64];    // Keeps the records of different threads off each other's cache lines.
+    };
+
+    // Gives a thread's record back when the thread exits.
+    struct RecordOwner {
+        Record* record;
+        ~RecordOwner();
+    };
+
+    EpochDomain();
+
+    // Returns the record of the calling thread, claiming one on the first call.
+    Record* localRecord();
+
+    std::atomic<std::uint64_t> epoch_;
+    std::atomic<Record*> records_;  // Every record ever made, newest first. Records are never freed.
+};
+
+// Keeps the current epoch pinned on the calling thread while it exists, so that
+// nodes it can reach are not freed under it.
+class EpochGuard {
+public:
+    EpochGuard() { EpochDomain::global().pin(); }
+    ~EpochGuard() { EpochDomain::global().unpin(); }
+
+private:
+    // Sets copy constructor and assignment operator to private.
+    EpochGuard(const EpochGuard& other);
+    EpochGuard& operator=(const EpochGuard& other);
+};
+
+// Nodes that one writer has unlinked, waiting until no reader can see them any
+// more. They are kept in batches by the epoch in which they were retired, and a
+// whole batch is destroyed and returned to the allocator at once, so with a
+// NodePool the next inserts reuse them as a block. Only one thread at a time may
+// use a RetiredNodes, e.g. the writer holding a tree's write lock.
+template <class Node, class Allocator>
+class RetiredNodes {
+public:
+    RetiredNodes();
+
+    // Queues n, which readers can no longer newly reach, to be freed through
+    // allocator once every reader that could have reached it is done. Frees the
+    // batches that have become safe.
+    void retire(Node* n, Allocator& allocator);
+
+    // Frees every queued node, which is only safe once no reader is left.
+    void releaseAll(Allocator& allocator);
+
+    // Returns the number of nodes waiting to be freed.
+    unsigned int pending() const;
+
+private:
+    // Retiring this many nodes into one batch tries to advance the epoch, so that
+    // the older batches become safe to free.
+    static const unsigned int BATCH_SIZE = 64;
+
+    // A batch retired in epoch e can be freed from epoch e + 2 on, so three
+    // batches cover every epoch that may still be unsafe.
+    struct Batch {
+        std::uint64_t epoch;
+        std::vector<Node*> nodes;
+    };
+    Batch batches_[3];
+
+    // Destroys the nodes of batch and returns them to allocator.
+    static void freeBatch(Batch& batch, Allocator& allocator);
+};
+
+inline EpochDomain& EpochDomain::global() {
+    static EpochDomain domain;
+    return domain;
+}
+
+inline EpochDomain::EpochDomain() : epoch_(0), records_(nullptr) {}
+
+inline EpochDomain::RecordOwner::~RecordOwner() {
+    if (record != nullptr) record->in_use.store(false, std::memory_order_release);
+}
+
+inline std::uint64_t EpochDomain::epoch() const {
+    return epoch_.load(std::memory_order_seq_cst);
+}
+
+inline EpochDomain::Record* EpochDomain::localRecord() {
+    static thread_local RecordOwner owner = {nullptr};
+    if (owner.record != nullptr) return owner.record;
+
+    // reuse the record of a thread that has exited, or add a new one
+    for (Record* r = records_.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+        bool in_use = false;
+        if (r->in_use.compare_exchange_strong(in_use, true)) {
+            owner.record = r;
+            return r;
+        }
+    }
+
+    Record* r = new Record();
+    r->state.store(0, std::memory_order_relaxed);
+    r->in_use.store(true, std::memory_order_relaxed);
+    r->depth = 0;
+    r->next = records_.load(std::memory_order_relaxed);
+    while (!records_.compare_exchange_weak(r->next, r)) {}
+    owner.record = r;
+    return r;
+}
+
+inline void EpochDomain::pin() {
+    Record* r = localRecord();
+    if (r->depth++ != 0) return;
+
+    // the exchange releases everything read under the last pin to a writer that
+    // sees this one, and the fence orders the pin before every read under it, so a
+    // writer that does not see the pin cannot have unlinked a node the reader finds
+    r->state.exchange((epoch_.load(std::memory_order_relaxed) << 1) | 1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+inline void EpochDomain::unpin() {
+    Record* r = localRecord();
+    if (--r->depth == 0) r->state.store(0, std::memory_order_release);
+}
+
+inline bool EpochDomain::tryAdvance() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::uint64_t current = epoch_.load(std::memory_order_relaxed);
+
+    for (Record* r = records_.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+        std::uint64_t state = r->state.load(std::memory_order_acquire);
+        if ((state & 1) && (state >> 1) != current) return false;
+    }
+    return epoch_.compare_exchange_strong(current, current + 1);
+}
+
+template <class Node, class Allocator>
+RetiredNodes<Node, Allocator>::RetiredNodes() {
+    for (Batch& batch : batches_) batch.epoch = 0;
+}
+
+template <class Node, class Allocator>
+void RetiredNodes<Node, Allocator>::retire(Node* n, Allocator& allocator) {
+    EpochDomain& domain = EpochDomain::global();
+    std::uint64_t epoch = domain.epoch();
+
+    // free every batch at least two epochs old, which takes the slot of this epoch if needed
+    for (Batch& batch : batches_) {
+        if (!batch.nodes.empty() && batch.epoch + 2 <= epoch) freeBatch(batch, allocator);
+    }
+
+    Batch& batch = batches_[epoch % 3];
+    batch.epoch = epoch;
+    batch.nodes.push_back(n);
+    if (batch.nodes.size() % BATCH_SIZE == 0) domain.tryAdvance();
+}
+
+template <class Node, class Allocator>
+void RetiredNodes<Node, Allocator>::releaseAll(Allocator& allocator) {
+    for (Batch& batch : batches_) freeBatch(batch, allocator);
+}
+
+template <class Node, class Allocator>
+unsigned int RetiredNodes<Node, Allocator>::pending() const {
+    unsigned int count = 0;
+    for (const Batch& batch : batches_) count += batch.nodes.size();
+    return count;
+}
+
+template <class Node, class Allocator>
+void RetiredNodes<Node, Allocator>::freeBatch(Batch& batch, Allocator& allocator) {
+    for (Node* n : batch.nodes) {
+        n->~Node();
+        allocator.deallocate(n, 1);
+    }
+    batch.nodes.clear();
+}
+
+#endif
@@ -0,0 +1,274 @@
+#ifndef LAB3_FROZEN_TREE_H
+#define LAB3_FROZEN_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <type_traits>
+
+// Read-only set of keys stored in one flat array in Eytzinger order: the root at
+// index 1, and the children of the key at index k at 2k and 2k + 1, so the array
+// is the levels of a complete binary search tree one after another. There are no
+// pointers, so a key costs sizeof(Key) bytes, and the top levels, which every
+// lookup reads, are packed together at the front of the array.
+//
+// A lookup walks down by index arithmetic, choosing the child with the result
+// of the comparison instead of a branch, and prefetches the cache line four
+// levels further down, which holds all 16 descendants of the current key there
+// (for 4-byte keys). So the misses of the next levels overlap instead of each
+// waiting for the last.
+//
+// Built from sorted keys, e.g. by freeze() on a tree. Keys are copied with
+// memcpy semantics, so they must be trivially copyable.
+template <class Key, class Compare = std::less<Key> >
+class BasicFrozenTree {
+public:
+    typedef Key DataType;
+
+    // Visits the keys in order. The keys next to each other in order are far
+    // apart in the array, so an iterator costs more per step than a scan of a
+    // sorted array, but needs no memory of its own.
+    class iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Key value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Key* pointer;
+        typedef const Key& reference;
+
+        iterator() : tree_(nullptr), index_(0) {}
+
+        reference operator*() const { return tree_->values_[index_]; }
+        pointer operator->() const { return &tree_->values_[index_]; }
+
+        iterator& operator++() { index_ = tree_->next(index_); return *this; }
+        iterator operator++(int) { iterator old = *this; ++*this; return old; }
+
+        bool operator==(const iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const iterator& other) const { return index_ != other.index_; }
+
+    private:
+        friend class BasicFrozenTree;
+        iterator(const BasicFrozenTree* tree, std::size_t index) : tree_(tree), index_(index) {}
+
+        const BasicFrozenTree* tree_;
+        std::size_t index_;  // Index of the key in the array, or 0 past the last key.
+    };
+    typedef iterator const_iterator;
+
+    BasicFrozenTree();
+
+    // Builds the array from the keys in [first, last), which must be sorted with
+    // no two of them equivalent, in O(n).
+    template <class ForwardIt>
+    BasicFrozenTree(ForwardIt first, ForwardIt last);
+
+    // Moving hands over the array, and leaves other empty.
+    BasicFrozenTree(BasicFrozenTree&& other);
+    BasicFrozenTree& operator=(BasicFrozenTree&& other);
+
+    ~BasicFrozenTree();
+
+    // Returns the number of keys.
+    unsigned int size() const;
+
+    // Returns the number of bytes of memory the keys take up.
+    std::size_t memoryUsed() const;
+
+    // Returns the smallest and the largest key. The tree must not be empty.
+    const DataType& min() const;
+    const DataType& max() const;
+
+    // Returns whether a key equivalent to val is in the tree.
+    bool exists(const DataType& val) const;
+
+    // Returns iterators to the smallest key, and to past the largest key.
+    iterator begin() const;
+    iterator end() const;
+
+    // Returns an iterator to the first key that is not less than val, or end()
+    // if there is none.
+    iterator lower_bound(const DataType& val) const;
+
+    // Calls visit(value) for every value in [lo, hi) in order.
+    template <class Visitor>
+    void scan(const DataType& lo, const DataType& hi, Visitor visit) const;
+
+private:
+    friend class FrozenTreeTest;
+
+    static_assert(std::is_trivially_copyable<Key>::value, "a frozen tree copies its keys as bytes");
+
+    // Size of a cache line, which the array is aligned to so that the 16 keys
+    // at 16k..16k + 15 share one line (for 4-byte keys).
+    static const std::size_t CACHE_LINE = 64;
+
+    // A lookup at index k prefetches index k * PREFETCH_STRIDE, the first of the
+    // descendants of k that fill the cache line that many levels down.
+    static const std::size_t PREFETCH_STRIDE = sizeof(Key) < CACHE_LINE ? CACHE_LINE / sizeof(Key) : 1;
+
+    // Returns the index of the first key not less than val, or 0 if there is none.
+    std::size_t lowerBoundIndex(const Key& val) const;
+
+    // Returns the index of the key after, in order, the one at k, or 0 if it is
+    // the last. first() returns the index of the smallest key, or 0 if there is none.
+    std::size_t first() const;
+    std::size_t next(std::size_t k) const;
+
+    void* memory_;      // Allocation holding the array, with room to align it.
+    Key* values_;       // The keys at indices 1..size_, aligned to a cache line; values_[0] is unused.
+    std::size_t size_;  // Number of keys.
+    Compare compare_;
+
+    // Sets copy constructor and assignment operator to private.
+    BasicFrozenTree(const BasicFrozenTree& other);
+    BasicFrozenTree& operator=(const BasicFrozenTree& other);
+};
+
+typedef BasicFrozenTree<int> FrozenTree;
+
+template <class Key, class Compare>
+BasicFrozenTree<Key, Compare>::BasicFrozenTree() : memory_(nullptr), values_(nullptr), size_(0) {}
+
+template <class Key, class Compare>
+template <class ForwardIt>
+BasicFrozenTree<Key, Compare>::BasicFrozenTree(ForwardIt first, ForwardIt last)
+    : memory_(nullptr), values_(nullptr), size_(std::distance(first, last)) {
+    if (size_ == 0) return;
+
+    memory_ = ::operator new((size_ + 1) * sizeof(Key) + CACHE_LINE);
+    std::uintptr_t aligned = reinterpret_cast<std::uintptr_t>(memory_);
+    aligned = (aligned + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    values_ = reinterpret_cast<Key*>(aligned);
+
+    // visiting the indices in order hands out the sorted keys in order
+    for (std::size_t k = this->first(); k != 0; k = next(k), ++first) new (&values_[k]) Key(*first);
+}
+
+template <class Key, class Compare>
+BasicFrozenTree<Key, Compare>::BasicFrozenTree(BasicFrozenTree&& other)
+    : memory_(other.memory_), values_(other.values_), size_(other.size_), compare_(other.compare_) {
+    other.memory_ = nullptr;
+    other.values_ = nullptr;
+    other.size_ = 0;
+}
+
+template <class Key, class Compare>
+BasicFrozenTree<Key, Compare>& BasicFrozenTree<Key, Compare>::operator=(BasicFrozenTree&& other) {
+    if (&other == this) return *this;
+
+    ::operator delete(memory_);
+    memory_ = other.memory_;
+    values_ = other.values_;
+    size_ = other.size_;
+    compare_ = other.compare_;
+    other.memory_ = nullptr;
+    other.values_ = nullptr;
+    other.size_ = 0;
+    return *this;
+}
+
+template <class Key, class Compare>
+BasicFrozenTree<Key, Compare>::~BasicFrozenTree() {
+    ::operator delete(memory_);
+}
+
+template <class Key, class Compare>
+unsigned int BasicFrozenTree<Key, Compare>::size() const {
+    return size_;
+}
+
+template <class Key, class Compare>
+std::size_t BasicFrozenTree<Key, Compare>::memoryUsed() const {
+    return size_ == 0 ? 0 : (size_ + 1) * sizeof(Key) + CACHE_LINE;
+}
+
+template <class Key, class Compare>
+std::size_t BasicFrozenTree<Key, Compare>::first() const {
+    if (size_ == 0) return 0;
+
+    // the leftmost index is the largest power of two in the array
+    std::size_t k = 1;
+    while (2 * k <= size_) k *= 2;
+    return k;
+}
+
+template <class Key, class Compare>
+std::size_t BasicFrozenTree<Key, Compare>::next(std::size_t k) const {
+
+    // the smallest key of the right subtree, if there is one
+    if (2 * k + 1 <= size_) {
+        k = 2 * k + 1;
+        while (2 * k <= size_) k *= 2;
+        return k;
+    }
+
+    // otherwise the first ancestor whose left subtree this is
+    while (k & 1) k >>= 1;
+    return k >> 1;
+}
+
+template <class Key, class Compare>
+const typename BasicFrozenTree<Key, Compare>::DataType& BasicFrozenTree<Key, Compare>::min() const {
+    return values_[first()];
+}
+
+template <class Key, class Compare>
+const typename BasicFrozenTree<Key, Compare>::DataType& BasicFrozenTree<Key, Compare>::max() const {
+    std::size_t k = 1;
+    while (2 * k + 1 <= size_) k = 2 * k + 1;
+    return values_[k];
+}
+
+template <class Key, class Compare>
+std::size_t BasicFrozenTree<Key, Compare>::lowerBoundIndex(const Key& val) const {
+
+    // go right exactly when the key is less than val, without a branch
+    std::size_t k = 1;
+    while (k <= size_) {
+#ifdef __GNUC__
+        __builtin_prefetch(values_ + k * PREFETCH_STRIDE);
+#endif
+        k = 2 * k + compare_(values_[k], val);
+    }
+
+    // k now encodes the path taken below the lower bound, which is the last node
+    // the walk went left at: drop the right turns after it, and then that left turn
+#ifdef __GNUC__
+    return k >> (__builtin_ctzll(~static_cast<unsigned long long>(k)) + 1);
+#else
+    while (k & 1) k >>= 1;
+    return k >> 1;
+#endif
+}
+
+template <class Key, class Compare>
+bool BasicFrozenTree<Key, Compare>::exists(const DataType& val) const {
+    std::size_t k = lowerBoundIndex(val);
+    return k != 0 && !compare_(val, values_[k]);
+}
+
+template <class Key, class Compare>
+typename BasicFrozenTree<Key, Compare>::iterator BasicFrozenTree<Key, Compare>::begin() const {
+    return iterator(this, first());
+}
+
+template <class Key, class Compare>
+typename BasicFrozenTree<Key, Compare>::iterator BasicFrozenTree<Key, Compare>::end() const {
+    return iterator(this, 0);
+}
+
+template <class Key, class Compare>
+typename BasicFrozenTree<Key, Compare>::iterator BasicFrozenTree<Key, Compare>::lower_bound(const DataType& val) const {
+    return iterator(this, lowerBoundIndex(val));
+}
+
+template <class Key, class Compare>
+template <class Visitor>
+void BasicFrozenTree<Key, Compare>::scan(const DataType& lo, const DataType& hi, Visitor visit) const {
+    for (std::size_t k = lowerBoundIndex(lo); k != 0 && compare_(values_[k], hi); k = next(k)) visit(values_[k]);
+}
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef LAB3_NODE_POOL_H
+#define LAB3_NODE_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// Allocator that hands out tree nodes one at a time from large slabs. Freed
+// nodes go onto a free list and are handed out again first, so inserts after
+// removes reuse memory that is likely still in cache, and nodes allocated one
+// after another (e.g. a subtree built by consecutive inserts) sit next to each
+// other. Every slab is released at once when the pool is destroyed.
+//
+// It has the allocate/deallocate interface of std::allocator, so the trees can
+// use either one, but it only supports allocating a single object at a time.
+//
+// A copy of a NodePool shares its slabs and free list, and the slabs are only
+// released when the last copy is destroyed. Copies compare equal, and memory
+// allocated from one copy can be freed through any other, so trees that share
+// a pool can hand nodes to each other.
+template <class T>
+class NodePool {
+public:
+    typedef T value_type;
+
+    NodePool();
+
+    // Makes this pool share other's slabs and free list.
+    NodePool(const NodePool& other);
+    NodePool& operator=(const NodePool& other);
+
+    // Releases every slab, unless another copy still shares them. Objects still
+    // allocated from the pool are not destroyed.
+    ~NodePool();
+
+    // Returns uninitialized memory for one T (n must be 1).
+    T* allocate(std::size_t n);
+
+    // Returns the memory of p to the free list (n must be 1).
+    void deallocate(T* p, std::size_t n);
+
+    // Releases every slab at once, invalidating everything allocated from the pool.
+    // Does nothing and returns false if another copy shares the slabs.
+    bool release();
+
+    // Takes over every slab and free slot of other, so that everything allocated
+    // from other can now be freed through this pool, and leaves other empty.
+    // Takes time in the number of other's slabs. Does nothing and returns false
+    // if another copy shares other's slabs.
+    bool splice(NodePool& other);
+
+    // Returns whether memory from one pool can be freed through the other.
+    bool operator==(const NodePool& other) const { return state_ == other.state_; }
+    bool operator!=(const NodePool& other) const { return state_ != other.state_; }
+
+private:
+    // A free slot holds the link to the next free slot; a used slot holds a T.
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    // A slab is a header followed by its slots.
+    struct Slab {
+        Slab* next;
+        std::size_t count;
+    };
+
+    // The first slab holds this many slots, and each new slab holds twice as
+    // many as the last until reaching the maximum.
+    static const std::size_t MIN_SLAB_SLOTS = 64;
+    static const std::size_t MAX_SLAB_SLOTS = 65536;
+
+    // Size of a cache line, which the first slot of every slab is aligned to.
+    static const std::size_t CACHE_LINE = 64;
+
+    // The slabs and free list, shared by every copy of the pool.
+    struct State {
+        Slab* slabs;       // Most recently allocated slab, linked to the older ones.
+        Slot* free;        // Head of the list of freed slots.
+        Slot* free_tail;   // Last slot of the free list, if it is not empty.
+        Slot* next;        // Next never-used slot in the newest slab.
+        Slot* end;         // One past the last slot in the newest slab.
+        std::size_t refs;  // Number of pools sharing this state.
+    };
+
+    // Allocates a new slab and makes its slots available to allocate().
+    void grow();
+
+    // Drops this pool's share of its state, releasing it if this was the last one.
+    void unshare();
+
+    State* state_;
+};
+
+template <class T>
+NodePool<T>::NodePool() {
+    state_ = new State();
+    state_->slabs = nullptr;
+    state_->free = nullptr;
+    state_->free_tail = nullptr;
+    state_->next = nullptr;
+    state_->end = nullptr;
+    state_->refs = 1;
+}
+
+template <class T>
+NodePool<T>::NodePool(const NodePool& other) {
+    state_ = other.state_;
+    state_->refs++;
+}
+
+template <class T>
+NodePool<T>& NodePool<T>::operator=(const NodePool& other) {
+    other.state_->refs++; // first, in case other is this pool
+    unshare();
+    state_ = other.state_;
+    return *this;
+}
+
+template <class T>
+NodePool<T>::~NodePool() {
+    unshare();
+}
+
+template <class T>
+void NodePool<T>::unshare() {
+    if (--state_->refs > 0) return;
+    release();
+    delete state_;
+}
+
+template <class T>
+T* NodePool<T>::allocate(std::size_t n) {
+    if (n != 1) throw std::bad_alloc();
+
+    // reuse the most recently freed slot first
+    State* state = state_;
+    if (state->free != nullptr) {
+        Slot* slot = state->free;
+        state->free = slot->next;
+        return reinterpret_cast<T*>(slot->storage);
+    }
+
+    // otherwise take the next slot of the newest slab
+    if (state->next == state->end) grow();
+    return reinterpret_cast<T*>((state->next++)->storage);
+}
+
+template <class T>
+void NodePool<T>::deallocate(T* p, std::size_t n) {
+    Slot* slot = reinterpret_cast<Slot*>(p);
+    if (state_->free == nullptr) state_->free_tail = slot;
+    slot->next = state_->free;
+    state_->free = slot;
+}
+
+template <class T>
+bool NodePool<T>::release() {
+    if (state_->refs > 1) return false;
+
+    while (state_->slabs != nullptr) {
+        Slab* next = state_->slabs->next;
+        ::operator delete(state_->slabs);
+        state_->slabs = next;
+    }
+
+    state_->free = nullptr;
+    state_->next = nullptr;
+    state_->end = nullptr;
+    return true;
+}
+
+template <class T>
+bool NodePool<T>::splice(NodePool& other) {
+    State* from = other.state_;
+    if (from == state_) return true;
+    if (from->refs > 1) return false;
+    if (from->slabs == nullptr) return true;
+
+    // other's slabs go behind our newest one, whose unused slots we keep handing
+    // out; the unused rest of other's newest slab is released with the slab
+    Slab* last = from->slabs;
+    while (last->next != nullptr) last = last->next;
+    if (state_->slabs == nullptr) {
+        state_->slabs = from->slabs;
+        state_->next = from->next;
+        state_->end = from->end;
+    } else {
+        last->next = state_->slabs->next;
+        state_->slabs->next = from->slabs;
+    }
+
+    if (from->free != nullptr) {
+        from->free_tail->next = state_->free;
+        if (state_->free == nullptr) state_->free_tail = from->free_tail;
+        state_->free = from->free;
+    }
+
+    from->slabs = nullptr;
+    from->free = nullptr;
+    from->next = nullptr;
+    from->end = nullptr;
+    return true;
+}
+
+template <class T>
+void NodePool<T>::grow() {
+    std::size_t count = MIN_SLAB_SLOTS;
+    Slab* newest = state_->slabs;
+    if (newest != nullptr) count = newest->count < MAX_SLAB_SLOTS ? 2 * newest->count : MAX_SLAB_SLOTS;
+
+    // the slots start on the first cache line after the header, so nodes whose
+    // size is a whole number of lines never straddle one
+    Slab* slab = static_cast<Slab*>(::operator new(sizeof(Slab) + CACHE_LINE + count * sizeof(Slot)));
+    slab->next = newest;
+    slab->count = count;
+    state_->slabs = slab;
+
+    std::uintptr_t first = reinterpret_cast<std::uintptr_t>(slab + 1);
+    first = (first + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    state_->next = reinterpret_cast<Slot*>(first);
+    state_->end = state_->next + count;
+}
+
+// Releases every object allocated from pool at once, without running their
+// destructors, and returns true. A pool shared with another copy, and other
+// allocators, can only free objects one at a time, so for them this does
+// nothing and returns false.
+template <class T>
+bool releaseAll(NodePool<T>& pool) {
+    return pool.release();
+}
+
+template <class Allocator>
+bool releaseAll(Allocator& allocator) {
+    return false;
+}
+
+// Makes everything allocated from from freeable through into, and returns
+// true, in time independent of the number of objects. That is possible for an
+// unshared pool, whose slabs can be spliced into another, and for allocators
+// that compare equal (e.g. copies of std::allocator), which need nothing done.
+template <class T>
+bool adoptAll(NodePool<T>& into, NodePool<T>& from) {
+    return into.splice(from);
+}
+
+template <class Allocator>
+bool adoptAll(Allocator& into, Allocator& from) {
+    return into == from;
+}
+
+// Returns an allocator that a worker thread can allocate from while other
+// threads use theirs, and whose objects adoptAll can hand to owner afterwards:
+// a new pool for a NodePool, and a copy of owner for other allocators, which
+// are assumed to be thread-safe like std::allocator.
+template <class T>
+NodePool<T> workerAllocator(const NodePool<T>& owner) {
+    return NodePool<T>();
+}
+
+template <class Allocator>
+Allocator workerAllocator(const Allocator& owner) {
+    return owner;
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef LAB3_PARALLEL_AVL_TREE_H
+#define LAB3_PARALLEL_AVL_TREE_H
+
+#include <vector>
+
+#include "avl-tree.h"
+#include "task-pool.h"
+
+// The operations of the trees that run on the workers of a TaskPool: the
+// build_from_sorted of BasicBinarySearchTree and the set_union of BasicAVLTree
+// that take a pool. They are declared with the trees, and defined here so that
+// only the code that uses them pulls in the threads of task-pool.h.
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class RandomIt>
+void BasicBinarySearchTree<Key, Compare, Allocator, Augment>::build_from_sorted(RandomIt first, RandomIt last, TaskPool& pool,
+                                                                                unsigned int grain) {
+    clear();
+    size_ = last - first;
+
+    // the allocators are not thread-safe, so every worker gets one of its own
+    std::vector<NodeAllocator> allocators;
+    for (unsigned int i = 0; i < pool.size(); ++i) allocators.push_back(workerAllocator(allocator_));
+
+    pool.run([&]() { root_ = buildSubtreeParallel(first, size_, nullptr, allocators, pool, grain); });
+
+    for (unsigned int i = 0; i < allocators.size(); ++i) adoptAll(allocator_, allocators[i]);
+    stats_.allocated(size_);
+    top_.rebuild(root_, size_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+template <class RandomIt>
+typename BasicBinarySearchTree<Key, Compare, Allocator, Augment>::Node* BasicBinarySearchTree<Key, Compare, Allocator, Augment>::buildSubtreeParallel(RandomIt first, unsigned int n, Node* parent,
+                                                                                                                                                           std::vector<NodeAllocator>& allocators,
+                                                                                                                                                           TaskPool& pool, unsigned int grain) {
+    if (n <= grain) return buildSubtree(first, n, parent, allocators[TaskPool::workerIndex()]);
+
+    unsigned int left_size = (n - 1) / 2;
+    unsigned int right_size = n / 2;
+
+    // the root comes first here, so that both halves can link to it as they finish
+    Node* subtree_root = allocators[TaskPool::workerIndex()].allocate(1);
+    new (subtree_root) Node(first[left_size]);
+
+    Node* left = nullptr;
+    Node* right = nullptr;
+    pool.fork_join(
+        [&]() { left = buildSubtreeParallel(first, left_size, subtree_root, allocators, pool, grain); },
+        [&]() { right = buildSubtreeParallel(first + left_size + 1, right_size, subtree_root, allocators, pool, grain); });
+
+    linkBuiltNode(subtree_root, left, right, parent, left_size, right_size);
+    return subtree_root;
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+void BasicAVLTree<Key, Compare, Allocator, Augment>::set_union(const std::vector<BasicAVLTree*>& others, TaskPool& pool,
+                                                               unsigned int grain) {
+
+    // the pool is not thread-safe, so every tree moves into it before the parallel part
+    std::vector<Node*> roots(1, this->root_);
+    std::vector<int> heights(1, treeHeight());
+    unsigned int total = this->size_;
+    for (unsigned int i = 0; i < others.size(); ++i) {
+        BasicAVLTree& other = *others[i];
+        if (&other == this || other.root_ == nullptr) continue;
+
+        adoptPool(other);
+        roots.push_back(other.root_);
+        heights.push_back(other.treeHeight());
+        total += other.size_;
+        other.root_ = nullptr;
+        other.size_ = 0;
+        other.top_.rebuild(other.root_, other.size_);
+    }
+
+    // subtrees of height h hold at least 2^h values when they are perfectly
+    // balanced, and rarely much fewer
+    int min_height = 0;
+    for (unsigned int i = grain; i > 1; i >>= 1) min_height++;
+
+    // the workers only relink nodes, and keep the duplicates they find until the end
+    std::vector<Node*> discarded(pool.size(), nullptr);
+    int merged_height;
+    pool.run([&]() {
+        this->root_ = unionTrees(&roots[0], &heights[0], roots.size(), merged_height, discarded, pool, min_height);
+    });
+
+    for (unsigned int i = 0; i < discarded.size(); ++i) total -= deleteList(discarded[i]);
+    this->size_ = total;
+    this->top_.rebuild(this->root_, this->size_);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicAVLTree<Key, Compare, Allocator, Augment>::Node* BasicAVLTree<Key, Compare, Allocator, Augment>::unionNodesParallel(
+        Node* a, int a_height, Node* b, int b_height, int& merged_height, std::vector<Node*>& discarded, TaskPool& pool,
+        int min_height) {
+    if (a_height < min_height || b_height < min_height) {
+        return unionNodes(a, a_height, b, b_height, merged_height, discarded[TaskPool::workerIndex()]);
+    }
+
+    // the same as unionNodes, with the two halves forked
+    Node* b_left = b->left;
+    Node* b_right = b->right;
+    int b_left_height = b_height - (b->avlBalance > 0 ? 2 : 1);
+    int b_right_height = b_height - (b->avlBalance < 0 ? 2 : 1);
+
+    Node *a_left, *a_right;
+    int a_left_height, a_right_height;
+    Node* middle = splitNode(a, a_height, b->val, a_left, a_left_height, a_right, a_right_height);
+
+    if (middle != nullptr) {
+        b->left = discarded[TaskPool::workerIndex()];
+        discarded[TaskPool::workerIndex()] = b;
+    }
+    else middle = b;
+
+    Node *left, *right;
+    int left_height, right_height;
+    pool.fork_join(
+        [&]() {
+            left = unionNodesParallel(a_left, a_left_height, b_left, b_left_height, left_height, discarded, pool, min_height);
+        },
+        [&]() {
+            right = unionNodesParallel(a_right, a_right_height, b_right, b_right_height, right_height, discarded, pool,
+                                       min_height);
+        });
+    return join(left, left_height, middle, right, right_height, merged_height);
+}
+
+template <class Key, class Compare, class Allocator, class Augment>
+typename BasicAVLTree<Key, Compare, Allocator, Augment>::Node* BasicAVLTree<Key, Compare, Allocator, Augment>::unionTrees(
+        Node** roots, int* heights, unsigned int count, int& merged_height, std::vector<Node*>& discarded, TaskPool& pool,
+        int min_height) {
+    if (count == 1) { // base case
+        merged_height = heights[0];
+        return roots[0];
+    }
+
+    unsigned int half = count / 2;
+    Node *left, *right;
+    int left_height, right_height;
+    pool.fork_join(
+        [&]() { left = unionTrees(roots, heights, half, left_height, discarded, pool, min_height); },
+        [&]() { right = unionTrees(roots + half, heights + half, count - half, right_height, discarded, pool, min_height); });
+    return unionNodesParallel(left, left_height, right, right_height, merged_height, discarded, pool, min_height);
+}
+
+#endif
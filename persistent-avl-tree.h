@@ -0,0 +1,398 @@
+#ifndef LAB3_PERSISTENT_AVL_TREE_H
+#define LAB3_PERSISTENT_AVL_TREE_H
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <new>
+
+// A node of a persistent AVL tree. Once a node is linked from more than one place
+// it is never changed again, so every tree that reaches it sees the same subtree.
+template <class Key>
+struct PersistentAVLTreeNode {
+    typedef Key DataType;
+
+    explicit PersistentAVLTreeNode(const Key& value) : refs(1), left(nullptr), right(nullptr), height(1), val(value) {}
+
+    std::atomic<unsigned int> refs;  // Number of trees and nodes that link to this node.
+    PersistentAVLTreeNode* left;     // Pointer to the left node.
+    PersistentAVLTreeNode* right;    // Pointer to the right node.
+    int height;                      // Height of the subtree, 1 for a leaf.
+    DataType val;                    // Value of the node.
+};
+
+// AVL tree whose versions share structure. Copying a tree, or taking a
+// snapshot(), takes O(1): the copy links to the same root. insert and remove copy
+// only the O(log n) nodes on their path that are shared with another version,
+// and change the nodes that only this version links to in place, so a tree that
+// was never copied costs no more than an ordinary one.
+//
+// Nodes are reference counted with atomics, and are never changed while another
+// version can reach them, so a snapshot can be read and destroyed on any thread
+// while the tree it came from keeps changing, without either side waiting. Taking
+// the snapshot itself must not overlap with a change to the same tree. Since
+// nodes may be freed from any thread, the allocator must be thread-safe, which is
+// why this tree uses std::allocator by default rather than a NodePool.
+template <class Key, class Compare = std::less<Key>, class Allocator = std::allocator<Key> >
+class BasicPersistentAVLTree {
+public:
+    typedef Key DataType;
+    typedef PersistentAVLTreeNode<Key> Node;
+
+    BasicPersistentAVLTree();
+
+    // Copies share the nodes of other, in O(1).
+    BasicPersistentAVLTree(const BasicPersistentAVLTree& other);
+    BasicPersistentAVLTree& operator=(const BasicPersistentAVLTree& other);
+
+    // Drops this version's link to its root, freeing the nodes no other version uses.
+    ~BasicPersistentAVLTree();
+
+    // Returns a copy of the tree as it is now, in O(1), which later changes to this
+    // tree do not affect.
+    BasicPersistentAVLTree snapshot() const;
+
+    // Removes every value of this version.
+    void clear();
+
+    // Returns the number of values in the tree.
+    unsigned int size() const;
+
+    // Returns whether val is in the tree.
+    bool exists(const DataType& val) const;
+
+    // Calls visit(value) for every value in [lo, hi) in order.
+    template <class Visitor>
+    void scan(const DataType& lo, const DataType& hi, Visitor visit) const;
+
+    // Inserts or removes val, copying the shared nodes on its path, and returns
+    // whether the tree changed.
+    bool insert(const DataType& val);
+    bool remove(const DataType& val);
+
+private:
+    friend class PersistentAVLTreeTest;
+
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Node> NodeAllocator;
+
+    // Pointer to the root node of this version, which holds one reference to it.
+    Node* root_;
+
+    // Number of values in this version.
+    unsigned int size_;
+
+    NodeAllocator allocator_;
+    Compare compare_;
+
+    // A tree of fewer than 2^32 nodes is never taller than this.
+    static const int MAX_HEIGHT = 48;
+
+    // Returns a new node holding val, with one reference.
+    Node* newNode(const Key& val);
+
+    // Adds a reference to n, or drops one, freeing n (and dropping its links to its
+    // children) if it was the last. Both accept nullptr.
+    static void retain(Node* n);
+    void release(Node* n);
+
+    // Returns n if the caller holds the only reference to it, so that it can be
+    // changed in place. Otherwise returns a copy, which the caller's link takes
+    // over from n.
+    Node* own(Node* n);
+
+    // Returns the height of the subtree n, 0 if it is empty.
+    static int heightOf(const Node* n);
+
+    // Recomputes the height of n, which the caller owns, and restores its balance by
+    // rotating if needed. Returns the new root of the subtree.
+    Node* rebalance(Node* n);
+
+    // Rotate the owned subtree n and return its new root.
+    Node* rotateLeft(Node* n);
+    Node* rotateRight(Node* n);
+
+    // Searches for val from the root, recording in path every node passed and in
+    // went_right the side taken from it, and copies nothing. Returns the depth of
+    // the last node passed, which holds val if found is set, or whose missing child
+    // val would go in; -1 if the tree is empty.
+    int searchPath(const Key& val, Node** path, bool* went_right, bool& found) const;
+
+    // Owns the first count nodes of path, from the root down, so that a change
+    // below them can be made in place, and puts the owned nodes in path. Returns
+    // the link from the last of them to the next node of the path.
+    Node** ownPath(Node** path, const bool* went_right, int count);
+
+    // Rebalances the first count nodes of path, which are owned, from the bottom
+    // up after a change below them, relinking each subtree to its parent.
+    void rebalancePath(Node** path, const bool* went_right, int count);
+
+    // Calls visit(value) for every value of the subtree n in [lo, hi) in order.
+    template <class Visitor>
+    void scanNode(const Node* n, const Key& lo, const Key& hi, Visitor& visit) const;
+};
+
+typedef BasicPersistentAVLTree<int> PersistentAVLTree;
+
+template <class Key, class Compare, class Allocator>
+BasicPersistentAVLTree<Key, Compare, Allocator>::BasicPersistentAVLTree() : root_(nullptr), size_(0) {}
+
+template <class Key, class Compare, class Allocator>
+BasicPersistentAVLTree<Key, Compare, Allocator>::BasicPersistentAVLTree(const BasicPersistentAVLTree& other)
+    : root_(other.root_), size_(other.size_), allocator_(other.allocator_), compare_(other.compare_) {
+    retain(root_);
+}
+
+template <class Key, class Compare, class Allocator>
+BasicPersistentAVLTree<Key, Compare, Allocator>& BasicPersistentAVLTree<Key, Compare, Allocator>::operator=(
+        const BasicPersistentAVLTree& other) {
+    retain(other.root_); // first, in case other is this tree
+    release(root_);
+    root_ = other.root_;
+    size_ = other.size_;
+    return *this;
+}
+
+template <class Key, class Compare, class Allocator>
+BasicPersistentAVLTree<Key, Compare, Allocator>::~BasicPersistentAVLTree() {
+    release(root_);
+}
+
+template <class Key, class Compare, class Allocator>
+BasicPersistentAVLTree<Key, Compare, Allocator> BasicPersistentAVLTree<Key, Compare, Allocator>::snapshot() const {
+    return *this;
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicPersistentAVLTree<Key, Compare, Allocator>::clear() {
+    release(root_);
+    root_ = nullptr;
+    size_ = 0;
+}
+
+template <class Key, class Compare, class Allocator>
+unsigned int BasicPersistentAVLTree<Key, Compare, Allocator>::size() const {
+    return size_;
+}
+
+template <class Key, class Compare, class Allocator>
+bool BasicPersistentAVLTree<Key, Compare, Allocator>::exists(const DataType& val) const {
+    const Node* n = root_;
+    while (n != nullptr) {
+        if (compare_(val, n->val)) n = n->left;
+        else if (compare_(n->val, val)) n = n->right;
+        else return true;
+    }
+    return false;
+}
+
+template <class Key, class Compare, class Allocator>
+template <class Visitor>
+void BasicPersistentAVLTree<Key, Compare, Allocator>::scan(const DataType& lo, const DataType& hi, Visitor visit) const {
+    scanNode(root_, lo, hi, visit);
+}
+
+template <class Key, class Compare, class Allocator>
+template <class Visitor>
+void BasicPersistentAVLTree<Key, Compare, Allocator>::scanNode(const Node* n, const Key& lo, const Key& hi,
+                                                               Visitor& visit) const {
+    if (n == nullptr) return; // base case
+
+    // only descend into the sides that can hold values in [lo, hi)
+    bool above_lo = !compare_(n->val, lo);
+    bool below_hi = compare_(n->val, hi);
+    if (above_lo) scanNode(n->left, lo, hi, visit);
+    if (above_lo && below_hi) visit(n->val);
+    if (below_hi) scanNode(n->right, lo, hi, visit);
+}
+
+template <class Key, class Compare, class Allocator>
+bool BasicPersistentAVLTree<Key, Compare, Allocator>::insert(const DataType& val) {
+
+    // search before copying anything, so that inserting a value already there copies nothing
+    Node* path[MAX_HEIGHT];
+    bool went_right[MAX_HEIGHT];
+    bool found;
+    int depth = searchPath(val, path, went_right, found);
+    if (found) return false;
+
+    // the new node hangs below the last node of the path, which changes with its parents
+    *ownPath(path, went_right, depth + 1) = newNode(val);
+    rebalancePath(path, went_right, depth + 1);
+    size_++;
+    return true;
+}
+
+template <class Key, class Compare, class Allocator>
+bool BasicPersistentAVLTree<Key, Compare, Allocator>::remove(const DataType& val) {
+    Node* path[MAX_HEIGHT];
+    bool went_right[MAX_HEIGHT];
+    bool found;
+    int depth = searchPath(val, path, went_right, found);
+    if (!found) return false;
+
+    // a node with two children takes the value of its successor, which is removed instead
+    int target = depth;
+    Node* n = path[depth];
+    if (n->left != nullptr && n->right != nullptr) {
+        went_right[depth++] = true;
+        n = n->right;
+        while (n->left != nullptr) {
+            path[depth] = n;
+            went_right[depth++] = false;
+            n = n->left;
+        }
+        path[depth] = n;
+    }
+
+    // the node removed has one child or none, which takes over its link
+    Node** link = ownPath(path, went_right, depth);
+    n = *link;
+    if (target != depth) path[target]->val = n->val;
+    Node* child = (n->left != nullptr) ? n->left : n->right;
+    retain(child);
+    *link = child;
+    release(n);
+
+    rebalancePath(path, went_right, depth);
+    size_--;
+    return true;
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicPersistentAVLTree<Key, Compare, Allocator>::Node* BasicPersistentAVLTree<Key, Compare, Allocator>::newNode(
+        const Key& val) {
+    Node* n = allocator_.allocate(1);
+    new (n) Node(val);
+    return n;
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicPersistentAVLTree<Key, Compare, Allocator>::retain(Node* n) {
+    if (n != nullptr) n->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicPersistentAVLTree<Key, Compare, Allocator>::release(Node* n) {
+    if (n == nullptr || n->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+    // the recursion only continues into children whose last link was n, and is
+    // as deep as the tree at most
+    Node* left = n->left;
+    Node* right = n->right;
+    n->~Node();
+    allocator_.deallocate(n, 1);
+    release(left);
+    release(right);
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicPersistentAVLTree<Key, Compare, Allocator>::Node* BasicPersistentAVLTree<Key, Compare, Allocator>::own(
+        Node* n) {
+
+    // no other version can reach a node that only we link to, so none can start to
+    if (n->refs.load(std::memory_order_acquire) == 1) return n;
+
+    Node* copy = newNode(n->val);
+    copy->left = n->left;
+    copy->right = n->right;
+    copy->height = n->height;
+    retain(copy->left);
+    retain(copy->right);
+    release(n);
+    return copy;
+}
+
+template <class Key, class Compare, class Allocator>
+int BasicPersistentAVLTree<Key, Compare, Allocator>::heightOf(const Node* n) {
+    return n != nullptr ? n->height : 0;
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicPersistentAVLTree<Key, Compare, Allocator>::Node* BasicPersistentAVLTree<Key, Compare, Allocator>::rebalance(
+        Node* n) {
+    int balance = heightOf(n->right) - heightOf(n->left);
+    if (balance > 1) {
+        if (heightOf(n->right->left) > heightOf(n->right->right)) {
+            n->right = own(n->right);
+            n->right = rotateRight(n->right);
+        }
+        return rotateLeft(n);
+    }
+    if (balance < -1) {
+        if (heightOf(n->left->right) > heightOf(n->left->left)) {
+            n->left = own(n->left);
+            n->left = rotateLeft(n->left);
+        }
+        return rotateRight(n);
+    }
+
+    n->height = 1 + std::max(heightOf(n->left), heightOf(n->right));
+    return n;
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicPersistentAVLTree<Key, Compare, Allocator>::Node* BasicPersistentAVLTree<Key, Compare, Allocator>::rotateLeft(
+        Node* n) {
+
+    // the pivot changes, so it may have to be copied first; the links only move
+    Node* pivot = own(n->right);
+    n->right = pivot->left;
+    pivot->left = n;
+    n->height = 1 + std::max(heightOf(n->left), heightOf(n->right));
+    pivot->height = 1 + std::max(heightOf(pivot->left), heightOf(pivot->right));
+    return pivot;
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicPersistentAVLTree<Key, Compare, Allocator>::Node* BasicPersistentAVLTree<Key, Compare, Allocator>::rotateRight(
+        Node* n) {
+    Node* pivot = own(n->left);
+    n->left = pivot->right;
+    pivot->right = n;
+    n->height = 1 + std::max(heightOf(n->left), heightOf(n->right));
+    pivot->height = 1 + std::max(heightOf(pivot->left), heightOf(pivot->right));
+    return pivot;
+}
+
+template <class Key, class Compare, class Allocator>
+int BasicPersistentAVLTree<Key, Compare, Allocator>::searchPath(const Key& val, Node** path, bool* went_right,
+                                                                bool& found) const {
+    int depth = -1;
+    found = false;
+    for (Node* n = root_; n != nullptr; n = went_right[depth] ? n->right : n->left) {
+        path[++depth] = n;
+        if (compare_(val, n->val)) went_right[depth] = false;
+        else if (compare_(n->val, val)) went_right[depth] = true;
+        else {
+            found = true;
+            break;
+        }
+    }
+    return depth;
+}
+
+template <class Key, class Compare, class Allocator>
+typename BasicPersistentAVLTree<Key, Compare, Allocator>::Node** BasicPersistentAVLTree<Key, Compare, Allocator>::ownPath(
+        Node** path, const bool* went_right, int count) {
+
+    // a node is only known to be unshared once its parent is, so this goes top down
+    Node** link = &root_;
+    for (int i = 0; i < count; ++i) {
+        path[i] = *link = own(*link);
+        link = went_right[i] ? &path[i]->right : &path[i]->left;
+    }
+    return link;
+}
+
+template <class Key, class Compare, class Allocator>
+void BasicPersistentAVLTree<Key, Compare, Allocator>::rebalancePath(Node** path, const bool* went_right, int count) {
+    for (int i = count - 1; i >= 0; --i) {
+        Node* n = rebalance(path[i]);
+        if (i == 0) root_ = n;
+        else if (went_right[i - 1]) path[i - 1]->right = n;
+        else path[i - 1]->left = n;
+    }
+}
+
+#endif
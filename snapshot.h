@@ -0,0 +1,442 @@
+#ifndef LAB3_SNAPSHOT_H
+#define LAB3_SNAPSHOT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A snapshot is a file holding the values of a tree in order:
+//
+//   bytes 0..63    SnapshotHeader
+//   bytes 64..     the count values, sizeof(Key) bytes each, in the byte order of
+//                  the machine that wrote them
+//
+// The values start on a 64-byte boundary, so a mapped snapshot can be searched
+// in place as a sorted array. The checksum covers the value bytes, and a file
+// whose version, key size or byte order differs from the reader's is refused
+// rather than converted.
+struct SnapshotHeader {
+    char magic[8];            // SNAPSHOT_MAGIC.
+    std::uint32_t version;    // SNAPSHOT_VERSION when written.
+    std::uint32_t byteOrder;  // SNAPSHOT_BYTE_ORDER as the writer stored it.
+    std::uint32_t keySize;    // sizeof(Key).
+    std::uint32_t headerSize; // Offset of the first value, sizeof(SnapshotHeader).
+    std::uint64_t count;      // Number of values.
+    std::uint64_t checksum;   // SnapshotChecksum of the value bytes.
+    char reserved[24];        // Zeros, for later versions.
+};
+
+static_assert(sizeof(SnapshotHeader) == 64, "the values of a snapshot start at byte 64");
+
+static const char SNAPSHOT_MAGIC[8] = {'A', 'V', 'L', 'S', 'N', 'A', 'P', '\0'};
+static const std::uint32_t SNAPSHOT_VERSION = 1;
+static const std::uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+// Checksum of a stream of bytes: FNV-1a taken over 8-byte words instead of
+// bytes, which is several times faster and still changes with any changed,
+// missing or reordered word. Bytes can be added in pieces of any size.
+class SnapshotChecksum {
+public:
+    SnapshotChecksum() : hash_(OFFSET_BASIS), word_(0), bytes_(0) {}
+
+    void update(const void* data, std::size_t size) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        const unsigned char* end = p + size;
+
+        // finish a word left over from the last piece, then take whole words
+        while (p != end && bytes_ != 0) add(*p++);
+        for (; end - p >= 8; p += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, p, 8);
+            hash_ = (hash_ ^ word) * PRIME;
+        }
+        while (p != end) add(*p++);
+    }
+
+    std::uint64_t value() const {
+        return bytes_ == 0 ? hash_ : ((hash_ ^ word_) * PRIME) ^ bytes_;
+    }
+
+private:
+    static const std::uint64_t OFFSET_BASIS = 14695981039346656037ull;
+    static const std::uint64_t PRIME = 1099511628211ull;
+
+    void add(unsigned char byte) {
+        word_ |= (std::uint64_t)byte << (8 * bytes_);
+        if (++bytes_ == 8) {
+            hash_ = (hash_ ^ word_) * PRIME;
+            word_ = 0;
+            bytes_ = 0;
+        }
+    }
+
+    std::uint64_t hash_;
+    std::uint64_t word_;   // Bytes of a word not yet complete, lowest first.
+    unsigned int bytes_;   // Number of them.
+};
+
+// Returns whether header describes a snapshot of keys of keySize bytes that this
+// build can read.
+inline bool validSnapshotHeader(const SnapshotHeader& header, std::size_t keySize) {
+    return std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 && header.version == SNAPSHOT_VERSION &&
+           header.byteOrder == SNAPSHOT_BYTE_ORDER && header.keySize == keySize &&
+           header.headerSize == sizeof(SnapshotHeader);
+}
+
+// Syncs the directory holding path, so that a file just created or renamed
+// there is found under its name after a crash. Returns false if that fails.
+inline bool syncParentDirectory(const std::string& path) {
+    std::string::size_type slash = path.rfind('/');
+    std::string directory = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int fd = ::open(directory.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+// Writes a snapshot one value at a time, through a buffer, to path.tmp, which
+// replaces path only once commit() has written and synced all of it. So a crash
+// or an error never leaves a partial snapshot at path.
+template <class Key>
+class SnapshotWriter {
+    static_assert(std::is_trivially_copyable<Key>::value, "a snapshot stores its keys as bytes");
+
+public:
+    SnapshotWriter() : file_(nullptr), expected_(0), counted_(false), written_(0), ok_(false) {}
+    ~SnapshotWriter() { abandon(); }
+
+    // Starts a snapshot of count values, or of as many as are written before commit()
+    // if no count is given. Returns false if the file cannot be created.
+    bool open(const std::string& path, std::uint64_t count) {
+        if (!open(path)) return false;
+        expected_ = count;
+        counted_ = true;
+        return true;
+    }
+
+    bool open(const std::string& path) {
+        abandon();
+        path_ = path;
+        expected_ = 0;
+        counted_ = false;
+        written_ = 0;
+        buffer_.clear();
+        buffer_.reserve(BUFFER_KEYS);
+        checksum_ = SnapshotChecksum();
+
+        file_ = std::fopen((path_ + ".tmp").c_str(), "wb");
+        if (file_ == nullptr) return false;
+
+        // the header is written again with the checksum once the values are in
+        SnapshotHeader header = makeHeader();
+        ok_ = std::fwrite(&header, sizeof(header), 1, file_) == 1;
+        return ok_;
+    }
+
+    // Adds the next value, which must not be less than the last one.
+    void write(const Key& val) {
+        buffer_.push_back(val);
+        if (buffer_.size() == BUFFER_KEYS) flush();
+    }
+
+    // Completes the snapshot and moves it to path. Returns false, and leaves path
+    // as it was, if any write failed or not exactly count values were written.
+    bool commit() {
+        if (file_ == nullptr) return false;
+        flush();
+        bool ok = ok_ && (!counted_ || written_ == expected_);
+
+        SnapshotHeader header = makeHeader();
+        header.count = written_;
+        header.checksum = checksum_.value();
+        ok = ok && std::fseek(file_, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, file_) == 1;
+        ok = ok && std::fflush(file_) == 0 && fsync(fileno(file_)) == 0;
+        ok = std::fclose(file_) == 0 && ok;
+        file_ = nullptr;
+
+        ok = ok && std::rename((path_ + ".tmp").c_str(), path_.c_str()) == 0 && syncParentDirectory(path_);
+        if (!ok) std::remove((path_ + ".tmp").c_str());
+        return ok;
+    }
+
+private:
+    // Values per write to the file, 256 KB of ints.
+    static const std::size_t BUFFER_KEYS = 1 << 16;
+
+    SnapshotHeader makeHeader() const {
+        SnapshotHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        header.version = SNAPSHOT_VERSION;
+        header.byteOrder = SNAPSHOT_BYTE_ORDER;
+        header.keySize = sizeof(Key);
+        header.headerSize = sizeof(SnapshotHeader);
+        header.count = expected_;
+        return header;
+    }
+
+    // Writes out the buffer, remembering in ok_ if that fails.
+    void flush() {
+        std::size_t bytes = buffer_.size() * sizeof(Key);
+        checksum_.update(buffer_.data(), bytes);
+        written_ += buffer_.size();
+        if (!buffer_.empty() && std::fwrite(buffer_.data(), bytes, 1, file_) != 1) ok_ = false;
+        buffer_.clear();
+    }
+
+    // Drops a snapshot that was opened but never committed.
+    void abandon() {
+        if (file_ == nullptr) return;
+        std::fclose(file_);
+        file_ = nullptr;
+        std::remove((path_ + ".tmp").c_str());
+    }
+
+    std::FILE* file_;
+    std::string path_;
+    std::uint64_t expected_;  // Number of values the header promises.
+    bool counted_;            // Whether that number was given to open().
+    std::uint64_t written_;   // Number of values flushed to the file so far.
+    bool ok_;                 // Whether every write so far succeeded.
+    std::vector<Key> buffer_;
+    SnapshotChecksum checksum_;
+
+    // Sets copy constructor and assignment operator to private.
+    SnapshotWriter(const SnapshotWriter& other);
+    SnapshotWriter& operator=(const SnapshotWriter& other);
+};
+
+// Reads the values of a snapshot in order, through a buffer. It is its own
+// iterator: *reader is the current value and ++reader moves to the next, so a
+// tree can be built straight from it in one pass. Whether the file was whole,
+// in order by Compare and matched its checksum is only known at the end, from
+// finish().
+template <class Key, class Compare = std::less<Key> >
+class SnapshotReader {
+    static_assert(std::is_trivially_copyable<Key>::value, "a snapshot stores its keys as bytes");
+
+public:
+    SnapshotReader() : file_(nullptr), remaining_(0), pos_(0), ok_(false) {}
+    ~SnapshotReader() { close(); }
+
+    // Opens the snapshot at path and positions the reader on its first value.
+    // Returns false if the file cannot be read, or its header does not describe a
+    // snapshot of Keys of the size the file has.
+    bool open(const std::string& path) {
+        close();
+        ok_ = false;
+        file_ = std::fopen(path.c_str(), "rb");
+        if (file_ == nullptr) return false;
+
+        struct stat info;
+        if (std::fread(&header_, sizeof(header_), 1, file_) != 1 || !validSnapshotHeader(header_, sizeof(Key)) ||
+            fstat(fileno(file_), &info) != 0 || header_.count > (std::uint64_t)info.st_size / sizeof(Key) ||
+            (std::uint64_t)info.st_size != sizeof(SnapshotHeader) + header_.count * sizeof(Key)) {
+            close();
+            return false;
+        }
+
+        remaining_ = header_.count;
+        checksum_ = SnapshotChecksum();
+        buffer_.assign(1, Key());
+        pos_ = 0;
+        ok_ = true;
+        if (remaining_ > 0) refill();
+        return ok_;
+    }
+
+    // Returns the number of values in the snapshot.
+    std::uint64_t size() const { return header_.count; }
+
+    const Key& operator*() const { return buffer_[pos_]; }
+    SnapshotReader& operator++() {
+        if (++pos_ == buffer_.size()) refill();
+        else if (!compare_(buffer_[pos_ - 1], buffer_[pos_])) ok_ = false;
+        return *this;
+    }
+
+    // Returns whether every value was read, in order, and matched the checksum.
+    bool finish() {
+        bool ok = ok_ && remaining_ == 0 && (header_.count == 0 || pos_ == buffer_.size()) &&
+                  checksum_.value() == header_.checksum;
+        close();
+        return ok;
+    }
+
+private:
+    // Values per read from the file, 256 KB of ints.
+    static const std::size_t BUFFER_KEYS = 1 << 16;
+
+    // Reads the next values into the buffer, unless every value has been read. If
+    // the read fails, the buffer is filled with copies of the last value instead,
+    // so that the caller can read on to the end before finish() fails.
+    void refill() {
+        if (remaining_ == 0) return;
+
+        Key last = buffer_.back();
+        bool first = (remaining_ == header_.count);
+        std::size_t count = remaining_ < BUFFER_KEYS ? (std::size_t)remaining_ : BUFFER_KEYS;
+        buffer_.resize(count);
+        if (std::fread(buffer_.data(), sizeof(Key) * count, 1, file_) != 1) {
+            ok_ = false;
+            std::fill(buffer_.begin(), buffer_.end(), last);
+        }
+        else {
+            checksum_.update(buffer_.data(), sizeof(Key) * count);
+            if (!first && !compare_(last, buffer_[0])) ok_ = false;
+        }
+
+        remaining_ -= count;
+        pos_ = 0;
+    }
+
+    void close() {
+        if (file_ != nullptr) std::fclose(file_);
+        file_ = nullptr;
+    }
+
+    std::FILE* file_;
+    SnapshotHeader header_;
+    std::uint64_t remaining_;  // Number of values not read into the buffer yet.
+    std::vector<Key> buffer_;
+    std::size_t pos_;          // Index of the current value in the buffer.
+    bool ok_;                  // Whether nothing has gone wrong so far.
+    SnapshotChecksum checksum_;
+    Compare compare_;
+
+    // Sets copy constructor and assignment operator to private.
+    SnapshotReader(const SnapshotReader& other);
+    SnapshotReader& operator=(const SnapshotReader& other);
+};
+
+// Read-only view of a snapshot mapped into memory, which answers lookups and
+// range scans from the file itself by binary search, without building a tree.
+// Opening takes one pass to verify the checksum and the order of the values
+// (or none, if asked not to), and the pages are read in by the lookups that
+// touch them. Needs POSIX mmap.
+template <class Key, class Compare = std::less<Key> >
+class BasicMappedSnapshot {
+public:
+    typedef Key DataType;
+
+    // The values are a sorted array, so iterators are pointers into it.
+    typedef const Key* iterator;
+    typedef iterator const_iterator;
+
+    BasicMappedSnapshot() : map_(nullptr), length_(0), values_(nullptr), size_(0) {}
+    ~BasicMappedSnapshot() { close(); }
+
+    // Maps the snapshot at path, replacing any snapshot mapped before. With verify,
+    // checks the checksum and the order of the values too, which reads the whole
+    // file. Returns false, leaving nothing mapped, if the file cannot be mapped or
+    // is not a valid snapshot of Keys.
+    bool open(const std::string& path, bool verify = true);
+
+    // Unmaps the snapshot.
+    void close();
+
+    bool isOpen() const { return map_ != nullptr; }
+
+    // Returns the number of values.
+    std::size_t size() const { return size_; }
+
+    // Returns the smallest and the largest value. The snapshot must not be empty.
+    const DataType& min() const { return values_[0]; }
+    const DataType& max() const { return values_[size_ - 1]; }
+
+    // Returns whether a value equivalent to val is in the snapshot.
+    bool exists(const DataType& val) const {
+        iterator it = lower_bound(val);
+        return it != end() && !compare_(val, *it);
+    }
+
+    iterator begin() const { return values_; }
+    iterator end() const { return values_ + size_; }
+
+    // Returns the first value that is not less than val, or end() if there is none.
+    iterator lower_bound(const DataType& val) const { return std::lower_bound(begin(), end(), val, compare_); }
+
+    // Calls visit(value) for every value in [lo, hi) in order.
+    template <class Visitor>
+    void scan(const DataType& lo, const DataType& hi, Visitor visit) const {
+        for (iterator it = lower_bound(lo); it != end() && compare_(*it, hi); ++it) visit(*it);
+    }
+
+private:
+    friend class SnapshotTest;
+
+    static_assert(std::is_trivially_copyable<Key>::value, "a snapshot stores its keys as bytes");
+
+    void* map_;            // The mapping of the whole file, or nullptr.
+    std::size_t length_;   // Its length in bytes.
+    const Key* values_;    // The values, just past the header.
+    std::size_t size_;     // Number of values.
+    Compare compare_;
+
+    // Sets copy constructor and assignment operator to private.
+    BasicMappedSnapshot(const BasicMappedSnapshot& other);
+    BasicMappedSnapshot& operator=(const BasicMappedSnapshot& other);
+};
+
+typedef BasicMappedSnapshot<int> MappedSnapshot;
+
+template <class Key, class Compare>
+bool BasicMappedSnapshot<Key, Compare>::open(const std::string& path, bool verify) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (std::size_t)info.st_size < sizeof(SnapshotHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    // the mapping keeps the file open, so the descriptor is not needed past this
+    length_ = info.st_size;
+    map_ = mmap(nullptr, length_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        return false;
+    }
+
+    const SnapshotHeader& header = *static_cast<const SnapshotHeader*>(map_);
+    values_ = reinterpret_cast<const Key*>(static_cast<const char*>(map_) + sizeof(SnapshotHeader));
+    size_ = header.count;
+    bool ok = validSnapshotHeader(header, sizeof(Key)) && header.count <= length_ / sizeof(Key) &&
+              length_ == sizeof(SnapshotHeader) + size_ * sizeof(Key);
+
+    if (ok && verify) {
+        SnapshotChecksum checksum;
+        checksum.update(values_, size_ * sizeof(Key));
+        for (std::size_t i = 1; ok && i < size_; ++i) ok = compare_(values_[i - 1], values_[i]);
+        ok = ok && checksum.value() == header.checksum;
+    }
+
+    if (!ok) close();
+    return ok;
+}
+
+template <class Key, class Compare>
+void BasicMappedSnapshot<Key, Compare>::close() {
+    if (map_ != nullptr) munmap(map_, length_);
+    map_ = nullptr;
+    length_ = 0;
+    values_ = nullptr;
+    size_ = 0;
+}
+
+#endif
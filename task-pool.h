@@ -0,0 +1,240 @@
+#ifndef LAB3_TASK_POOL_H
+#define LAB3_TASK_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork-join pool of worker threads that steal work from each other. A task
+// forks by pushing one half of its work onto the bottom of its worker's deque
+// and running the other half itself. Idle workers steal from the top of the
+// other deques, which holds the oldest and so largest pieces of work. A worker
+// waiting for a stolen half runs other tasks in the meantime, so no thread
+// blocks while there is work left.
+class TaskPool {
+public:
+    // Starts threads - 1 worker threads. The thread that calls run() is the last
+    // worker, so a pool of 1 thread runs everything on the calling thread.
+    explicit TaskPool(unsigned int threads = std::thread::hardware_concurrency());
+
+    // Stops and joins the worker threads.
+    ~TaskPool();
+
+    // Returns the number of workers, including the thread that calls run().
+    unsigned int size() const;
+
+    // Runs f() on the calling thread as worker 0, so that the work it forks can
+    // run on the other workers, and returns when f and all of that work have
+    // finished. Calls from different threads must not overlap, but a task of
+    // the pool can call run() again, which then simply calls f().
+    template <class F>
+    void run(F f);
+
+    // Runs left() and right(), possibly in parallel, and returns when both have
+    // finished. Outside of run(), both simply run on the calling thread.
+    template <class F, class G>
+    void fork_join(F left, G right);
+
+    // Returns the index of the worker that the calling thread is, from 0 to size() - 1,
+    // or 0 if it is not a worker of any pool.
+    static unsigned int workerIndex();
+
+private:
+    // A forked piece of work, which lives on the stack of the fork_join that made it.
+    struct Task {
+        void (*execute)(Task* task);
+        std::atomic<bool> done;
+    };
+
+    template <class F>
+    struct BoundTask : Task {
+        F* f;
+        static void call(Task* task) { (*static_cast<BoundTask*>(task)->f)(); }
+    };
+
+    // The tasks forked by one worker: the owner pushes and pops at the back, and
+    // thieves take from the front.
+    struct Worker {
+        std::mutex lock;
+        std::deque<Task*> tasks;
+    };
+
+    // The pool and worker index of the calling thread.
+    static TaskPool*& currentPool();
+    static unsigned int& currentIndex();
+
+    // Main loop of worker thread index.
+    void workerLoop(unsigned int index);
+
+    // Pushes task onto, or pops the newest task from, the deque of worker index.
+    void push(unsigned int index, Task* task);
+    Task* pop(unsigned int index);
+
+    // Takes the oldest task of some worker other than index, or returns nullptr.
+    Task* steal(unsigned int index);
+
+    // Runs one task of worker index, or one stolen from another worker. Returns
+    // false if there was none.
+    bool runOne(unsigned int index);
+
+    std::vector<std::unique_ptr<Worker> > workers_;
+    std::vector<std::thread> threads_;
+
+    std::mutex wake_lock_;
+    std::condition_variable wake_;
+    std::atomic<bool> running_;  // Whether run() is in progress, so workers look for work.
+    bool stopping_;              // Whether the pool is being destroyed, guarded by wake_lock_.
+
+    // Sets copy constructor and assignment operator to private.
+    TaskPool(const TaskPool& other);
+    TaskPool& operator=(const TaskPool& other);
+};
+
+inline TaskPool::TaskPool(unsigned int threads) : running_(false), stopping_(false) {
+    if (threads == 0) threads = 1;
+    for (unsigned int i = 0; i < threads; ++i) workers_.push_back(std::unique_ptr<Worker>(new Worker()));
+    for (unsigned int i = 1; i < threads; ++i) threads_.push_back(std::thread(&TaskPool::workerLoop, this, i));
+}
+
+inline TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> guard(wake_lock_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (unsigned int i = 0; i < threads_.size(); ++i) threads_[i].join();
+}
+
+inline unsigned int TaskPool::size() const {
+    return workers_.size();
+}
+
+inline TaskPool*& TaskPool::currentPool() {
+    static thread_local TaskPool* pool = nullptr;
+    return pool;
+}
+
+inline unsigned int& TaskPool::currentIndex() {
+    static thread_local unsigned int index = 0;
+    return index;
+}
+
+inline unsigned int TaskPool::workerIndex() {
+    return currentIndex();
+}
+
+template <class F>
+void TaskPool::run(F f) {
+    if (currentPool() == this) { // already a worker of this pool
+        f();
+        return;
+    }
+
+    // wake the workers, and join them as worker 0 until f is done
+    {
+        std::lock_guard<std::mutex> guard(wake_lock_);
+        running_ = true;
+    }
+    wake_.notify_all();
+
+    TaskPool* outer_pool = currentPool();
+    unsigned int outer_index = currentIndex();
+    currentPool() = this;
+    currentIndex() = 0;
+
+    f();
+
+    currentPool() = outer_pool;
+    currentIndex() = outer_index;
+    running_ = false;
+}
+
+template <class F, class G>
+void TaskPool::fork_join(F left, G right) {
+    if (currentPool() != this) {
+        left();
+        right();
+        return;
+    }
+
+    // offer the right half to the other workers, and run the left half
+    unsigned int index = currentIndex();
+    BoundTask<G> task;
+    task.execute = &BoundTask<G>::call;
+    task.done = false;
+    task.f = &right;
+    push(index, &task);
+
+    left();
+
+    // every task forked since is gone again, so the newest task is ours unless it was stolen
+    if (pop(index) == &task) {
+        right();
+        return;
+    }
+
+    // otherwise help with other work until the thief is done with it
+    while (!task.done.load(std::memory_order_acquire)) {
+        if (!runOne(index)) std::this_thread::yield();
+    }
+}
+
+inline void TaskPool::workerLoop(unsigned int index) {
+    currentPool() = this;
+    currentIndex() = index;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(wake_lock_);
+            wake_.wait(guard, [this]() { return running_ || stopping_; });
+            if (stopping_) return;
+        }
+
+        while (running_) {
+            if (!runOne(index)) std::this_thread::yield();
+        }
+    }
+}
+
+inline void TaskPool::push(unsigned int index, Task* task) {
+    std::lock_guard<std::mutex> guard(workers_[index]->lock);
+    workers_[index]->tasks.push_back(task);
+}
+
+inline TaskPool::Task* TaskPool::pop(unsigned int index) {
+    std::lock_guard<std::mutex> guard(workers_[index]->lock);
+    if (workers_[index]->tasks.empty()) return nullptr;
+
+    Task* task = workers_[index]->tasks.back();
+    workers_[index]->tasks.pop_back();
+    return task;
+}
+
+inline TaskPool::Task* TaskPool::steal(unsigned int index) {
+    for (unsigned int i = 1; i < workers_.size(); ++i) {
+        Worker* victim = workers_[(index + i) % workers_.size()].get();
+        std::lock_guard<std::mutex> guard(victim->lock);
+        if (victim->tasks.empty()) continue;
+
+        Task* task = victim->tasks.front();
+        victim->tasks.pop_front();
+        return task;
+    }
+    return nullptr;
+}
+
+inline bool TaskPool::runOne(unsigned int index) {
+    Task* task = pop(index);
+    if (task == nullptr) task = steal(index);
+    if (task == nullptr) return false;
+
+    task->execute(task);
+    task->done.store(true, std::memory_order_release);
+    return true;
+}
+
+#endif
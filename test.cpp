@@ -1,10 +1,34 @@
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <queue>
+#include <random>
+#include <set>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <sys/stat.h>
 
 #include "binary-search-tree.h"
 #include "avl-tree.h"
+#include "frozen-tree.h"
+#include "parallel-avl-tree.h"
+#include "snapshot.h"
+#include "durable-avl-tree.h"
+#include "compact-avl-tree.h"
+#include "b-plus-tree.h"
+#include "avl-map.h"
+#include "concurrent-avl-tree.h"
+#include "persistent-avl-tree.h"
 
 using namespace std;
 
@@ -21,7 +45,8 @@ string get_status_str(bool status) {
 }
 
 // Function for getting the tree as a string
-std::string breadthFirstTraversal(BinarySearchTree::Node* root) {
+template <class Key, class Augment>
+std::string breadthFirstTraversal(BinarySearchTreeNode<Key, Augment>* root) {
 
     // If no nodes, return an empty string.
     if (root == nullptr) {
@@ -30,7 +55,7 @@ std::string breadthFirstTraversal(BinarySearchTree::Node* root) {
 
     // Init a string buffer, and queue for traversal.
     stringstream ss;
-    queue<BinarySearchTree::Node*> queue;
+    queue<BinarySearchTreeNode<Key, Augment>*> queue;
 
     // Seed the traversal.
     queue.push(root);
@@ -40,7 +65,7 @@ std::string breadthFirstTraversal(BinarySearchTree::Node* root) {
     while (!queue.empty()) {
 
         // Get the node.
-        BinarySearchTree::Node* cur = queue.front();
+        BinarySearchTreeNode<Key, Augment>* cur = queue.front();
         queue.pop();
 
         // Push this value into the string buffer.
@@ -60,11 +85,256 @@ std::string breadthFirstTraversal(BinarySearchTree::Node* root) {
     return level_order_str;
 }
 
+// Function for checking the cached balance and parent of every node against the real tree.
+// Returns the height of the tree, or -2 if a link or balance is stale or (for AVL trees) out of range.
+template <class Key, class Augment>
+int checkedHeight(BinarySearchTreeNode<Key, Augment>* root, bool avl) {
+
+    // An empty subtree has a height of -1.
+    if (root == nullptr) {
+        return -1;
+    }
+
+    int left_height = checkedHeight(root->left, avl);
+    int right_height = checkedHeight(root->right, avl);
+    if (left_height == -2 || right_height == -2) {
+        return -2;
+    }
+
+    // The children must link back to their parent.
+    if ((root->left != nullptr && root->left->parent != root) ||
+        (root->right != nullptr && root->right->parent != root)) {
+        return -2;
+    }
+
+    // The cached balance must match the heights, and an AVL tree must be balanced.
+    if (root->avlBalance != right_height - left_height) {
+        return -2;
+    }
+    if (avl && (root->avlBalance < -1 || root->avlBalance > 1)) {
+        return -2;
+    }
+
+    return 1 + (left_height > right_height ? left_height : right_height);
+}
+
+// Function for checking the cached subtree size of every node against the real tree.
+// Returns the number of nodes in the tree, or -1 if a size is stale.
+template <class Key>
+int checkedSize(BinarySearchTreeNode<Key, SubtreeSize>* root) {
+
+    // An empty subtree has no nodes.
+    if (root == nullptr) {
+        return 0;
+    }
+
+    int left_size = checkedSize(root->left);
+    int right_size = checkedSize(root->right);
+    if (left_size == -1 || right_size == -1 || (int)root->subtreeSize != 1 + left_size + right_size) {
+        return -1;
+    }
+
+    return 1 + left_size + right_size;
+}
+
+// Function for checking the cached height, parent and version of every node of a concurrent
+// AVL tree. Returns the height of the tree (1 for a single node), or -1 if a link or height is
+// stale, a node is left marked as changing, or the tree is out of balance.
+template <class Key>
+int checkedHeight(ConcurrentAVLTreeNode<Key>* root) {
+
+    // An empty subtree has a height of 0.
+    if (root == nullptr) {
+        return 0;
+    }
+
+    ConcurrentAVLTreeNode<Key>* left = root->left;
+    ConcurrentAVLTreeNode<Key>* right = root->right;
+    if ((left != nullptr && left->parent != root) || (right != nullptr && right->parent != root)) {
+        return -1;
+    }
+
+    int left_height = checkedHeight(left);
+    int right_height = checkedHeight(right);
+    int height = 1 + (left_height > right_height ? left_height : right_height);
+    if (left_height == -1 || right_height == -1 || abs(right_height - left_height) > 1 || root->height != height ||
+        root->version % 2 != 0) {
+        return -1;
+    }
+
+    return height;
+}
+
+// Function for getting the keys still present in a concurrent AVL tree, in order.
+template <class Key>
+vector<Key> presentKeys(ConcurrentAVLTreeNode<Key>* root) {
+    vector<Key> keys;
+    vector<ConcurrentAVLTreeNode<Key>*> stack;
+    ConcurrentAVLTreeNode<Key>* cur = root;
+    while (cur != nullptr || !stack.empty()) {
+        while (cur != nullptr) {
+            stack.push_back(cur);
+            cur = cur->left;
+        }
+        cur = stack.back();
+        stack.pop_back();
+        if (cur->present) {
+            keys.push_back(cur->key);
+        }
+        cur = cur->right;
+    }
+    return keys;
+}
+
+// Function for checking the cached height of every node of a persistent AVL tree. Returns the
+// height of the tree (1 for a single node), or -1 if a height is stale or the tree is out of balance.
+template <class Key>
+int checkedHeight(const PersistentAVLTreeNode<Key>* root) {
+
+    // An empty subtree has a height of 0.
+    if (root == nullptr) {
+        return 0;
+    }
+
+    int left_height = checkedHeight(root->left);
+    int right_height = checkedHeight(root->right);
+    int height = 1 + (left_height > right_height ? left_height : right_height);
+    if (left_height == -1 || right_height == -1 || abs(right_height - left_height) > 1 || root->height != height) {
+        return -1;
+    }
+
+    return height;
+}
+
+// Function for getting every value of a persistent AVL tree, in order.
+template <class Tree>
+vector<typename Tree::DataType> treeValues(const Tree& tree) {
+    vector<typename Tree::DataType> values;
+    tree.scan(numeric_limits<typename Tree::DataType>::min(), numeric_limits<typename Tree::DataType>::max(),
+              [&values](typename Tree::DataType val) { values.push_back(val); });
+    return values;
+}
+
+// Function for collecting the distinct nodes of a persistent AVL tree.
+template <class Key>
+void collectNodes(const PersistentAVLTreeNode<Key>* root, set<const PersistentAVLTreeNode<Key>*>& nodes) {
+    if (root == nullptr) {
+        return;
+    }
+    nodes.insert(root);
+    collectNodes(root->left, nodes);
+    collectNodes(root->right, nodes);
+}
+
+// Function for checking the nodes of a B+-tree below n, which sit in levels levels. Every
+// value must be in [lo, hi) (a nullptr bound is open), the keys of each node sorted, and every
+// node but the root at least half full. Adds the leaves to leaves in order, and returns the
+// number of values below n, or -1 if a check fails.
+template <class Key>
+int checkedCount(const BPlusTreeNode<Key>* n, unsigned int levels, bool root, const Key* lo, const Key* hi,
+                 vector<const BPlusTreeLeaf<Key>*>& leaves) {
+    const Key* keys = (levels == 1) ? static_cast<const BPlusTreeLeaf<Key>*>(n)->keys
+                                    : static_cast<const BPlusTreeInner<Key>*>(n)->keys;
+    unsigned int capacity = (levels == 1) ? BPlusTreeLeaf<Key>::CAPACITY : BPlusTreeInner<Key>::CAPACITY;
+    if (n->count > capacity || (!root && n->count < capacity / 2) || (levels > 1 && n->count == 0)) {
+        return -1;
+    }
+    for (unsigned int i = 0; i < n->count; ++i) {
+        if ((i > 0 && !(keys[i - 1] < keys[i])) || (lo != nullptr && keys[i] < *lo) || (hi != nullptr && !(keys[i] < *hi))) {
+            return -1;
+        }
+    }
+
+    if (levels == 1) {
+        leaves.push_back(static_cast<const BPlusTreeLeaf<Key>*>(n));
+        return n->count;
+    }
+
+    // Child i holds the values between the separators on either side of it.
+    const BPlusTreeInner<Key>* inner = static_cast<const BPlusTreeInner<Key>*>(n);
+    int count = 0;
+    for (unsigned int i = 0; i <= n->count; ++i) {
+        int child = checkedCount(inner->children[i], levels - 1, false, i > 0 ? &keys[i - 1] : lo,
+                                 i < n->count ? &keys[i] : hi, leaves);
+        if (child == -1) {
+            return -1;
+        }
+        count += child;
+    }
+    return count;
+}
+
+// Function for checking a whole B+-tree, including that its leaves are linked in order. Returns
+// the number of values in the tree, or -1 if a check fails.
+template <class Key>
+int checkedCount(const BPlusTreeNode<Key>* root, unsigned int height) {
+    if (root == nullptr) {
+        return height == 0 ? 0 : -1;
+    }
+
+    vector<const BPlusTreeLeaf<Key>*> leaves;
+    int count = checkedCount<Key>(root, height, true, nullptr, nullptr, leaves);
+    for (unsigned int i = 0; i < leaves.size(); ++i) {
+        if (leaves[i]->next != (i + 1 < leaves.size() ? leaves[i + 1] : nullptr)) {
+            return -1;
+        }
+    }
+    return count;
+}
+
+// Key that counts how many times keys have been copied, to check that the trees
+// move keys into their nodes instead of copying them.
+struct CountedKey {
+    static int copies;
+
+    int val;
+
+    CountedKey(int newval) : val(newval) {}
+    CountedKey(const CountedKey& other) : val(other.val) { copies++; }
+    CountedKey(CountedKey&& other) : val(other.val) {}
+    CountedKey& operator=(const CountedKey& other) { val = other.val; copies++; return *this; }
+    CountedKey& operator=(CountedKey&& other) { val = other.val; return *this; }
+
+    bool operator<(const CountedKey& other) const { return val < other.val; }
+};
+
+int CountedKey::copies = 0;
+
+// Allocator that counts the objects allocated from it and not yet freed, to check
+// when the trees free their nodes.
+template <class T>
+struct CountingAllocator {
+    typedef T value_type;
+
+    static atomic<int> live;
+
+    CountingAllocator() {}
+    template <class U> CountingAllocator(const CountingAllocator<U>&) {}
+
+    T* allocate(size_t n) { live += n; return std::allocator<T>().allocate(n); }
+    void deallocate(T* p, size_t n) { live -= n; std::allocator<T>().deallocate(p, n); }
+
+    bool operator==(const CountingAllocator&) const { return true; }
+    bool operator!=(const CountingAllocator&) const { return false; }
+};
+
+template <class T>
+atomic<int> CountingAllocator<T>::live(0);
+
+// Comparator that counts its calls, to check how many times the trees search.
+struct CountingLess {
+    static int calls;
+
+    bool operator()(int a, int b) const { calls++; return a < b; }
+};
+
+int CountingLess::calls = 0;
+
 // Define the test suites (implementation below).
 class BinarySearchTreeTest {
 private:
-    bool test_result[8] = {0,0,0,0,0,0,0,0};
-    string test_description[8] = {
+    bool test_result[13] = {0,0,0,0,0,0,0,0,0,0,0,0,0};
+    string test_description[13] = {
         "Test1: New tree is valid",
         "Test2: Test a tree with one node",
         "Test3: Insert, remove, and size on linear list formation with three elements",
@@ -72,7 +342,12 @@ private:
         "Test5: Insert multiple elements and remove till nothing remains",
         "Test6: Test removal of root node when both children of root have two children",
         "Test7: Test depth with many inserts and some removes",
-        "Test8: Lots of inserts and removes"
+        "Test8: Lots of inserts and removes",
+        "Test9: Test recomputing the balance of an unbalanced tree",
+        "Test10: Test that removed nodes are reused by later inserts",
+        "Test11: Test clearing a degenerate tree and reusing it",
+        "Test12: Test rank and select with subtree sizes",
+        "Test13: Test streaming the values in order in chunks"
     };
 
 public:
@@ -88,18 +363,37 @@ public:
     bool test6();
     bool test7();
     bool test8();
+    bool test9();
+    bool test10();
+    bool test11();
+    bool test12();
+    bool test13();
 };
 
 class AVLTreeTest {
 private:
-    bool test_result[6] = {0,0,0,0,0,0};
-    string test_description[6] = {
+    bool test_result[20] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+    string test_description[20] = {
         "Test1: Test single left rotation",
         "Test2: Test single right rotation",
         "Test3: Test double left-right rotation",
         "Test4: Test double right-left rotation",
         "Test5: Test multiple rotations on insert",
-        "Test6: Test multiple rotations on remove"
+        "Test6: Test multiple rotations on remove",
+        "Test7: Test cached balances after many inserts and removes",
+        "Test8: Test nodes visited per operation",
+        "Test9: Test string keys with a custom comparator",
+        "Test10: Test inserting and removing keys without copying them",
+        "Test11: Test iterating over the tree in both directions",
+        "Test12: Test bounds and range scans",
+        "Test13: Test rank, select and count_range through rotations",
+        "Test14: Test building a tree from sorted and unsorted values",
+        "Test15: Test inserting and erasing batches",
+        "Test16: Test splitting and joining trees",
+        "Test17: Test union, intersection and difference",
+        "Test18: Test parallel build and parallel multi-tree union",
+        "Test19: Test the lookup index over the top levels stays in sync",
+        "Test20: Test the operation stats of a tree"
     };
 
 public:
@@ -113,6 +407,174 @@ public:
     bool test4();
     bool test5();
     bool test6();
+    bool test7();
+    bool test8();
+    bool test9();
+    bool test10();
+    bool test11();
+    bool test12();
+    bool test13();
+    bool test14();
+    bool test15();
+    bool test16();
+    bool test17();
+    bool test18();
+    bool test19();
+    bool test20();
+};
+
+
+class AVLMapTest {
+private:
+    bool test_result[5] = {0,0,0,0,0};
+    string test_description[5] = {
+        "Test1: Test find, emplace and erase",
+        "Test2: Test try_emplace only uses its arguments for a new key",
+        "Test3: Test insert_or_assign and operator[]",
+        "Test4: Test many keys stay balanced",
+        "Test5: Test iterating and changing values in key order"
+    };
+
+public:
+    string getTestDescription(int test_num);
+    void runAllTests();
+    void printReport();
+
+    bool test1();
+    bool test2();
+    bool test3();
+    bool test4();
+    bool test5();
+};
+
+class ConcurrentAVLTreeTest {
+private:
+    bool test_result[4] = {0,0,0,0};
+    string test_description[4] = {
+        "Test1: Test insert, remove and exists on one thread",
+        "Test2: Test random inserts and removes against std::set",
+        "Test3: Test readers and writers running at the same time",
+        "Test4: Test removed nodes are freed once no reader can see them"
+    };
+
+public:
+    string getTestDescription(int test_num);
+    void runAllTests();
+    void printReport();
+
+    bool test1();
+    bool test2();
+    bool test3();
+    bool test4();
+};
+
+class PersistentAVLTreeTest {
+private:
+    bool test_result[3] = {0,0,0};
+    string test_description[3] = {
+        "Test1: Test insert, remove and exists against std::set",
+        "Test2: Test snapshots share nodes and do not change",
+        "Test3: Test reading snapshots on other threads while the tree changes"
+    };
+
+public:
+    string getTestDescription(int test_num);
+    void runAllTests();
+    void printReport();
+
+    bool test1();
+    bool test2();
+    bool test3();
+};
+
+class BPlusTreeTest {
+private:
+    bool test_result[2] = {0,0};
+    string test_description[2] = {
+        "Test1: Test insert, remove, exists and scan against std::set",
+        "Test2: Test sorted inserts and removes, and node layout"
+    };
+
+public:
+    string getTestDescription(int test_num);
+    void runAllTests();
+    void printReport();
+
+    bool test1();
+    bool test2();
+};
+
+class FrozenTreeTest {
+private:
+    bool test_result[2] = {0,0};
+    string test_description[2] = {
+        "Test1: Test lookups in frozen trees of every shape",
+        "Test2: Test range scans, layout and memory of a large frozen tree"
+    };
+
+public:
+    string getTestDescription(int test_num);
+    void runAllTests();
+    void printReport();
+
+    bool test1();
+    bool test2();
+};
+
+class CompactAVLTreeTest {
+private:
+    bool test_result[2] = {0,0};
+    string test_description[2] = {
+        "Test1: Test random operations on a compact AVL tree against std::set",
+        "Test2: Test sorted inserts, slot reuse and memory of compact AVL trees"
+    };
+
+    // Checks the subtree n of tree: every value in [lo, hi) (a nullptr bound is open), and
+    // every balance right. Adds the number of values to count, and returns the height of
+    // the subtree, or -1 if a check fails.
+    static int checkedHeight(const CompactAVLTree& tree, uint32_t n, const int* lo, const int* hi, unsigned int& count);
+
+public:
+    string getTestDescription(int test_num);
+    void runAllTests();
+    void printReport();
+
+    bool test1();
+    bool test2();
+};
+
+class SnapshotTest {
+private:
+    bool test_result[2] = {0,0};
+    string test_description[2] = {
+        "Test1: Test saving and loading trees, and refusing damaged snapshots",
+        "Test2: Test lookups and range scans on a mapped snapshot"
+    };
+
+public:
+    string getTestDescription(int test_num);
+    void runAllTests();
+    void printReport();
+
+    bool test1();
+    bool test2();
+};
+
+class DurableAVLTreeTest {
+private:
+    bool test_result[2] = {0,0};
+    string test_description[2] = {
+        "Test1: Test that changes survive reopening and a torn log",
+        "Test2: Test folding the log into the snapshot"
+    };
+
+public:
+    string getTestDescription(int test_num);
+    void runAllTests();
+    void printReport();
+
+    bool test1();
+    bool test2();
 };
 
 
@@ -121,10 +583,46 @@ public:
 //======================================================================
 int main() {
 
+    BinarySearchTreeTest bst_test;
+    bst_test.runAllTests();
+    bst_test.printReport();
+
     AVLTreeTest avl_test;
     avl_test.runAllTests();
     avl_test.printReport();
 
+    AVLMapTest map_test;
+    map_test.runAllTests();
+    map_test.printReport();
+
+    ConcurrentAVLTreeTest concurrent_test;
+    concurrent_test.runAllTests();
+    concurrent_test.printReport();
+
+    PersistentAVLTreeTest persistent_test;
+    persistent_test.runAllTests();
+    persistent_test.printReport();
+
+    BPlusTreeTest b_plus_test;
+    b_plus_test.runAllTests();
+    b_plus_test.printReport();
+
+    FrozenTreeTest frozen_test;
+    frozen_test.runAllTests();
+    frozen_test.printReport();
+
+    CompactAVLTreeTest compact_test;
+    compact_test.runAllTests();
+    compact_test.printReport();
+
+    SnapshotTest snapshot_test;
+    snapshot_test.runAllTests();
+    snapshot_test.printReport();
+
+    DurableAVLTreeTest durable_avl_tree_test;
+    durable_avl_tree_test.runAllTests();
+    durable_avl_tree_test.printReport();
+
     return 0;
 }
 
@@ -133,7 +631,7 @@ int main() {
 //====================== Binary Search Tree Test =======================
 //======================================================================
 string BinarySearchTreeTest::getTestDescription(int test_num) {
-    if (test_num < 1 || test_num > 8) { // check range.
+    if (test_num < 1 || test_num > 13) { // check range.
         return "";
     }
     return test_description[test_num-1];
@@ -148,12 +646,17 @@ void BinarySearchTreeTest::runAllTests() {
     test_result[5] = test6();
     test_result[6] = test7();
     test_result[7] = test8();
+    test_result[8] = test9();
+    test_result[9] = test10();
+    test_result[10] = test11();
+    test_result[11] = test12();
+    test_result[12] = test13();
 }
 
 void BinarySearchTreeTest::printReport() {
     cout << "  BINARY SEARCH TREE TEST RESULTS  \n"
          << " ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^ \n";
-    for (int idx = 0; idx < 8; ++idx) {
+    for (int idx = 0; idx < 13; ++idx) {
         cout << test_description[idx] << "\n  " << get_status_str(test_result[idx]) << endl << endl;
     }
     cout << endl;
@@ -391,63 +894,242 @@ bool BinarySearchTreeTest::test8() {
     return true;
 }
 
+// Test 9: Test recomputing the balance of an unbalanced tree
+bool BinarySearchTreeTest::test9() {
 
-//======================================================================
-//=========================== AVL Tree Test ============================
-//======================================================================
-string AVLTreeTest::getTestDescription(int test_num) {
-    if (test_num < 1 || test_num > 6) { // check range.
-        return "";
+    // Test set up.
+    BinarySearchTree bst;
+
+    // Insert a bunch of nodes into the tree in the following order.
+    BinarySearchTree::DataType in[8] = {8, 3, 1, 2, 10, 9, 15, 20};
+    for (auto val : in) {
+        ASSERT_TRUE(bst.insert(val))
     }
-    return test_description[test_num-1];
-}
 
-void AVLTreeTest::runAllTests() {
-    test_result[0] = test1();
-    test_result[1] = test2();
-    test_result[2] = test3();
-    test_result[3] = test4();
-    test_result[4] = test5();
-    test_result[5] = test6();
-}
+    // The plain tree does not keep its balances, so recompute them.
+    bst.updateNodeBalance(bst.root_);
+    ASSERT_TRUE(checkedHeight(bst.root_, false) == 3)
+    ASSERT_TRUE(bst.root_->avlBalance == 0)
+    ASSERT_TRUE(bst.root_->left->avlBalance == -2)
+    ASSERT_TRUE(bst.root_->right->avlBalance == 1)
 
-void AVLTreeTest::printReport() {
-    cout << "  AVL TREE TEST RESULTS  \n"
-         << " ^^^^^^^^^^^^^^^^^^^^^^^ \n";
-    for (int idx = 0; idx < 6; ++idx) {
-        cout << test_description[idx] << "\n  " << get_status_str(test_result[idx]) << endl << endl;
-    }
-    cout << endl;
+    // Return true to signal all tests passed.
+    return true;
 }
 
-// Test 1: Test single left rotation
-bool AVLTreeTest::test1() {
+// Test 10: Test that removed nodes are reused by later inserts
+bool BinarySearchTreeTest::test10() {
 
     // Test set up.
-    AVLTree avl;
+    BinarySearchTree bst;
+    HeapBinarySearchTree heap_bst;
 
-    // Insert a some nodes into the tree in the following order.
-    BinarySearchTree::DataType in[3] = {1, 2, 3};
+    // Insert a bunch of nodes into both trees in the following order.
+    BinarySearchTree::DataType in[7] = {8, 3, 10, 1, 6, 9, 15};
     for (auto val : in) {
-        ASSERT_TRUE(avl.insert(val))
-        //avl.print();
+        ASSERT_TRUE(bst.insert(val))
+        ASSERT_TRUE(heap_bst.insert(val))
     }
 
-    //avl.print();
-    //cout << avl.root_->right->val << endl; // tree shape is 1->2->3 all to the right
+    // The next insert after a remove gets the memory of the removed node.
+    BinarySearchTree::Node* removed = bst.root_->left->right;
+    ASSERT_TRUE(bst.remove(6))
+    ASSERT_TRUE(bst.insert(7))
+    ASSERT_TRUE(bst.root_->left->right == removed && removed->val == 7)
 
-    // Check that a left rotation occurred.
-    string expected_tree1 = "2 1 3";
-    string tree_level_order1 = breadthFirstTraversal(avl.root_);
-    ASSERT_TRUE(tree_level_order1.compare(expected_tree1) == 0)
+    // Both allocators build the same tree.
+    ASSERT_TRUE(heap_bst.remove(6))
+    ASSERT_TRUE(heap_bst.insert(7))
+    string tree_level_order = breadthFirstTraversal(bst.root_);
+    ASSERT_TRUE(tree_level_order.compare(breadthFirstTraversal(heap_bst.root_)) == 0)
 
-    // Add additional nodes and check that another left rotation occurred.
-    ASSERT_TRUE(avl.insert(7) && avl.insert(11))
+    // Return true to signal all tests passed.
+    return true;
+}
 
-    //avl.print();
+// Test 11: Test clearing a degenerate tree and reusing it
+bool BinarySearchTreeTest::test11() {
 
-    // Check the new tree representation.
-    string expected_tree2 = "2 1 7 3 11";
+    // Test set up.
+    BinarySearchTree bst;
+    HeapBinarySearchTree heap_bst;
+
+    // Build two long linked lists, one leaning each way.
+    for (int val = 0; val < 2000; ++val) {
+        ASSERT_TRUE(bst.insert(val))
+        ASSERT_TRUE(heap_bst.insert(-val))
+    }
+    ASSERT_TRUE(bst.depth() == 1999 && heap_bst.depth() == 1999)
+
+    // Clearing empties both trees.
+    bst.clear();
+    heap_bst.clear();
+    ASSERT_TRUE(bst.root_ == nullptr && bst.size() == 0)
+    ASSERT_TRUE(heap_bst.root_ == nullptr && heap_bst.size() == 0)
+    ASSERT_FALSE(bst.exists(5) || heap_bst.exists(-5))
+
+    // The trees can be used again, and clearing an empty tree does nothing.
+    ASSERT_TRUE(bst.insert(5) && heap_bst.insert(5))
+    ASSERT_TRUE(bst.exists(5) && heap_bst.exists(5))
+    ASSERT_TRUE(bst.size() == 1 && heap_bst.size() == 1)
+    heap_bst.clear();
+    heap_bst.clear();
+    ASSERT_TRUE(heap_bst.size() == 0)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 12: Test rank and select with subtree sizes
+bool BinarySearchTreeTest::test12() {
+
+    // Test set up.
+    OrderStatisticBinarySearchTree bst;
+    BinarySearchTree::DataType in[9] = {50, 30, 70, 20, 40, 60, 80, 35, 45};
+    for (auto val : in) {
+        ASSERT_TRUE(bst.insert(val))
+    }
+    ASSERT_FALSE(bst.insert(40))
+    ASSERT_TRUE(checkedSize(bst.root_) == 9)
+
+    // Rank counts the smaller values, and select finds a value by its rank.
+    ASSERT_TRUE(bst.rank(20) == 0 && bst.rank(45) == 4 && bst.rank(81) == 9)
+    ASSERT_TRUE(*bst.select(0) == 20 && *bst.select(4) == 45 && *bst.select(8) == 80)
+    ASSERT_TRUE(bst.select(9) == bst.end())
+
+    // Remove a leaf, a node with one child and one with two, and check the sizes again.
+    ASSERT_TRUE(bst.remove(35) && bst.remove(20) && bst.remove(30))
+    ASSERT_TRUE(checkedSize(bst.root_) == 6)
+    ASSERT_TRUE(bst.rank(50) == 2 && *bst.select(2) == 50)
+    ASSERT_TRUE(bst.count_range(40, 70) == 4 && bst.count_range(70, 40) == 0)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 13: Test streaming the values in order in chunks
+bool BinarySearchTreeTest::test13() {
+
+    // Test set up.
+    BinarySearchTree bst;
+    BinarySearchTree::DataType buffer[1000];
+    vector<BinarySearchTree::DataType> out;
+    vector<size_t> chunks;
+    auto sink = [&out, &chunks](const BinarySearchTree::DataType* values, size_t count) {
+        out.insert(out.end(), values, values + count);
+        chunks.push_back(count);
+        return true;
+    };
+
+    // An empty tree exports nothing and never calls the sink.
+    ASSERT_TRUE(bst.exportInOrder(buffer, 1000, sink) == 0 && chunks.empty())
+
+    // A chain of a million nodes, far deeper than any recursion could go, streams in full chunks and a last partial one.
+    const int n = 1000000;
+    BinarySearchTree::Node* tail = nullptr;
+    for (int i = 0; i < n; ++i) {
+        BinarySearchTree::Node* node = bst.newNode(i);
+        node->parent = tail;
+        *(tail == nullptr ? &bst.root_ : &tail->right) = node;
+        tail = node;
+    }
+    bst.size_ = n;
+    bst.insert(n + 1);
+    ASSERT_TRUE(bst.exportInOrder(buffer, 1000, sink) == n + 1 && out.size() == n + 1u && chunks.size() == 1001)
+    ASSERT_TRUE(chunks.front() == 1000 && chunks.back() == 1 && out[n] == n + 1)
+    for (int i = 0; i < n; ++i) ASSERT_TRUE(out[i] == i)
+
+    // The sink stops the export by returning false.
+    out.clear();
+    size_t calls = 0;
+    ASSERT_TRUE(bst.exportInOrder(buffer, 3, [&out, &calls](const BinarySearchTree::DataType* values, size_t count) {
+        out.insert(out.end(), values, values + count);
+        return ++calls < 2;
+    }) == 6)
+    ASSERT_TRUE(out == vector<BinarySearchTree::DataType>({0, 1, 2, 3, 4, 5}))
+
+    // Printing a subtree in order stops at its last value, even deep inside the chain.
+    ostringstream printed;
+    streambuf* saved = cout.rdbuf(printed.rdbuf());
+    inOrderTraversal(tail->parent->parent);
+    cout.rdbuf(saved);
+    ASSERT_TRUE(printed.str() == "999997(0), 999998(0), 999999(0), 1000001(0), ")
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+
+//======================================================================
+//=========================== AVL Tree Test ============================
+//======================================================================
+string AVLTreeTest::getTestDescription(int test_num) {
+    if (test_num < 1 || test_num > 20) { // check range.
+        return "";
+    }
+    return test_description[test_num-1];
+}
+
+void AVLTreeTest::runAllTests() {
+    test_result[0] = test1();
+    test_result[1] = test2();
+    test_result[2] = test3();
+    test_result[3] = test4();
+    test_result[4] = test5();
+    test_result[5] = test6();
+    test_result[6] = test7();
+    test_result[7] = test8();
+    test_result[8] = test9();
+    test_result[9] = test10();
+    test_result[10] = test11();
+    test_result[11] = test12();
+    test_result[12] = test13();
+    test_result[13] = test14();
+    test_result[14] = test15();
+    test_result[15] = test16();
+    test_result[16] = test17();
+    test_result[17] = test18();
+    test_result[18] = test19();
+    test_result[19] = test20();
+}
+
+void AVLTreeTest::printReport() {
+    cout << "  AVL TREE TEST RESULTS  \n"
+         << " ^^^^^^^^^^^^^^^^^^^^^^^ \n";
+    for (int idx = 0; idx < 20; ++idx) {
+        cout << test_description[idx] << "\n  " << get_status_str(test_result[idx]) << endl << endl;
+    }
+    cout << endl;
+}
+
+// Test 1: Test single left rotation
+bool AVLTreeTest::test1() {
+
+    // Test set up.
+    AVLTree avl;
+
+    // Insert a some nodes into the tree in the following order.
+    BinarySearchTree::DataType in[3] = {1, 2, 3};
+    for (auto val : in) {
+        ASSERT_TRUE(avl.insert(val))
+        //avl.print();
+    }
+
+    //avl.print();
+    //cout << avl.root_->right->val << endl; // tree shape is 1->2->3 all to the right
+
+    // Check that a left rotation occurred.
+    string expected_tree1 = "2 1 3";
+    string tree_level_order1 = breadthFirstTraversal(avl.root_);
+    ASSERT_TRUE(tree_level_order1.compare(expected_tree1) == 0)
+
+    // Add additional nodes and check that another left rotation occurred.
+    ASSERT_TRUE(avl.insert(7) && avl.insert(11))
+
+    //avl.print();
+
+    // Check the new tree representation.
+    string expected_tree2 = "2 1 7 3 11";
     string tree_level_order2 = breadthFirstTraversal(avl.root_);
     ASSERT_TRUE(tree_level_order2.compare(expected_tree2) == 0)
 
@@ -626,3 +1308,1932 @@ bool AVLTreeTest::test6() {
     // Return true to signal all tests passed.
     return true;
 }
+
+// Test 7: Test cached balances after many inserts and removes
+bool AVLTreeTest::test7() {
+
+    // Test set up.
+    AVLTree avl;
+
+    // Insert a permutation of 0..1008, so every value is new.
+    for (int i = 0; i < 1009; ++i) {
+        ASSERT_TRUE(avl.insert((i * 389) % 1009))
+    }
+    ASSERT_TRUE(avl.size() == 1009)
+    ASSERT_FALSE(avl.insert(500))
+
+    // Every cached balance must match the tree, and the tree must be balanced.
+    ASSERT_TRUE(checkedHeight(avl.root_, true) != -2)
+    ASSERT_TRUE(avl.depth() <= 13)
+
+    // Remove two thirds of the values, checking the balances as we go.
+    for (int i = 0; i < 1009; ++i) {
+        if (i % 3 == 0) continue;
+        ASSERT_TRUE(avl.remove((i * 389) % 1009))
+        ASSERT_TRUE(checkedHeight(avl.root_, true) != -2)
+    }
+    ASSERT_TRUE(avl.size() == 337)
+    ASSERT_FALSE(avl.remove(1))
+    ASSERT_TRUE(avl.exists(0) && avl.exists((3 * 389) % 1009))
+
+    // Recomputing the balances should not change anything.
+    avl.updateNodeBalance(avl.root_);
+    ASSERT_TRUE(checkedHeight(avl.root_, true) != -2)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 8: Test nodes visited per operation
+bool AVLTreeTest::test8() {
+
+    // Test set up: the counts are only kept with LAB3_TREE_STATS defined.
+    AVLTree avl;
+    auto visited = [&avl](unsigned int expected) { return !avl.stats().enabled || avl.nodesVisited() == expected; };
+
+    // Inserting 1..1023 in order builds a perfect tree of depth 9 rooted at 512.
+    for (int val = 1; val < 1024; ++val) {
+        ASSERT_TRUE(avl.insert(val))
+    }
+    ASSERT_TRUE(avl.depth() == 9 && avl.root_->val == 512)
+
+    // A failed insert reads every node from the root down to the duplicate, once.
+    ASSERT_FALSE(avl.insert(512))
+    ASSERT_TRUE(visited(1))
+    ASSERT_FALSE(avl.insert(1))
+    ASSERT_TRUE(visited(10))
+
+    // A new leaf that needs no rotation is found in one descent.
+    ASSERT_TRUE(avl.insert(1024))
+    ASSERT_TRUE(visited(10))
+
+    // A rotation uses the recorded links instead of searching for the parent again.
+    ASSERT_TRUE(avl.insert(1025))
+    ASSERT_TRUE(visited(11))
+    ASSERT_TRUE(avl.root_->right->right->right->right->right->right->right->right->right->val == 1024)
+
+    // Removing a leaf reads its path once, and a missing value reads a full path.
+    ASSERT_TRUE(avl.remove(1))
+    ASSERT_TRUE(visited(10))
+    ASSERT_FALSE(avl.remove(1))
+    ASSERT_TRUE(visited(9))
+
+    // Removing the root walks down to its predecessor.
+    ASSERT_TRUE(avl.remove(512))
+    ASSERT_TRUE(visited(10))
+    ASSERT_TRUE(avl.root_->val == 511)
+
+    // Lookups are counted as well.
+    ASSERT_TRUE(avl.exists(511))
+    ASSERT_TRUE(visited(1))
+    ASSERT_TRUE(checkedHeight(avl.root_, true) != -2)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 9: Test string keys with a custom comparator
+bool AVLTreeTest::test9() {
+
+    // Test set up: strings kept in descending order.
+    BasicAVLTree<string, greater<string> > avl;
+
+    // Insert some words, forcing two left-right rotations in descending order.
+    string in[5] = {"apple", "cherry", "banana", "fig", "date"};
+    for (auto& val : in) {
+        ASSERT_TRUE(avl.insert(val))
+    }
+    ASSERT_FALSE(avl.insert(string("fig")))
+
+    // The smallest key is the first one in the comparator's order.
+    ASSERT_TRUE(avl.min() == "fig" && avl.max() == "apple")
+    ASSERT_TRUE(avl.exists("banana") && !avl.exists("grape"))
+    ASSERT_TRUE(breadthFirstTraversal(avl.getRootNode()) == "banana date apple fig cherry")
+
+    // Removing the root keeps the tree ordered.
+    ASSERT_TRUE(avl.remove("banana"))
+    ASSERT_FALSE(avl.remove("banana"))
+    ASSERT_TRUE(breadthFirstTraversal(avl.getRootNode()) == "cherry date apple fig")
+    ASSERT_TRUE(avl.size() == 4 && avl.min() == "fig" && avl.max() == "apple")
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 10: Test inserting and removing keys without copying them
+bool AVLTreeTest::test10() {
+
+    // Test set up.
+    BasicAVLTree<CountedKey> avl;
+    CountedKey::copies = 0;
+
+    // Insert enough keys to cause rotations, and a duplicate.
+    for (int val = 0; val < 100; ++val) {
+        ASSERT_TRUE(avl.insert(CountedKey(val)))
+    }
+    ASSERT_FALSE(avl.insert(CountedKey(50)))
+
+    // Look up and remove keys, including ones with two children.
+    ASSERT_TRUE(avl.exists(CountedKey(99)))
+    for (int val = 0; val < 100; val += 2) {
+        ASSERT_TRUE(avl.remove(CountedKey(val)))
+    }
+    ASSERT_TRUE(avl.size() == 50 && avl.min().val == 1)
+
+    // None of this should have copied a key.
+    ASSERT_TRUE(CountedKey::copies == 0)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 11: Test iterating over the tree in both directions
+bool AVLTreeTest::test11() {
+
+    // Test set up.
+    AVLTree avl;
+
+    // An empty tree has nothing to visit.
+    ASSERT_TRUE(avl.begin() == avl.end())
+
+    // Insert the keys in an order that makes the tree rotate, then remove some.
+    for (int i = 0; i < 200; ++i) ASSERT_TRUE(avl.insert((i * 37) % 200))
+    for (int i = 0; i < 200; i += 3) ASSERT_TRUE(avl.remove(i))
+    ASSERT_TRUE(checkedHeight(avl.root_, true) != -2)
+
+    // The iterator visits the keys in order.
+    vector<int> forward(avl.begin(), avl.end());
+    ASSERT_TRUE(forward.size() == avl.size())
+    for (unsigned int i = 0; i < forward.size(); ++i) {
+        ASSERT_TRUE(forward[i] % 3 != 0)
+        if (i > 0) ASSERT_TRUE(forward[i - 1] < forward[i])
+    }
+
+    // Stepping back from the end visits them in reverse.
+    AVLTree::iterator it = avl.end();
+    for (int i = (int)forward.size() - 1; i >= 0; --i) {
+        --it;
+        ASSERT_TRUE(*it == forward[i])
+    }
+    ASSERT_TRUE(it == avl.begin())
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 12: Test bounds and range scans
+bool AVLTreeTest::test12() {
+
+    // Test set up.
+    AVLTree avl;
+    for (int i = 0; i < 100; i += 2) ASSERT_TRUE(avl.insert(i))
+
+    // Bounds on keys in the tree, between keys, and past either end.
+    ASSERT_TRUE(*avl.lower_bound(10) == 10 && *avl.upper_bound(10) == 12)
+    ASSERT_TRUE(*avl.lower_bound(11) == 12 && *avl.upper_bound(11) == 12)
+    ASSERT_TRUE(*avl.lower_bound(-5) == 0)
+    ASSERT_TRUE(avl.lower_bound(99) == avl.end() && avl.upper_bound(98) == avl.end())
+
+    // equal_range holds one key if it is in the tree, and none otherwise.
+    pair<AVLTree::iterator, AVLTree::iterator> range = avl.equal_range(40);
+    ASSERT_TRUE(range.first != range.second && *range.first == 40 && *range.second == 42)
+    range = avl.equal_range(41);
+    ASSERT_TRUE(range.first == range.second && *range.first == 42)
+
+    // A scan visits the keys in [lo, hi) in order.
+    vector<int> scanned;
+    avl.scan(15, 31, [&](int key) { scanned.push_back(key); });
+    ASSERT_TRUE(scanned.size() == 8 && scanned.front() == 16 && scanned.back() == 30)
+    for (unsigned int i = 1; i < scanned.size(); ++i) ASSERT_TRUE(scanned[i - 1] + 2 == scanned[i])
+
+    // Empty and out of range scans visit nothing.
+    scanned.clear();
+    avl.scan(31, 31, [&](int key) { scanned.push_back(key); });
+    avl.scan(200, 300, [&](int key) { scanned.push_back(key); });
+    ASSERT_TRUE(scanned.empty())
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 13: Test rank, select and count_range through rotations
+bool AVLTreeTest::test13() {
+
+    // Test set up.
+    OrderStatisticAVLTree avl;
+
+    // Insert the keys in an order that makes the tree rotate, then remove every third one.
+    for (int i = 0; i < 300; ++i) ASSERT_TRUE(avl.insert((i * 7) % 300))
+    for (int i = 0; i < 300; i += 3) ASSERT_TRUE(avl.remove(i))
+    ASSERT_TRUE(checkedHeight(avl.root_, true) != -2)
+    ASSERT_TRUE(checkedSize(avl.root_) == (int)avl.size())
+
+    // The tree holds the keys that are not a multiple of 3, so the rank of a key
+    // is the number of such keys below it.
+    for (int key = 0; key <= 300; ++key) {
+        ASSERT_TRUE(avl.rank(key) == (unsigned int)(key - (key + 2) / 3))
+    }
+    for (unsigned int k = 0; k < avl.size(); ++k) {
+        ASSERT_TRUE(avl.rank(*avl.select(k)) == k)
+    }
+    ASSERT_TRUE(avl.select(avl.size()) == avl.end())
+
+    // Counting a range agrees with scanning it.
+    unsigned int scanned = 0;
+    avl.scan(17, 123, [&](int) { scanned++; });
+    ASSERT_TRUE(avl.count_range(17, 123) == scanned && scanned == 71)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 14: Test building a tree from sorted and unsorted values
+bool AVLTreeTest::test14() {
+
+    // Sorted input of every size up to 100 gives a perfectly balanced tree.
+    vector<int> keys;
+    for (int n = 0; n <= 100; ++n) {
+        OrderStatisticAVLTree avl;
+        avl.build_from_sorted(keys.begin(), keys.end());
+        ASSERT_TRUE(avl.size() == keys.size())
+        ASSERT_TRUE(checkedHeight(avl.root_, true) != -2)
+        ASSERT_TRUE(checkedSize(avl.root_) == n)
+        ASSERT_TRUE(vector<int>(avl.begin(), avl.end()) == keys)
+        unsigned int height = 0;
+        while ((2 << height) <= n) height++;
+        if (n > 0) ASSERT_TRUE(avl.depth() == height)
+        keys.push_back(2 * n);
+    }
+
+    // Unsorted input with duplicates is sorted, and each duplicate is dropped once.
+    int in[8] = {5, 3, 9, 3, 1, 5, 7, 3};
+    AVLTree avl(in, in + 8);
+    ASSERT_TRUE(avl.size() == 5 && checkedHeight(avl.root_, true) != -2)
+    ASSERT_TRUE(breadthFirstTraversal(avl.root_) == "5 1 7 3 9")
+    ASSERT_TRUE(avl.build(in, in + 8) == 3)
+
+    // The built tree keeps balancing as usual, and building again replaces it.
+    for (int i = 0; i < 20; ++i) ASSERT_TRUE(avl.insert(10 + i))
+    ASSERT_TRUE(avl.remove(5) && avl.remove(1))
+    ASSERT_TRUE(checkedHeight(avl.root_, true) != -2)
+    ASSERT_TRUE(avl.build(keys.begin(), keys.end()) == 0 && avl.size() == keys.size())
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 15: Test inserting and erasing batches
+bool AVLTreeTest::test15() {
+
+    // Test set up.
+    OrderStatisticAVLTree avl;
+    set<int> expected;
+
+    // Merge batches of growing size, each with repeated keys and keys already in the tree.
+    for (int round = 0; round < 12; ++round) {
+        vector<int> batch;
+        for (int i = 0; i < round * round * 3; ++i) batch.push_back((i * 61 + round * 17) % 400);
+
+        vector<bool> inserted = avl.insert_batch(batch.begin(), batch.end());
+        ASSERT_TRUE(inserted.size() == batch.size())
+        for (unsigned int i = 0; i < batch.size(); ++i) {
+            ASSERT_TRUE(inserted[i] == expected.insert(batch[i]).second)
+        }
+        ASSERT_TRUE(checkedHeight(avl.root_, true) != -2)
+        ASSERT_TRUE(avl.root_ == nullptr || avl.root_->parent == nullptr)
+        ASSERT_TRUE(checkedSize(avl.root_) == (int)expected.size() && avl.size() == expected.size())
+
+        // Erase every other key of a batch, including keys that are not in the tree.
+        vector<int> to_erase;
+        for (int i = 0; i < round * 20; i += 2) to_erase.push_back((i * 37) % 450);
+        vector<bool> erased = avl.erase_batch(to_erase.begin(), to_erase.end());
+        for (unsigned int i = 0; i < to_erase.size(); ++i) {
+            ASSERT_TRUE(erased[i] == (expected.erase(to_erase[i]) == 1))
+        }
+        ASSERT_TRUE(checkedHeight(avl.root_, true) != -2)
+        ASSERT_TRUE(checkedSize(avl.root_) == (int)expected.size() && avl.size() == expected.size())
+        ASSERT_TRUE(vector<int>(avl.begin(), avl.end()) == vector<int>(expected.begin(), expected.end()))
+    }
+
+    // A batch into an empty tree builds it, and erasing everything empties it again.
+    AVLTree other;
+    vector<int> keys(avl.begin(), avl.end());
+    other.insert_batch(keys.begin(), keys.end());
+    ASSERT_TRUE(other.size() == keys.size() && checkedHeight(other.root_, true) != -2)
+    vector<bool> erased = other.erase_batch(keys.rbegin(), keys.rend());
+    ASSERT_TRUE(other.size() == 0 && other.root_ == nullptr && erased == vector<bool>(keys.size(), true))
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 16: Test splitting and joining trees
+bool AVLTreeTest::test16() {
+
+    // Split a tree at every key, and at keys between them.
+    for (int key = -1; key <= 60; ++key) {
+        OrderStatisticAVLTree avl, left, right;
+        for (int i = 0; i < 30; ++i) ASSERT_TRUE(avl.insert((i * 17) % 30 * 2))
+        ASSERT_TRUE(left.insert(1000)) // replaced by the split
+
+        ASSERT_TRUE(avl.split(key, left, right) == (key >= 0 && key < 60 && key % 2 == 0))
+        ASSERT_TRUE(avl.size() == 0 && avl.root_ == nullptr)
+        ASSERT_TRUE(checkedHeight(left.root_, true) != -2 && checkedHeight(right.root_, true) != -2)
+        ASSERT_TRUE(checkedSize(left.root_) == (int)left.size() && checkedSize(right.root_) == (int)right.size())
+        ASSERT_TRUE(left.size() == (unsigned int)(key < 0 ? 0 : key > 58 ? 30 : (key + 1) / 2))
+        ASSERT_TRUE(left.size() == 0 || left.max() < key)
+        ASSERT_TRUE(right.size() == 0 || right.min() > key)
+
+        // Joining the halves back around the key gives every key again.
+        if (key >= 0 && key < 60) {
+            avl.join(left, key, right);
+            ASSERT_TRUE(left.size() == 0 && right.size() == 0)
+            ASSERT_TRUE(checkedHeight(avl.root_, true) != -2 && checkedSize(avl.root_) == (int)avl.size())
+            ASSERT_TRUE(avl.size() == (key % 2 == 0 ? 30u : 31u) && avl.exists(key))
+        }
+    }
+
+    // Join trees of very different heights from separate pools, into one of them.
+    AVLTree small, large;
+    for (int i = 0; i < 3; ++i) ASSERT_TRUE(small.insert(i))
+    for (int i = 10; i < 1000; ++i) ASSERT_TRUE(large.insert(i))
+    large.join(small, 5, large);
+    ASSERT_TRUE(large.size() == 994 && small.size() == 0 && checkedHeight(large.root_, true) != -2)
+    vector<int> keys(large.begin(), large.end());
+    ASSERT_TRUE(keys.size() == 994 && keys[2] == 2 && keys[3] == 5 && keys[4] == 10)
+
+    // The split halves share one pool, and stay usable on their own.
+    AVLTree low;
+    ASSERT_TRUE(large.split(500, low, large))
+    ASSERT_TRUE(low.size() == 494 && large.size() == 499 && *large.begin() == 501)
+    ASSERT_TRUE(low.insert(500) && large.remove(501) && low.remove(0))
+    ASSERT_TRUE(checkedHeight(low.root_, true) != -2 && checkedHeight(large.root_, true) != -2)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 17: Test union, intersection and difference
+bool AVLTreeTest::test17() {
+
+    // Combine trees of very different sizes, in both directions.
+    int sizes[5] = {0, 1, 7, 100, 2000};
+    for (int a_size : sizes) {
+        for (int b_size : sizes) {
+            set<int> a_keys, b_keys;
+            for (int i = 0; i < a_size; ++i) a_keys.insert((i * 7919) % 4001);
+            for (int i = 0; i < b_size; ++i) b_keys.insert((i * 104729 + 13) % 4001);
+
+            OrderStatisticAVLTree a(a_keys.begin(), a_keys.end()), b(b_keys.begin(), b_keys.end());
+            OrderStatisticAVLTree c(a_keys.begin(), a_keys.end()), d(a_keys.begin(), a_keys.end());
+
+            // Union empties the other tree.
+            set<int> expected = a_keys;
+            expected.insert(b_keys.begin(), b_keys.end());
+            a.set_union(b);
+            ASSERT_TRUE(b.size() == 0 && b.root_ == nullptr)
+            ASSERT_TRUE(checkedHeight(a.root_, true) != -2 && checkedSize(a.root_) == (int)a.size())
+            ASSERT_TRUE(vector<int>(a.begin(), a.end()) == vector<int>(expected.begin(), expected.end()))
+
+            // Intersection and difference leave the other tree as it was.
+            OrderStatisticAVLTree other(b_keys.begin(), b_keys.end());
+            expected.clear();
+            for (int key : a_keys) if (b_keys.count(key)) expected.insert(key);
+            c.set_intersection(other);
+            ASSERT_TRUE(checkedHeight(c.root_, true) != -2 && checkedSize(c.root_) == (int)c.size())
+            ASSERT_TRUE(vector<int>(c.begin(), c.end()) == vector<int>(expected.begin(), expected.end()))
+
+            expected.clear();
+            for (int key : a_keys) if (!b_keys.count(key)) expected.insert(key);
+            d.set_difference(other);
+            ASSERT_TRUE(checkedHeight(d.root_, true) != -2 && checkedSize(d.root_) == (int)d.size())
+            ASSERT_TRUE(vector<int>(d.begin(), d.end()) == vector<int>(expected.begin(), expected.end()))
+            ASSERT_TRUE(other.size() == b_keys.size() && checkedHeight(other.root_, true) != -2)
+        }
+    }
+
+    // Trees that allocate each node with new can be combined too.
+    HeapAVLTree heap_a, heap_b;
+    for (int i = 0; i < 50; ++i) ASSERT_TRUE(heap_a.insert(2 * i) && heap_b.insert(3 * i))
+    heap_a.set_union(heap_b);
+    ASSERT_TRUE(heap_a.size() == 83 && checkedHeight(heap_a.root_, true) != -2)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 18: Test parallel build and parallel multi-tree union
+bool AVLTreeTest::test18() {
+
+    // A tiny grain forks down to small subtrees, even with more workers than cores.
+    TaskPool pool(4);
+    vector<int> keys;
+    for (int i = 0; i < 5000; ++i) keys.push_back(3 * i);
+
+    for (unsigned int grain : {1u, 7u, 100u, 100000u}) {
+        OrderStatisticAVLTree avl;
+        avl.build_from_sorted(keys.begin(), keys.end(), pool, grain);
+        ASSERT_TRUE(avl.size() == 5000 && checkedHeight(avl.root_, true) == 12)
+        ASSERT_TRUE(checkedSize(avl.root_) == 5000)
+        ASSERT_TRUE(vector<int>(avl.begin(), avl.end()) == keys)
+
+        // The nodes built by every worker now belong to the tree's pool.
+        ASSERT_TRUE(avl.remove(0) && avl.insert(1) && avl.size() == 5000)
+        ASSERT_TRUE(checkedHeight(avl.root_, true) != -2)
+    }
+
+    // Merge overlapping trees, each with a pool of its own, into one.
+    for (unsigned int grain : {1u, 16u, 100000u}) {
+        set<int> expected;
+        vector<OrderStatisticAVLTree*> trees;
+        for (int t = 0; t < 5; ++t) {
+            OrderStatisticAVLTree* tree = new OrderStatisticAVLTree();
+            for (int i = 0; i < 300 * (t + 1); ++i) {
+                int key = (i * 7919 + t * 101) % 3001;
+                tree->insert(key);
+                expected.insert(key);
+            }
+            trees.push_back(tree);
+        }
+
+        OrderStatisticAVLTree avl;
+        for (int i = 0; i < 200; ++i) {
+            avl.insert(15 * i);
+            expected.insert(15 * i);
+        }
+        avl.set_union(trees, pool, grain);
+        ASSERT_TRUE(avl.size() == expected.size() && checkedSize(avl.root_) == (int)expected.size())
+        ASSERT_TRUE(checkedHeight(avl.root_, true) != -2)
+        ASSERT_TRUE(vector<int>(avl.begin(), avl.end()) == vector<int>(expected.begin(), expected.end()))
+        for (OrderStatisticAVLTree* tree : trees) {
+            ASSERT_TRUE(tree->size() == 0 && tree->root_ == nullptr)
+            delete tree;
+        }
+
+        // The tree keeps working once the others are gone.
+        for (int key : expected) ASSERT_TRUE(avl.remove(key))
+        ASSERT_TRUE(avl.size() == 0 && avl.root_ == nullptr)
+    }
+
+    // Trees that share a pool, or allocate with new, can be merged as well.
+    OrderStatisticAVLTree whole(keys.begin(), keys.end()), left, right;
+    ASSERT_TRUE(whole.split(7500, left, right))
+    vector<OrderStatisticAVLTree*> halves = {&right};
+    left.set_union(halves, pool, 1);
+    ASSERT_TRUE(left.size() == 4999 && checkedHeight(left.root_, true) != -2 && !left.exists(7500))
+
+    HeapAVLTree heap_a, heap_b;
+    for (int i = 0; i < 50; ++i) ASSERT_TRUE(heap_a.insert(2 * i) && heap_b.insert(3 * i))
+    vector<HeapAVLTree*> heaps = {&heap_b};
+    heap_a.set_union(heaps, pool, 1);
+    ASSERT_TRUE(heap_a.size() == 83 && checkedHeight(heap_a.root_, true) != -2)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 19: Test the lookup index over the top levels stays in sync
+bool AVLTreeTest::test19() {
+
+    // Every version of the key counter agrees with counting one key at a time.
+    mt19937 rng(140);
+    for (int round = 0; round < 100; ++round) {
+        vector<int> keys(8 * (1 + rng() % 16));
+        for (unsigned int i = 0; i < keys.size(); ++i) keys[i] = (int)(rng() % 200) - 100;
+        keys[0] = INT_MIN;
+        int key = (int)(rng() % 220) - 110;
+        unsigned int expected = 0;
+        for (unsigned int i = 0; i < keys.size(); ++i) expected += keys[i] < key;
+        ASSERT_TRUE(KeyCounter::countScalar(keys.data(), keys.size(), key) == expected)
+        ASSERT_TRUE(KeyCounter::countLess(keys.data(), keys.size(), key) == expected)
+#ifdef LAB3_X86_SIMD
+        ASSERT_TRUE(KeyCounter::countSse2(keys.data(), keys.size(), key) == expected)
+        if (__builtin_cpu_supports("avx2")) {
+            ASSERT_TRUE(KeyCounter::countAvx2(keys.data(), keys.size(), key) == expected)
+        }
+#endif
+    }
+
+    // Test set up: a perfect tree of 17 levels, so the index holds its top 7 levels.
+    vector<int> sorted;
+    for (int i = 0; i < (1 << 17) - 1; ++i) sorted.push_back(2 * i);
+    AVLTree avl;
+    avl.build_from_sorted(sorted.begin(), sorted.end());
+    auto visited = [&avl](unsigned int expected) { return !avl.stats().enabled || avl.nodesVisited() == expected; };
+
+    // The root is found in the index without visiting a node, and the deepest keys
+    // only visit the levels below the index.
+    ASSERT_TRUE(avl.exists(sorted[sorted.size() / 2]) && visited(0))
+    ASSERT_TRUE(avl.exists(0) && visited(10))
+    ASSERT_TRUE(!avl.exists(1) && visited(10))
+    ASSERT_TRUE(!avl.exists(-1) && !avl.exists(INT_MAX) && !avl.exists(INT_MIN))
+
+    // Inserts and removes that rotate or replace nodes in the top levels keep the
+    // index in sync, and so do the operations that rebuild the tree. The index is
+    // rebuilt before each change returns, so lookups never find it stale.
+    set<int> expected(sorted.begin(), sorted.end());
+    for (int i = 0; i < 40000; ++i) {
+        int key = rng() % 70000;
+        if (i % 3 == 0) {
+            ASSERT_TRUE(avl.insert(key) == expected.insert(key).second)
+        }
+        else {
+            ASSERT_TRUE(avl.remove(key) == (expected.erase(key) == 1))
+        }
+        int probe = rng() % 70000;
+        ASSERT_TRUE(!avl.top_.stale(avl.size()) && avl.exists(probe) == (expected.count(probe) == 1))
+    }
+    for (int key = -1; key <= 70000; ++key) ASSERT_TRUE(avl.exists(key) == (expected.count(key) == 1))
+
+    // Lookups write nothing, so readers can share the const tree.
+    const AVLTree& shared = avl;
+    atomic<unsigned int> wrong(0);
+    vector<thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.push_back(thread([&shared, &expected, &wrong, t]() {
+            for (int key = t; key <= 70000; key += 4) wrong += shared.exists(key) != (expected.count(key) == 1);
+        }));
+    }
+    for (size_t t = 0; t < readers.size(); ++t) readers[t].join();
+    ASSERT_TRUE(wrong == 0)
+
+    AVLTree left, right;
+    avl.split(35000, left, right);
+    ASSERT_TRUE(!avl.exists(*expected.begin()) && !right.exists(*expected.begin()))
+    for (int key = 0; key < 70000; key += 7) {
+        ASSERT_TRUE(left.exists(key) == (key < 35000 && expected.count(key) == 1))
+        ASSERT_TRUE(right.exists(key) == (key > 35000 && expected.count(key) == 1))
+    }
+    left.join(left, 35000, right);
+    expected.insert(35000);
+    vector<int> odd;
+    for (int i = 1; i < 70000; i += 10) odd.push_back(i);
+    left.insert_batch(odd.begin(), odd.end());
+    expected.insert(odd.begin(), odd.end());
+    for (int key = -1; key <= 70000; ++key) ASSERT_TRUE(left.exists(key) == (expected.count(key) == 1))
+
+    left.clear();
+    ASSERT_TRUE(!left.exists(35000))
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 20: Test the operation stats of a tree
+bool AVLTreeTest::test20() {
+
+    // Test set up.
+    AVLTree tree;
+    TreeStats stats = tree.stats();
+
+#ifdef LAB3_TREE_STATS
+    const TreeStats::Operation INSERT = TreeStats::INSERT, REMOVE = TreeStats::REMOVE, EXISTS = TreeStats::EXISTS;
+    ASSERT_TRUE(stats.enabled && stats.operations[INSERT] == 0 && stats.comparisons == 0 && stats.allocations == 0)
+
+    // Inserting 1, 2 and 3 visits 0, 1 and 2 nodes, and rotates once at the root.
+    tree.insert(1);
+    tree.insert(2);
+    tree.insert(3);
+    stats = tree.stats();
+    ASSERT_TRUE(stats.operations[INSERT] == 3 && stats.nodesVisited[INSERT] == 3 && stats.comparisons == 6)
+    ASSERT_TRUE(stats.pathLengths[INSERT][0] == 1 && stats.pathLengths[INSERT][1] == 1 && stats.pathLengths[INSERT][2] == 1)
+    ASSERT_TRUE(stats.rotations == 1 && stats.doubleRotations == 0 && stats.rebalances == 1 && stats.allocations == 3)
+    ASSERT_TRUE(stats.rotationsPerOperation[0] == 2 && stats.rotationsPerOperation[1] == 1)
+    ASSERT_TRUE(stats.pathLengthPercentile(INSERT, 0.5) == 1 && stats.pathLengthPercentile(INSERT, 0.99) == 2)
+
+    // Inserting 5 and then 4 takes a right-left rotation, and failed calls count too.
+    tree.insert(5);
+    tree.insert(4);
+    tree.insert(2);
+    tree.remove(7);
+    tree.exists(4);
+    stats = tree.stats();
+    ASSERT_TRUE(stats.operations[INSERT] == 6 && stats.operations[REMOVE] == 1 && stats.operations[EXISTS] == 1)
+    ASSERT_TRUE(stats.rotations == 3 && stats.doubleRotations == 1 && stats.rebalances == 2)
+    ASSERT_TRUE(stats.rotationsPerOperation[2] == 1 && stats.allocations == 5 && stats.pathLengths[EXISTS][2] == 1)
+
+    // Removing a value frees its node, and clear() frees the rest.
+    ASSERT_TRUE(tree.remove(4) && tree.stats().deallocations == 1)
+    tree.clear();
+    ASSERT_TRUE(tree.stats().deallocations == 5)
+
+    // A reset starts every count over.
+    tree.resetStats();
+    stats = tree.stats();
+    ASSERT_TRUE(stats.enabled && stats.operations[REMOVE] == 0 && stats.rotations == 0 && stats.comparisons == 0)
+
+    // Every rebalance rotates once, or twice for a double rotation, and an insert
+    // rebalances at most once.
+    mt19937 rng(140);
+    for (int i = 0; i < 10000; ++i) tree.insert(rng() % 100000);
+    stats = tree.stats();
+    ASSERT_TRUE(stats.rotations == stats.rebalances + stats.doubleRotations && stats.allocations == tree.size())
+    ASSERT_TRUE(stats.rotationsPerOperation[0] + stats.rotationsPerOperation[1] + stats.rotationsPerOperation[2] == 10000)
+    unsigned long long calls = 0, visited = 0;
+    for (unsigned int k = 0; k <= TreeStats::MAX_PATH; ++k) {
+        calls += stats.pathLengths[INSERT][k];
+        visited += k * stats.pathLengths[INSERT][k];
+    }
+    ASSERT_TRUE(calls == 10000 && visited == stats.nodesVisited[INSERT])
+    ASSERT_TRUE(stats.pathLengthPercentile(INSERT, 0.99) <= (unsigned int)tree.depth() + 1)
+#else
+    // Without LAB3_TREE_STATS nothing is counted.
+    tree.insert(1);
+    tree.insert(2);
+    tree.insert(3);
+    tree.exists(2);
+    tree.remove(1);
+    stats = tree.stats();
+    ASSERT_TRUE(!stats.enabled && stats.operations[TreeStats::INSERT] == 0 && stats.rotations == 0 && stats.comparisons == 0)
+    ASSERT_TRUE(stats.allocations == 0 && stats.pathLengthPercentile(TreeStats::INSERT, 0.5) == 0)
+#endif
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+
+//======================================================================
+//============================ AVL Map Test ============================
+//======================================================================
+string AVLMapTest::getTestDescription(int test_num) {
+    if (test_num < 1 || test_num > 5) { // check range.
+        return "";
+    }
+    return test_description[test_num-1];
+}
+
+void AVLMapTest::runAllTests() {
+    test_result[0] = test1();
+    test_result[1] = test2();
+    test_result[2] = test3();
+    test_result[3] = test4();
+    test_result[4] = test5();
+}
+
+void AVLMapTest::printReport() {
+    cout << "  AVL MAP TEST RESULTS  \n"
+         << " ^^^^^^^^^^^^^^^^^^^^ \n";
+    for (int idx = 0; idx < 5; ++idx) {
+        cout << test_description[idx] << "\n  " << get_status_str(test_result[idx]) << endl << endl;
+    }
+    cout << endl;
+}
+
+// Test 1: Test find, emplace and erase
+bool AVLMapTest::test1() {
+
+    // Test set up.
+    AVLMap<int, string> map;
+
+    // Emplace some pairs, built in their nodes from the arguments.
+    ASSERT_TRUE(map.emplace(5, "five").second)
+    ASSERT_TRUE(map.emplace(piecewise_construct, forward_as_tuple(3), forward_as_tuple(3, 'x')).second)
+    ASSERT_TRUE(map.emplace(make_pair(8, string("eight"))).second)
+    ASSERT_TRUE(map.size() == 3)
+
+    // Emplacing an existing key keeps the old value.
+    pair<string*, bool> result = map.emplace(5, "FIVE");
+    ASSERT_FALSE(result.second)
+    ASSERT_TRUE(*result.first == "five")
+
+    // Find returns the mapped value, or nullptr if the key is missing.
+    ASSERT_TRUE(map.find(3) != nullptr && *map.find(3) == "xxx")
+    ASSERT_TRUE(map.find(4) == nullptr)
+
+    // Erase removes the key, including the root.
+    ASSERT_TRUE(map.erase(5))
+    ASSERT_FALSE(map.erase(5))
+    ASSERT_TRUE(map.find(5) == nullptr && map.size() == 2)
+    ASSERT_TRUE(*map.find(8) == "eight")
+
+    // The map is not usable as its tree of pairs, whose set operations compare keys only.
+    ASSERT_FALSE((is_convertible<AVLMap<int, string>*, AVLMap<int, string>::Tree*>::value))
+    map.clear();
+    ASSERT_TRUE(map.size() == 0 && map.find(8) == nullptr)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 2: Test try_emplace only uses its arguments for a new key
+bool AVLMapTest::test2() {
+
+    // Test set up: a move-only value type.
+    AVLMap<string, unique_ptr<int> > map;
+
+    // A new key takes ownership of the value.
+    unique_ptr<int> one(new int(1));
+    ASSERT_TRUE(map.try_emplace("one", std::move(one)).second)
+    ASSERT_TRUE(one == nullptr && **map.find("one") == 1)
+
+    // An existing key leaves the argument alone.
+    unique_ptr<int> other(new int(2));
+    pair<unique_ptr<int>*, bool> result = map.try_emplace("one", std::move(other));
+    ASSERT_FALSE(result.second)
+    ASSERT_TRUE(other != nullptr && **result.first == 1)
+
+    // The key itself can be moved in.
+    string key = "two";
+    ASSERT_TRUE(map.try_emplace(std::move(key), std::move(other)).second)
+    ASSERT_TRUE(**map.find("two") == 2 && map.size() == 2)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 3: Test insert_or_assign and operator[]
+bool AVLMapTest::test3() {
+
+    // Test set up.
+    AVLMap<string, int> map;
+
+    // Insert, then assign to the same key.
+    ASSERT_TRUE(map.insert_or_assign("a", 1).second)
+    pair<int*, bool> result = map.insert_or_assign("a", 2);
+    ASSERT_FALSE(result.second)
+    ASSERT_TRUE(*result.first == 2 && *map.find("a") == 2)
+
+    // operator[] inserts a default value for a new key.
+    ASSERT_TRUE(map["b"] == 0 && map.size() == 2)
+    map["b"] += 5;
+    map["c"] = 7;
+    ASSERT_TRUE(*map.find("b") == 5 && *map.find("c") == 7 && map.size() == 3)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 4: Test many keys stay balanced
+bool AVLMapTest::test4() {
+
+    // Test set up.
+    AVLMap<int, int> map;
+
+    // Count how often each key is added, removing another key every third step.
+    for (int i = 0; i < 3000; ++i) {
+        map[(i * 389) % 1009]++;
+        if (i % 3 == 0) map.erase((i * 7) % 1009);
+    }
+
+    // The tree is still balanced, and every stored count is positive.
+    ASSERT_TRUE(checkedHeight(map.getRootNode(), true) != -2)
+    ASSERT_TRUE(map.depth() <= 13)
+    unsigned int found = 0;
+    for (int key = 0; key < 1009; ++key) {
+        if (map.find(key) == nullptr) continue;
+        ASSERT_TRUE(*map.find(key) > 0)
+        found++;
+    }
+    ASSERT_TRUE(found == map.size())
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 5: Test iterating and changing values in key order
+bool AVLMapTest::test5() {
+
+    // Test set up.
+    AVLMap<string, int> map;
+    map["pear"] = 3;
+    map["apple"] = 1;
+    map["fig"] = 2;
+
+    // The pairs come out in key order, and values can be changed through the iterator.
+    string keys;
+    for (AVLMap<string, int>::iterator it = map.begin(); it != map.end(); ++it) {
+        keys += it->first + " ";
+        it->second *= 10;
+    }
+    ASSERT_TRUE(keys == "apple fig pear ")
+    ASSERT_TRUE(*map.find("apple") == 10 && *map.find("fig") == 20 && *map.find("pear") == 30)
+
+    // Bounds and scans take keys, not pairs.
+    ASSERT_TRUE(map.lower_bound("b")->first == "fig" && map.upper_bound("fig")->first == "pear")
+    ASSERT_TRUE(map.equal_range("fig").first->second == 20)
+    int total = 0;
+    map.scan("apple", "pear", [&](const pair<const string, int>& entry) { total += entry.second; });
+    ASSERT_TRUE(total == 30)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+
+//======================================================================
+//====================== Concurrent AVL Tree Test ======================
+//======================================================================
+string ConcurrentAVLTreeTest::getTestDescription(int test_num) {
+    if (test_num < 1 || test_num > 4) { // check range.
+        return "";
+    }
+    return test_description[test_num-1];
+}
+
+void ConcurrentAVLTreeTest::runAllTests() {
+    test_result[0] = test1();
+    test_result[1] = test2();
+    test_result[2] = test3();
+    test_result[3] = test4();
+}
+
+void ConcurrentAVLTreeTest::printReport() {
+    cout << "  CONCURRENT AVL TREE TEST RESULTS  \n"
+         << " ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^ \n";
+    for (int idx = 0; idx < 4; ++idx) {
+        cout << test_description[idx] << "\n  " << get_status_str(test_result[idx]) << endl << endl;
+    }
+    cout << endl;
+}
+
+// Test 1: Test insert, remove and exists on one thread
+bool ConcurrentAVLTreeTest::test1() {
+
+    // Test set up.
+    ConcurrentAVLTree tree;
+    ASSERT_FALSE(tree.exists(5))
+    ASSERT_FALSE(tree.remove(5))
+
+    // Sorted inserts stay balanced.
+    for (int i = 0; i < 1000; ++i) ASSERT_TRUE(tree.insert(i))
+    ASSERT_FALSE(tree.insert(500))
+    ASSERT_TRUE(tree.size() == 1000 && checkedHeight(tree.holder_.right.load()) == 10)
+    for (int i = 0; i < 1000; ++i) ASSERT_TRUE(tree.exists(i))
+    ASSERT_FALSE(tree.exists(-1) || tree.exists(1000))
+
+    // Removing the root leaves it as a routing node, which an insert revives.
+    int root_key = tree.holder_.right.load()->key;
+    ASSERT_TRUE(tree.remove(root_key))
+    ASSERT_FALSE(tree.remove(root_key) || tree.exists(root_key))
+    ASSERT_TRUE(tree.holder_.right.load()->key == root_key && !tree.holder_.right.load()->present)
+    ASSERT_TRUE(tree.size() == 999 && presentKeys(tree.holder_.right.load()).size() == 999)
+    ASSERT_TRUE(tree.insert(root_key) && tree.exists(root_key) && tree.size() == 1000)
+
+    // Once the subtrees under routing nodes empty, the routing nodes go too.
+    for (int i = 0; i < 1000; i += 2) ASSERT_TRUE(tree.remove(i))
+    for (int i = 1; i < 1000; i += 2) ASSERT_TRUE(tree.remove(i))
+    ASSERT_TRUE(tree.size() == 0 && tree.holder_.right.load() == nullptr)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 2: Test random inserts and removes against std::set
+bool ConcurrentAVLTreeTest::test2() {
+
+    // Test set up.
+    ConcurrentAVLTree tree;
+    set<int> expected;
+
+    // Unlinked nodes are freed in batches and their memory reused.
+    unsigned int seed = 140;
+    for (int i = 0; i < 20000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        int key = (seed >> 8) % 500;
+        if (seed & 1) {
+            ASSERT_TRUE(tree.insert(key) == expected.insert(key).second)
+        }
+        else {
+            ASSERT_TRUE(tree.remove(key) == (expected.erase(key) == 1))
+        }
+
+        if (i % 1000 == 0) {
+            ASSERT_TRUE(checkedHeight(tree.holder_.right.load()) != -1)
+            ASSERT_TRUE(presentKeys(tree.holder_.right.load()) == vector<int>(expected.begin(), expected.end()))
+        }
+    }
+    ASSERT_TRUE(tree.size() == expected.size())
+    for (int key = -1; key <= 500; ++key) ASSERT_TRUE(tree.exists(key) == (expected.count(key) == 1))
+
+    // Removing every key leaves no routing node behind, even one a rotation moved down.
+    for (set<int>::iterator it = expected.begin(); it != expected.end(); ++it) ASSERT_TRUE(tree.remove(*it))
+    ASSERT_TRUE(tree.size() == 0 && tree.holder_.right.load() == nullptr)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 3: Test readers and writers running at the same time
+bool ConcurrentAVLTreeTest::test3() {
+
+    // Keys divisible by 4 stay in the tree, and keys 2 mod 4 are never in it, while
+    // each writer inserts and removes its own odd keys.
+    const int KEYS = 2000, WRITERS = 2, READERS = 4, WRITES = 100000;
+    ConcurrentAVLTree tree;
+    for (int i = 0; i < KEYS; ++i) ASSERT_TRUE(tree.insert(4 * i))
+
+    atomic<bool> done(false);
+    atomic<int> errors(0);
+    vector<vector<bool> > written(WRITERS, vector<bool>(KEYS, false));
+    vector<thread> threads;
+
+    for (int r = 0; r < READERS; ++r) {
+        threads.push_back(thread([&, r]() {
+            unsigned int seed = r + 1;
+            while (!done) {
+                seed = seed * 1103515245 + 12345;
+                int i = (seed >> 8) % KEYS;
+                if (!tree.exists(4 * i) || tree.exists(4 * i + 2)) errors++;
+            }
+        }));
+    }
+    for (int w = 0; w < WRITERS; ++w) {
+        threads.push_back(thread([&, w]() {
+            unsigned int seed = 100 + w;
+            for (int op = 0; op < WRITES; ++op) {
+                seed = seed * 1103515245 + 12345;
+                int i = (seed >> 8) % KEYS;
+                int key = 4 * i + 1 + 2 * w;
+                bool changed = written[w][i] ? tree.remove(key) : tree.insert(key);
+                if (!changed) errors++;
+                written[w][i] = !written[w][i];
+            }
+        }));
+    }
+    for (int t = READERS; t < READERS + WRITERS; ++t) threads[t].join();
+    done = true;
+    for (int t = 0; t < READERS; ++t) threads[t].join();
+    ASSERT_TRUE(errors == 0)
+
+    // The tree ends up with exactly the keys the writers left in it.
+    vector<int> expected;
+    for (int i = 0; i < KEYS; ++i) {
+        expected.push_back(4 * i);
+        for (int w = 0; w < WRITERS; ++w) if (written[w][i]) expected.push_back(4 * i + 1 + 2 * w);
+    }
+    ASSERT_TRUE(presentKeys(tree.holder_.right.load()) == expected && tree.size() == expected.size())
+    ASSERT_TRUE(checkedHeight(tree.holder_.right.load()) != -1)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 4: Test removed nodes are freed once no reader can see them
+bool ConcurrentAVLTreeTest::test4() {
+
+    // Test set up.
+    typedef BasicConcurrentAVLTree<int, less<int>, CountingAllocator<int> > CountedTree;
+    atomic<int>& live = CountingAllocator<CountedTree::Node>::live;
+    {
+        CountedTree tree;
+        for (int i = 0; i < 1000; ++i) ASSERT_TRUE(tree.insert(i))
+        ASSERT_TRUE(live == 1000)
+
+        // While this thread is pinned, as a reader in the middle of a search would
+        // be, nothing removed is freed, however far the writers get.
+        {
+            EpochGuard guard;
+            for (int i = 0; i < 1000; ++i) ASSERT_TRUE(tree.remove(i))
+            for (int i = 0; i < 10; ++i) EpochDomain::global().tryAdvance();
+            ASSERT_TRUE(tree.size() == 0 && live == 1000 && tree.retired_.pending() == 1000)
+        }
+
+        // Once it is done, later removes free the old batches.
+        for (int round = 0; round < 10; ++round) {
+            for (int i = 0; i < 1000; ++i) ASSERT_TRUE(tree.insert(i))
+            for (int i = 0; i < 1000; ++i) ASSERT_TRUE(tree.remove(i))
+        }
+        ASSERT_TRUE(tree.retired_.pending() < 1000 && live == (int)tree.retired_.pending())
+
+        // Readers on other threads free nodes as they finish, with writers running.
+        atomic<bool> done(false);
+        vector<thread> readers;
+        for (int r = 0; r < 3; ++r) {
+            readers.push_back(thread([&tree, &done]() {
+                for (int i = 0; !done; i = (i + 7) % 1000) tree.exists(i);
+            }));
+        }
+        for (int round = 0; round < 20; ++round) {
+            for (int i = 0; i < 1000; ++i) tree.insert(i);
+            for (int i = 0; i < 1000; i += 2) tree.remove(i);
+        }
+        done = true;
+        for (thread& reader : readers) reader.join();
+        ASSERT_TRUE(tree.size() == 500 && live == (int)(500 + tree.retired_.pending()))
+    }
+
+    // The tree frees everything when destroyed.
+    ASSERT_TRUE(live == 0)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+
+//======================================================================
+//====================== Persistent AVL Tree Test ======================
+//======================================================================
+string PersistentAVLTreeTest::getTestDescription(int test_num) {
+    if (test_num < 1 || test_num > 3) { // check range.
+        return "";
+    }
+    return test_description[test_num-1];
+}
+
+void PersistentAVLTreeTest::runAllTests() {
+    test_result[0] = test1();
+    test_result[1] = test2();
+    test_result[2] = test3();
+}
+
+void PersistentAVLTreeTest::printReport() {
+    cout << "  PERSISTENT AVL TREE TEST RESULTS  \n"
+         << " ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^ \n";
+    for (int idx = 0; idx < 3; ++idx) {
+        cout << test_description[idx] << "\n  " << get_status_str(test_result[idx]) << endl << endl;
+    }
+    cout << endl;
+}
+
+// Test 1: Test insert, remove and exists against std::set
+bool PersistentAVLTreeTest::test1() {
+
+    // Test set up.
+    PersistentAVLTree tree;
+    set<int> expected;
+
+    // Without snapshots, every node is only linked once and changed in place.
+    unsigned int seed = 140;
+    for (int i = 0; i < 20000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        int key = (seed >> 8) % 500;
+        if (seed & 1) {
+            ASSERT_TRUE(tree.insert(key) == expected.insert(key).second)
+        }
+        else {
+            ASSERT_TRUE(tree.remove(key) == (expected.erase(key) == 1))
+        }
+    }
+    ASSERT_TRUE(tree.size() == expected.size() && checkedHeight(tree.root_) != -1)
+    ASSERT_TRUE(treeValues(tree) == vector<int>(expected.begin(), expected.end()))
+    for (int key = -1; key <= 500; ++key) ASSERT_TRUE(tree.exists(key) == (expected.count(key) == 1))
+
+    set<const PersistentAVLTree::Node*> nodes;
+    collectNodes(tree.root_, nodes);
+    for (const PersistentAVLTree::Node* n : nodes) ASSERT_TRUE(n->refs == 1)
+
+    // Sorted inserts stay balanced.
+    tree.clear();
+    for (int i = 0; i < 1000; ++i) ASSERT_TRUE(tree.insert(i))
+    ASSERT_TRUE(tree.size() == 1000 && checkedHeight(tree.root_) == 10)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 2: Test snapshots share nodes and do not change
+bool PersistentAVLTreeTest::test2() {
+
+    // Test set up.
+    PersistentAVLTree tree;
+    for (int i = 0; i < 1000; ++i) ASSERT_TRUE(tree.insert(2 * i))
+
+    // A snapshot shares the root.
+    PersistentAVLTree snap = tree.snapshot();
+    ASSERT_TRUE(snap.root_ == tree.root_ && tree.root_->refs == 2)
+    vector<int> before = treeValues(snap);
+
+    // One insert copies only the nodes on its path.
+    ASSERT_TRUE(tree.insert(501))
+    set<const PersistentAVLTree::Node*> old_nodes, new_nodes;
+    collectNodes(snap.root_, old_nodes);
+    collectNodes(tree.root_, new_nodes);
+    int copied = 0;
+    for (const PersistentAVLTree::Node* n : new_nodes) copied += old_nodes.count(n) == 0;
+    ASSERT_TRUE(copied <= checkedHeight(tree.root_) + 1)
+    ASSERT_TRUE(treeValues(snap) == before && snap.size() == 1000 && !snap.exists(501))
+    ASSERT_TRUE(tree.size() == 1001 && tree.exists(501))
+
+    // A write searches the tree once, and one that changes nothing copies nothing.
+    {
+        typedef BasicPersistentAVLTree<int, CountingLess, CountingAllocator<int> > CountedTree;
+        atomic<int>& live = CountingAllocator<CountedTree::Node>::live;
+        CountedTree counted;
+        for (int i = 0; i < 1000; ++i) ASSERT_TRUE(counted.insert(2 * i))
+        CountedTree counted_snap = counted.snapshot();
+        int nodes = live;
+        ASSERT_FALSE(counted.insert(500) || counted.remove(501))
+        ASSERT_TRUE(live == nodes && counted.root_ == counted_snap.root_ && counted.root_->refs == 2)
+
+        auto searches = [&counted](int key) {
+            CountingLess::calls = 0;
+            counted.exists(key);
+            int calls = CountingLess::calls;
+            CountingLess::calls = 0;
+            return calls;
+        };
+        for (int key : {501, 1999, 1}) {
+            int calls = searches(key);
+            ASSERT_TRUE(counted.insert(key) && CountingLess::calls == calls)
+            calls = searches(key - 1);
+            ASSERT_TRUE(counted.remove(key - 1) && CountingLess::calls == calls)
+        }
+        ASSERT_TRUE(counted_snap.size() == 1000 && checkedHeight(counted.root_) != -1 && counted.size() == 1000)
+    }
+
+    // Many versions, each changed after the last snapshot, stay as they were.
+    vector<PersistentAVLTree> versions;
+    vector<vector<int> > contents;
+    for (int round = 0; round < 20; ++round) {
+        versions.push_back(tree.snapshot());
+        contents.push_back(treeValues(tree));
+        for (int i = 0; i < 50; ++i) {
+            tree.remove(2 * (round * 50 + i));
+            tree.insert(2 * (round * 50 + i) + 1);
+        }
+        ASSERT_TRUE(checkedHeight(tree.root_) != -1)
+    }
+    for (unsigned int v = 0; v < versions.size(); ++v) {
+        ASSERT_TRUE(treeValues(versions[v]) == contents[v] && versions[v].size() == contents[v].size())
+        ASSERT_TRUE(checkedHeight(versions[v].root_) != -1)
+    }
+
+    // Changing a snapshot leaves the tree alone, and assignment shares like a copy.
+    ASSERT_TRUE(snap.remove(0) && tree.exists(1) && !tree.exists(0))
+    snap = tree;
+    ASSERT_TRUE(snap.root_ == tree.root_ && treeValues(snap) == treeValues(tree))
+    snap = snap;
+    ASSERT_TRUE(snap.size() == tree.size())
+
+    // Dropping every other version leaves only the nodes of the tree.
+    versions.clear();
+    snap.clear();
+    set<const PersistentAVLTree::Node*> nodes;
+    collectNodes(tree.root_, nodes);
+    for (const PersistentAVLTree::Node* n : nodes) ASSERT_TRUE(n->refs == 1)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 3: Test reading snapshots on other threads while the tree changes
+bool PersistentAVLTreeTest::test3() {
+
+    // The writer keeps the invariant that key i is present exactly when key -i - 1 is
+    // not, so every consistent version holds one of each pair.
+    const int KEYS = 1000, READERS = 3, ROUNDS = 200;
+    PersistentAVLTree tree;
+    for (int i = 0; i < KEYS; ++i) tree.insert(i);
+
+    atomic<int> errors(0);
+    vector<PersistentAVLTree> handed_out(READERS * ROUNDS);
+    atomic<int> published(0);
+    vector<thread> readers;
+    for (int r = 0; r < READERS; ++r) {
+        readers.push_back(thread([&, r]() {
+            for (int round = 0; round < ROUNDS; ++round) {
+                int slot = round * READERS + r;
+                while (published.load() <= slot) this_thread::yield();
+
+                // each reader owns its copy of the snapshot, and drops it when done
+                PersistentAVLTree snap = handed_out[slot];
+                handed_out[slot].clear();
+                for (int i = 0; i < KEYS; ++i) {
+                    if (snap.exists(i) == snap.exists(-i - 1)) errors++;
+                }
+                if (snap.size() != (unsigned int)KEYS || treeValues(snap).size() != (unsigned int)KEYS) errors++;
+            }
+        }));
+    }
+
+    unsigned int seed = 140;
+    for (int slot = 0; slot < READERS * ROUNDS; ++slot) {
+        handed_out[slot] = tree.snapshot();
+        published++;
+        for (int step = 0; step < 20; ++step) {
+            seed = seed * 1103515245 + 12345;
+            int i = (seed >> 8) % KEYS;
+            if (tree.remove(i)) tree.insert(-i - 1);
+            else if (tree.remove(-i - 1)) tree.insert(i);
+        }
+    }
+    for (thread& reader : readers) reader.join();
+    ASSERT_TRUE(errors == 0)
+    ASSERT_TRUE(tree.size() == (unsigned int)KEYS && checkedHeight(tree.root_) != -1)
+
+    // Every snapshot was dropped, so the tree is the only version left.
+    set<const PersistentAVLTree::Node*> nodes;
+    collectNodes(tree.root_, nodes);
+    for (const PersistentAVLTree::Node* n : nodes) ASSERT_TRUE(n->refs == 1)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+
+//======================================================================
+//============================ B+ Tree Test ============================
+//======================================================================
+string BPlusTreeTest::getTestDescription(int test_num) {
+    if (test_num < 1 || test_num > 2) { // check range.
+        return "";
+    }
+    return test_description[test_num-1];
+}
+
+void BPlusTreeTest::runAllTests() {
+    test_result[0] = test1();
+    test_result[1] = test2();
+}
+
+void BPlusTreeTest::printReport() {
+    cout << "  B+ TREE TESTING RESULTS  \n"
+         << " ^^^^^^^^^^^^^^^^^^^^^^^ \n";
+    for (int idx = 0; idx < 2; ++idx) {
+        cout << test_description[idx] << "\n  " << get_status_str(test_result[idx]) << endl << endl;
+    }
+    cout << endl;
+}
+
+// Test 1: Test insert, remove, exists and scan against std::set
+bool BPlusTreeTest::test1() {
+
+    // Test set up.
+    BPlusTree tree;
+    set<int> expected;
+    ASSERT_TRUE(!tree.exists(0) && !tree.remove(0) && tree.height() == 0)
+
+    // Enough values for several levels, with inserts and removes mixed so that nodes
+    // split, borrow from either sibling and merge.
+    unsigned int seed = 140;
+    for (int i = 0; i < 200000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        int key = (seed >> 8) % 20000;
+        if ((seed >> 4) % 3 != 0) {
+            ASSERT_TRUE(tree.insert(key) == expected.insert(key).second)
+        }
+        else {
+            ASSERT_TRUE(tree.remove(key) == (expected.erase(key) == 1))
+        }
+        if (i % 20000 == 0) {
+            ASSERT_TRUE(checkedCount(tree.root_, tree.height_) == (int)expected.size())
+        }
+    }
+    ASSERT_TRUE(tree.size() == expected.size() && checkedCount(tree.root_, tree.height_) == (int)expected.size())
+    ASSERT_TRUE(tree.height() >= 3)
+    ASSERT_TRUE(treeValues(tree) == vector<int>(expected.begin(), expected.end()))
+    for (int key = -1; key <= 20000; ++key) ASSERT_TRUE(tree.exists(key) == (expected.count(key) == 1))
+
+    vector<int> range;
+    tree.scan(100, 1000, [&range](int val) { range.push_back(val); });
+    ASSERT_TRUE(range == vector<int>(expected.lower_bound(100), expected.lower_bound(1000)))
+
+    // Removing everything in random order shrinks the tree back to nothing.
+    vector<int> keys(expected.begin(), expected.end());
+    shuffle(keys.begin(), keys.end(), mt19937(140));
+    for (unsigned int i = 0; i < keys.size(); ++i) {
+        ASSERT_TRUE(tree.remove(keys[i]))
+        if (i % 1000 == 0) {
+            ASSERT_TRUE(checkedCount(tree.root_, tree.height_) == (int)(keys.size() - i - 1))
+        }
+    }
+    ASSERT_TRUE(tree.size() == 0 && tree.root_ == nullptr && tree.height() == 0)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 2: Test sorted inserts and removes, and node layout
+bool BPlusTreeTest::test2() {
+
+    // Test set up.
+    BasicBPlusTree<int, std::less<int>, std::allocator<int> > heap_tree;
+    BPlusTree tree;
+
+    // Ascending and descending runs split and refill at either end of the tree.
+    for (int i = 0; i < 50000; ++i) ASSERT_TRUE(tree.insert(i) && heap_tree.insert(50000 - i))
+    ASSERT_TRUE(checkedCount(tree.root_, tree.height_) == 50000 && checkedCount(heap_tree.root_, heap_tree.height_) == 50000)
+    ASSERT_TRUE(!tree.insert(0) && !heap_tree.insert(50000))
+    for (int i = 0; i < 25000; ++i) ASSERT_TRUE(tree.remove(i) && heap_tree.remove(50000 - i))
+    ASSERT_TRUE(checkedCount(tree.root_, tree.height_) == 25000 && checkedCount(heap_tree.root_, heap_tree.height_) == 25000)
+    for (int i = 49999; i >= 25000; --i) ASSERT_TRUE(tree.remove(i))
+    ASSERT_TRUE(tree.size() == 0 && tree.root_ == nullptr)
+
+    // A node of int keys fills four cache lines exactly, and the pool puts it on line boundaries.
+    ASSERT_TRUE(sizeof(BPlusTree::Leaf) == 256 && sizeof(BPlusTree::Inner) == 256)
+    for (int i = 0; i < 10000; ++i) tree.insert(i);
+    vector<const BPlusTree::Leaf*> leaves;
+    ASSERT_TRUE(checkedCount<int>(tree.root_, tree.height_, true, nullptr, nullptr, leaves) == 10000)
+    for (const BPlusTree::Leaf* leaf : leaves) ASSERT_TRUE(reinterpret_cast<uintptr_t>(leaf) % 64 == 0)
+    ASSERT_TRUE(reinterpret_cast<uintptr_t>(tree.root_) % 64 == 0)
+
+    // A lookup visits one node per level, counted only with LAB3_TREE_STATS defined.
+#ifdef LAB3_TREE_STATS
+    ASSERT_TRUE(tree.exists(5000) && tree.nodesVisited() == tree.height())
+#else
+    ASSERT_TRUE(tree.exists(5000) && tree.nodesVisited() == 0)
+#endif
+
+    // Readers can share a const tree.
+    const BPlusTree& shared = tree;
+    atomic<int> missed(0);
+    vector<thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.push_back(thread([&shared, &missed, r]() {
+            for (int i = r; i < 10000; i += 4) if (!shared.exists(i)) missed++;
+        }));
+    }
+    for (thread& reader : readers) reader.join();
+    ASSERT_TRUE(missed == 0)
+    tree.clear();
+    ASSERT_TRUE(tree.size() == 0 && !tree.exists(5000))
+    ASSERT_TRUE(tree.insert(5000) && tree.exists(5000))
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+
+//======================================================================
+//========================== Frozen Tree Test ==========================
+//======================================================================
+string FrozenTreeTest::getTestDescription(int test_num) {
+    if (test_num < 1 || test_num > 2) { // check range.
+        return "";
+    }
+    return test_description[test_num-1];
+}
+
+void FrozenTreeTest::runAllTests() {
+    test_result[0] = test1();
+    test_result[1] = test2();
+}
+
+void FrozenTreeTest::printReport() {
+    cout << "  FROZEN TREE TESTING RESULTS  \n"
+         << " ^^^^^^^^^^^^^^^^^^^^^^^^^^^ \n";
+    for (int idx = 0; idx < 2; ++idx) {
+        cout << test_description[idx] << "\n  " << get_status_str(test_result[idx]) << endl << endl;
+    }
+    cout << endl;
+}
+
+// Test 1: Test lookups in frozen trees of every shape
+bool FrozenTreeTest::test1() {
+
+    // Test set up: an empty tree freezes into an empty array.
+    AVLTree avl;
+    FrozenTree empty = avl.freeze();
+    ASSERT_TRUE(empty.size() == 0 && empty.memoryUsed() == 0 && !empty.exists(0))
+    ASSERT_TRUE(empty.begin() == empty.end() && empty.lower_bound(0) == empty.end())
+
+    // Every size up to 200 covers every way the last level can be partly filled.
+    for (int n = 1; n <= 200; ++n) {
+        avl.insert(2 * n);
+        FrozenTree frozen = avl.freeze();
+        ASSERT_TRUE(frozen.size() == (unsigned int)n && frozen.min() == 2 && frozen.max() == 2 * n)
+        ASSERT_TRUE(vector<int>(frozen.begin(), frozen.end()) == vector<int>(avl.begin(), avl.end()))
+
+        for (int key = 0; key <= 2 * n + 2; ++key) {
+            ASSERT_TRUE(frozen.exists(key) == (key % 2 == 0 && key >= 2 && key <= 2 * n))
+            FrozenTree::iterator it = frozen.lower_bound(key);
+            AVLTree::iterator expected = avl.lower_bound(key);
+            ASSERT_TRUE((it == frozen.end()) == (expected == avl.end()))
+            if (it != frozen.end()) {
+                ASSERT_TRUE(*it == *expected)
+            }
+        }
+    }
+
+    // Extreme keys compare like any other, and a moved tree hands over its array.
+    int extremes[] = {INT_MIN, -1, 0, 1, INT_MAX};
+    FrozenTree frozen(extremes, extremes + 5);
+    ASSERT_TRUE(frozen.exists(INT_MIN) && frozen.exists(INT_MAX) && !frozen.exists(2) && !frozen.exists(-2))
+    ASSERT_TRUE(*frozen.lower_bound(INT_MIN + 1) == -1 && frozen.lower_bound(2) != frozen.end())
+    ASSERT_TRUE(*frozen.lower_bound(2) == INT_MAX)
+    FrozenTree moved(std::move(frozen));
+    ASSERT_TRUE(frozen.size() == 0 && !frozen.exists(0) && moved.size() == 5 && moved.exists(0))
+    frozen = std::move(moved);
+    ASSERT_TRUE(frozen.size() == 5 && frozen.exists(INT_MIN) && moved.size() == 0)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 2: Test range scans, layout and memory of a large frozen tree
+bool FrozenTreeTest::test2() {
+
+    // Test set up.
+    AVLTree avl;
+    set<int> expected;
+    mt19937 rng(140);
+    for (int i = 0; i < 100000; ++i) {
+        int key = rng() % 1000000;
+        avl.insert(key);
+        expected.insert(key);
+    }
+    FrozenTree frozen = avl.freeze();
+    ASSERT_TRUE(frozen.size() == expected.size() && avl.size() == expected.size())
+
+    // The array holds the levels of a complete tree, so each key is between its subtrees.
+    for (size_t k = 2; k <= frozen.size_; ++k) {
+        ASSERT_TRUE(k % 2 == 0 ? frozen.values_[k] < frozen.values_[k / 2] : frozen.values_[k / 2] < frozen.values_[k])
+    }
+    ASSERT_TRUE(reinterpret_cast<uintptr_t>(frozen.values_) % 64 == 0)
+    ASSERT_TRUE(frozen.memoryUsed() <= sizeof(int) * (frozen.size() + 1) + 64)
+
+    for (int round = 0; round < 1000; ++round) {
+        int lo = rng() % 1000000;
+        int hi = lo + rng() % 5000;
+        vector<int> range;
+        frozen.scan(lo, hi, [&range](int val) { range.push_back(val); });
+        ASSERT_TRUE(range == vector<int>(expected.lower_bound(lo), expected.lower_bound(hi)))
+    }
+    ASSERT_TRUE(treeValues(frozen) == vector<int>(expected.begin(), expected.end()))
+    for (int key = 0; key < 1000000; key += 3) ASSERT_TRUE(frozen.exists(key) == (expected.count(key) == 1))
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+
+//======================================================================
+//======================= COMPACT AVL TREE TEST ========================
+//======================================================================
+string CompactAVLTreeTest::getTestDescription(int test_num) {
+    if (test_num < 1 || test_num > 2) { // check range.
+        return "";
+    }
+    return test_description[test_num-1];
+}
+
+void CompactAVLTreeTest::runAllTests() {
+    test_result[0] = test1();
+    test_result[1] = test2();
+}
+
+void CompactAVLTreeTest::printReport() {
+    cout << "  COMPACT AVL TREE TEST RESULTS  \n"
+         << " ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^ \n";
+    for (int idx = 0; idx < 2; ++idx) {
+        cout << test_description[idx] << "\n  " << get_status_str(test_result[idx]) << endl << endl;
+    }
+    cout << endl;
+}
+
+int CompactAVLTreeTest::checkedHeight(const CompactAVLTree& tree, uint32_t n, const int* lo, const int* hi,
+                                      unsigned int& count) {
+    if (n == 0) {
+        return 0;
+    }
+    const int& val = tree.at(n).val;
+    if ((lo != nullptr && val < *lo) || (hi != nullptr && !(val < *hi))) {
+        return -1;
+    }
+    count++;
+
+    int left = checkedHeight(tree, tree.at(n).left, lo, &val, count);
+    int right = checkedHeight(tree, tree.right(n), &val, hi, count);
+    if (left == -1 || right == -1 || right - left != tree.balance(n)) {
+        return -1;
+    }
+    return max(left, right) + 1;
+}
+
+// Test 1: Test random operations on a compact AVL tree against std::set
+bool CompactAVLTreeTest::test1() {
+
+    // Test set up.
+    CompactAVLTree tree;
+    set<int> expected;
+    mt19937 rng(140);
+    ASSERT_TRUE(sizeof(CompactAVLTree::Node) == 12)
+    ASSERT_TRUE(!tree.exists(0) && !tree.remove(0) && tree.size() == 0 && tree.memoryUsed() == 0)
+
+    for (int i = 0; i < 200000; ++i) {
+        int key = rng() % 20000;
+        switch (rng() % 3) {
+        case 0:
+            ASSERT_TRUE(tree.insert(key) == expected.insert(key).second)
+            break;
+        case 1:
+            ASSERT_TRUE(tree.remove(key) == (expected.erase(key) == 1))
+            break;
+        default:
+            ASSERT_TRUE(tree.exists(key) == (expected.count(key) == 1))
+        }
+
+        // Every so often the whole tree is checked, its balances included.
+        if (i % 5000 == 0) {
+            unsigned int count = 0;
+            ASSERT_TRUE(checkedHeight(tree, tree.root_, nullptr, nullptr, count) >= 0 && count == expected.size())
+        }
+    }
+    ASSERT_TRUE(tree.size() == expected.size())
+    ASSERT_TRUE(treeValues(tree) == vector<int>(expected.begin(), expected.end()))
+
+    for (int round = 0; round < 1000; ++round) {
+        int lo = rng() % 20000;
+        int hi = lo + rng() % 500;
+        vector<int> range;
+        tree.scan(lo, hi, [&range](int val) { range.push_back(val); });
+        ASSERT_TRUE(range == vector<int>(expected.lower_bound(lo), expected.lower_bound(hi)))
+    }
+
+    // Extreme keys compare like any other.
+    ASSERT_TRUE(tree.insert(INT_MIN) && tree.insert(INT_MAX) && tree.exists(INT_MIN) && tree.exists(INT_MAX))
+    ASSERT_TRUE(tree.remove(INT_MIN) && tree.remove(INT_MAX) && !tree.exists(INT_MIN))
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+// Test 2: Test sorted inserts, slot reuse and memory of compact AVL trees
+bool CompactAVLTreeTest::test2() {
+
+    // Test set up: sorted inserts keep the tree as balanced as any other.
+    const int n = 300000;
+    CompactAVLTree tree;
+    for (int i = 0; i < n; ++i) ASSERT_TRUE(tree.insert(i))
+    unsigned int count = 0;
+    int height = checkedHeight(tree, tree.root_, nullptr, nullptr, count);
+    ASSERT_TRUE(height >= 19 && height <= 27 && count == (unsigned int)n)
+
+    // A lookup visits at most one node per level, counted only with LAB3_TREE_STATS defined.
+    ASSERT_TRUE(!tree.exists(n) && tree.exists(n - 1))
+#ifdef LAB3_TREE_STATS
+    ASSERT_TRUE(tree.nodesVisited() >= 1 && tree.nodesVisited() <= (unsigned int)height)
+#else
+    ASSERT_TRUE(tree.nodesVisited() == 0)
+#endif
+
+    // Readers can share a const tree.
+    const CompactAVLTree& shared = tree;
+    atomic<int> missed(0);
+    vector<thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.push_back(thread([&shared, &missed, n, r]() {
+            for (int i = r; i < n; i += 4 * 97) if (!shared.exists(i)) missed++;
+        }));
+    }
+    for (thread& reader : readers) reader.join();
+    ASSERT_TRUE(missed == 0)
+
+    // The arena holds the nodes with at most one block of slots to spare.
+    size_t memory = tree.memoryUsed();
+    ASSERT_TRUE(memory >= 12 * (size_t)n && memory <= 12 * ((size_t)n + 65536) + 1024)
+
+    // Removed nodes are reused before the arena grows again.
+    for (int i = n - 1; i >= 0; i -= 2) ASSERT_TRUE(tree.remove(i))
+    ASSERT_TRUE(tree.size() == n / 2 && tree.memoryUsed() == memory)
+    for (int i = n + 1; i < 2 * n; i += 2) ASSERT_TRUE(tree.insert(i))
+    ASSERT_TRUE(tree.size() == n && tree.memoryUsed() == memory)
+    count = 0;
+    ASSERT_TRUE(checkedHeight(tree, tree.root_, nullptr, nullptr, count) >= 0 && count == (unsigned int)n)
+
+    // Removing every value leaves an empty tree, and clear() releases the arena.
+    for (int i = 0; i < n; i += 2) ASSERT_TRUE(tree.remove(i))
+    for (int i = n + 1; i < 2 * n; i += 2) ASSERT_TRUE(tree.remove(i))
+    ASSERT_TRUE(tree.size() == 0 && tree.root_ == 0 && !tree.exists(0))
+    tree.clear();
+    ASSERT_TRUE(tree.memoryUsed() == 0 && tree.insert(7) && tree.exists(7) && tree.size() == 1)
+
+    // A small tree only takes a small first block, which keeps its indices as it doubles.
+    ASSERT_TRUE(tree.memoryUsed() <= 16 * sizeof(CompactAVLTree::Node) + 64)
+    for (int i = 0; i < 100; ++i) tree.insert(i);
+    ASSERT_TRUE(tree.size() == 100 && tree.exists(7) && tree.exists(99))
+    ASSERT_TRUE(tree.memoryUsed() <= 128 * sizeof(CompactAVLTree::Node) + 64)
+
+    // Return true to signal all tests passed.
+    return true;
+}
+
+
+//======================================================================
+//=========================== SNAPSHOT TEST ============================
+//======================================================================
+string SnapshotTest::getTestDescription(int test_num) {
+    if (test_num < 1 || test_num > 2) { // check range.
+        return "";
+    }
+    return test_description[test_num-1];
+}
+
+void SnapshotTest::runAllTests() {
+    test_result[0] = test1();
+    test_result[1] = test2();
+}
+
+void SnapshotTest::printReport() {
+    cout << "  SNAPSHOT TESTING RESULTS  \n"
+         << " ^^^^^^^^^^^^^^^^^^^^^^^^ \n";
+    for (int idx = 0; idx < 2; ++idx) {
+        cout << test_description[idx] << "\n  " << get_status_str(test_result[idx]) << endl << endl;
+    }
+    cout << endl;
+}
+
+// Test 1: Test saving and loading trees, and refusing damaged snapshots
+bool SnapshotTest::test1() {
+
+    // Test set up.
+    string path = "/tmp/mte140-L3-" + to_string(getpid()) + ".snapshot";
+    AVLTree tree;
+    set<int> expected;
+    mt19937 rng(140);
+    for (int i = 0; i < 100000; ++i) {
+        int key = rng() % 1000000 - 500000;
+        tree.insert(key);
+        expected.insert(key);
+    }
+
+    // A loaded tree holds the same values, perfectly balanced, and no temporary file is left.
+    ASSERT_TRUE(tree.save(path))
+    ASSERT_TRUE(!ifstream(path + ".tmp").good())
+    AVLTree loaded;
+    loaded.insert(7);
+    ASSERT_TRUE(loaded.load(path) && loaded.size() == expected.size())
+    ASSERT_TRUE(vector<int>(loaded.begin(), loaded.end()) == vector<int>(expected.begin(), expected.end()))
+    ASSERT_TRUE(loaded.depth() == 16 && loaded.exists(*expected.begin()) && !loaded.exists(1000000))
+    ASSERT_TRUE(loaded.insert(1000000) && loaded.remove(*expected.rbegin()) && loaded.size() == expected.size())
+
+    // The file is the header and then the values, in order.
+    ifstream in(path, ios::binary);
+    SnapshotHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    vector<int> values(expected.size());
+    in.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(int));
+    ASSERT_TRUE(in.good() && in.peek() == EOF && header.count == expected.size() && header.keySize == sizeof(int))
+    ASSERT_TRUE(header.version == SNAPSHOT_VERSION && values == vector<int>(expected.begin(), expected.end()))
+    in.close();
+
+    // An empty tree saves and loads too.
+    AVLTree empty;
+    ASSERT_TRUE(empty.save(path) && loaded.load(path) && loaded.size() == 0 && loaded.begin() == loaded.end())
+
+    // A missing file, a flipped bit, a cut off file, another key size and another order are all refused.
+    ASSERT_TRUE(!loaded.load(path + ".missing") && loaded.size() == 0)
+    ASSERT_TRUE(tree.save(path))
+    {
+        fstream file(path, ios::in | ios::out | ios::binary);
+        file.seekp(sizeof(SnapshotHeader) + 4 * 5000 + 1);
+        file.put(0x40);
+    }
+    ASSERT_TRUE(!loaded.load(path) && loaded.size() == 0 && loaded.begin() == loaded.end())
+    ASSERT_TRUE(tree.save(path) && truncate(path.c_str(), sizeof(SnapshotHeader) + 4 * 1000) == 0)
+    ASSERT_TRUE(!loaded.load(path) && loaded.size() == 0)
+
+    BasicAVLTree<long long> wide;
+    wide.insert(1);
+    ASSERT_TRUE(wide.save(path) && !loaded.load(path))
+    BasicAVLTree<int, greater<int> > reversed;
+    for (int i = 0; i < 10; ++i) reversed.insert(i);
+    ASSERT_TRUE(reversed.save(path) && !loaded.load(path) && loaded.size() == 0)
+    ASSERT_TRUE(reversed.load(path) && reversed.size() == 10 && *reversed.begin() == 9)
+
+    // A tree that cannot be written leaves the target alone.
+    ASSERT_TRUE(!tree.save("/nonexistent-directory/tree.snapshot"))
+
+    // Return true to signal all tests passed.
+    remove(path.c_str());
+    return true;
+}
+
+// Test 2: Test lookups and range scans on a mapped snapshot
+bool SnapshotTest::test2() {
+
+    // Test set up.
+    string path = "/tmp/mte140-L3-" + to_string(getpid()) + ".mapped";
+    AVLTree tree;
+    set<int> expected;
+    mt19937 rng(141);
+    for (int i = 0; i < 100000; ++i) {
+        int key = rng() % 1000000;
+        tree.insert(key);
+        expected.insert(key);
+    }
+    ASSERT_TRUE(tree.save(path))
+
+    // The values are searched in place in the mapping, aligned for the key type.
+    MappedSnapshot mapped;
+    ASSERT_TRUE(!mapped.isOpen() && mapped.open(path) && mapped.isOpen() && mapped.size() == expected.size())
+    ASSERT_TRUE(reinterpret_cast<uintptr_t>(mapped.values_) % 64 == 0)
+    ASSERT_TRUE(mapped.min() == *expected.begin() && mapped.max() == *expected.rbegin())
+    ASSERT_TRUE(vector<int>(mapped.begin(), mapped.end()) == vector<int>(expected.begin(), expected.end()))
+    for (int key = 0; key < 1000000; key += 7) ASSERT_TRUE(mapped.exists(key) == (expected.count(key) == 1))
+
+    for (int round = 0; round < 1000; ++round) {
+        int lo = rng() % 1000000;
+        int hi = lo + rng() % 5000;
+        vector<int> range;
+        mapped.scan(lo, hi, [&range](int val) { range.push_back(val); });
+        ASSERT_TRUE(range == vector<int>(expected.lower_bound(lo), expected.lower_bound(hi)))
+        MappedSnapshot::iterator it = mapped.lower_bound(lo);
+        ASSERT_TRUE(it == mapped.end() ? expected.lower_bound(lo) == expected.end() : *it == *expected.lower_bound(lo))
+    }
+
+    // A damaged file is only noticed when verifying, and a file that is not a snapshot never maps.
+    {
+        fstream file(path, ios::in | ios::out | ios::binary);
+        file.seekp(sizeof(SnapshotHeader) + 4 * 777);
+        file.put(0x7f);
+    }
+    ASSERT_TRUE(!mapped.open(path) && !mapped.isOpen() && mapped.size() == 0)
+    ASSERT_TRUE(mapped.open(path, false) && mapped.size() == expected.size())
+    mapped.close();
+    ASSERT_TRUE(!mapped.isOpen() && mapped.begin() == mapped.end())
+    {
+        ofstream file(path, ios::binary);
+        file << "not a snapshot";
+    }
+    ASSERT_TRUE(!mapped.open(path, false) && !mapped.open(path + ".missing"))
+
+    // Return true to signal all tests passed.
+    remove(path.c_str());
+    return true;
+}
+
+
+//======================================================================
+//======================= DURABLE AVL TREE TESTS =======================
+//======================================================================
+string DurableAVLTreeTest::getTestDescription(int test_num) {
+    if (test_num < 1 || test_num > 2) { // check range.
+        return "";
+    }
+    return test_description[test_num-1];
+}
+
+void DurableAVLTreeTest::runAllTests() {
+    test_result[0] = test1();
+    test_result[1] = test2();
+}
+
+void DurableAVLTreeTest::printReport() {
+    cout << "  DURABLE AVL TREE TESTING RESULTS  \n"
+         << " ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^ \n";
+    for (int idx = 0; idx < 2; ++idx) {
+        cout << test_description[idx] << "\n  " << get_status_str(test_result[idx]) << endl << endl;
+    }
+    cout << endl;
+}
+
+// Test 1: Test that changes survive reopening and a torn log
+bool DurableAVLTreeTest::test1() {
+
+    // Test set up.
+    string path = "/tmp/mte140-L3-" + to_string(getpid()) + ".durable";
+    DurabilityOptions options;
+    options.groupSize = 64;
+    options.compactBytes = 0;
+    DurableAVLTree tree;
+    set<int> expected;
+    mt19937 rng(142);
+
+    // Threads that change the tree at once are all logged, and sync() waits for their groups.
+    ASSERT_TRUE(!tree.isOpen() && tree.open(path, options) && tree.isOpen() && tree.size() == 0)
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.push_back(thread([&tree, t]() {
+            for (int i = 0; i < 5000; ++i) tree.insert(i * 4 + t);
+            for (int i = 0; i < 5000; i += 3) tree.remove(i * 4 + t);
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); ++t) threads[t].join();
+    for (int i = 0; i < 20000; ++i) {
+        if ((i / 4) % 3 != 0) expected.insert(i);
+    }
+    ASSERT_TRUE(tree.sync() && tree.size() == expected.size())
+    ASSERT_TRUE(!tree.insert(4) && !tree.remove(0))
+    tree.close();
+    ASSERT_TRUE(!tree.isOpen() && tree.size() == 0 && !ifstream(path + ".snapshot").good())
+
+    // Reopening replays the log, and keeps appending to it.
+    ASSERT_TRUE(tree.open(path, options) && tree.size() == expected.size())
+    for (int i = 0; i < 20000; ++i) ASSERT_TRUE(tree.exists(i) == (expected.count(i) == 1))
+    for (int i = 0; i < 1000; ++i) {
+        int key = rng() % 30000;
+        if (rng() % 2 == 0) {
+            ASSERT_TRUE(tree.insert(key) == expected.insert(key).second)
+        } else {
+            ASSERT_TRUE(tree.remove(key) == (expected.erase(key) == 1))
+        }
+    }
+    ASSERT_TRUE(tree.sync())
+    uint64_t bytes = tree.logBytes();
+    tree.close();
+    ASSERT_TRUE(tree.open(path, options) && tree.size() == expected.size() && tree.logBytes() == bytes)
+    tree.close();
+
+    // A group cut short, or one that fails its checksum, is dropped with everything after it.
+    ASSERT_TRUE(tree.open(path, options) && tree.insert(-1) && tree.insert(-2) && tree.sync())
+    tree.close();
+    ASSERT_TRUE(truncate((path + ".wal").c_str(), bytes + 20) == 0)
+    ASSERT_TRUE(tree.open(path, options) && tree.size() == expected.size() && !tree.exists(-1))
+    ASSERT_TRUE(tree.logBytes() == bytes && tree.insert(-3) && tree.sync())
+    tree.close();
+    {
+        fstream file(path + ".wal", ios::in | ios::out | ios::binary);
+        file.seekp(bytes + 16);
+        file.put(9);
+    }
+    ASSERT_TRUE(tree.open(path, options) && tree.size() == expected.size() && !tree.exists(-3))
+    for (int i = -10; i < 30000; ++i) ASSERT_TRUE(tree.exists(i) == (expected.count(i) == 1))
+    tree.close();
+
+    // A log of another key type is refused.
+    BasicDurableAVLTree<long long> wide;
+    ASSERT_TRUE(!wide.open(path) && !wide.isOpen() && wide.size() == 0)
+
+    // Return true to signal all tests passed.
+    remove((path + ".wal").c_str());
+    return true;
+}
+
+// Test 2: Test folding the log into the snapshot
+bool DurableAVLTreeTest::test2() {
+
+    // Test set up.
+    string path = "/tmp/mte140-L3-" + to_string(getpid()) + ".compacted";
+    DurabilityOptions options;
+    options.groupDelayMicros = 100;
+    options.compactBytes = 0;
+    DurableAVLTree tree;
+    set<int> expected;
+    for (int i = 0; i < 10000; ++i) expected.insert(i * 2);
+
+    // compact() leaves a snapshot of the tree and an empty log.
+    ASSERT_TRUE(tree.open(path, options))
+    for (int i = 0; i < 10000; ++i) tree.insert(i * 2);
+    ASSERT_TRUE(tree.compact() && tree.logBytes() == 32 && !ifstream(path + ".wal.old").good())
+    AVLTree snapshot;
+    ASSERT_TRUE(snapshot.load(path + ".snapshot"))
+    ASSERT_TRUE(vector<int>(snapshot.begin(), snapshot.end()) == vector<int>(expected.begin(), expected.end()))
+
+    // A second one merges the changes since into that snapshot.
+    for (int i = 0; i < 5000; ++i) {
+        tree.remove(i * 4);
+        expected.erase(i * 4);
+        tree.insert(i * 4);
+        tree.remove(i * 4);
+        tree.insert(i * 4 + 1);
+        expected.insert(i * 4 + 1);
+    }
+    ASSERT_TRUE(tree.compact() && snapshot.load(path + ".snapshot"))
+    ASSERT_TRUE(vector<int>(snapshot.begin(), snapshot.end()) == vector<int>(expected.begin(), expected.end()))
+    tree.close();
+
+    // A log that grows too large is compacted in the background, while changes go on.
+    options.compactBytes = 4096;
+    ASSERT_TRUE(tree.open(path, options) && tree.size() == expected.size())
+    for (int i = 0; i < 20000; ++i) {
+        tree.insert(-i);
+        expected.insert(-i);
+    }
+    ASSERT_TRUE(tree.sync())
+    tree.close();
+    ASSERT_TRUE(snapshot.load(path + ".snapshot") && snapshot.size() > 20000 && !ifstream(path + ".wal.old").good())
+    ASSERT_TRUE(tree.open(path, options) && tree.size() == expected.size())
+    tree.close();
+
+    // A compaction cut short leaves the old log, which opening replays and compacts again.
+    options.compactBytes = 0;
+    ASSERT_TRUE(tree.open(path, options) && tree.remove(-7) && tree.insert(-100000) && tree.sync())
+    expected.erase(-7);
+    expected.insert(-100000);
+    tree.close();
+    ASSERT_TRUE(rename((path + ".wal").c_str(), (path + ".wal.old").c_str()) == 0)
+    ASSERT_TRUE(tree.open(path, options) && tree.size() == expected.size() && tree.insert(-100001))
+    expected.insert(-100001);
+    tree.close();
+    ASSERT_TRUE(!ifstream(path + ".wal.old").good() && snapshot.load(path + ".snapshot") && snapshot.exists(-100000))
+    ASSERT_TRUE(snapshot.size() == expected.size() - 1 && tree.open(path, options))
+    for (set<int>::iterator it = expected.begin(); it != expected.end(); ++it) ASSERT_TRUE(tree.exists(*it))
+    ASSERT_TRUE(tree.size() == expected.size() && !tree.exists(-7))
+
+    // A crash before the new log's header reaches disk leaves an empty log, which opening creates again.
+    ASSERT_TRUE(tree.insert(-100002) && tree.sync())
+    expected.insert(-100002);
+    tree.close();
+    ASSERT_TRUE(rename((path + ".wal").c_str(), (path + ".wal.old").c_str()) == 0)
+    ASSERT_TRUE(ofstream(path + ".wal", ios::binary).good())
+    ASSERT_TRUE(tree.open(path, options) && tree.size() == expected.size() && tree.exists(-100002))
+    tree.close();
+    ASSERT_TRUE(!ifstream(path + ".wal.old").good() && !ifstream(path + ".wal.tmp").good() && tree.open(path, options))
+    ASSERT_TRUE(tree.size() == expected.size() && tree.exists(-100002))
+
+    // A compaction that fails keeps its old log, which later ones fold before starting another log.
+    ASSERT_TRUE(mkdir((path + ".snapshot.tmp").c_str(), 0700) == 0)
+    ASSERT_TRUE(tree.insert(-200000) && !tree.compact() && ifstream(path + ".wal.old").good())
+    ASSERT_TRUE(tree.insert(-200001) && !tree.compact() && tree.sync() && ifstream(path + ".wal.old").good())
+    ASSERT_TRUE(rmdir((path + ".snapshot.tmp").c_str()) == 0 && tree.compact())
+    expected.insert(-200000);
+    expected.insert(-200001);
+    ASSERT_TRUE(!ifstream(path + ".wal.old").good() && snapshot.load(path + ".snapshot"))
+    ASSERT_TRUE(vector<int>(snapshot.begin(), snapshot.end()) == vector<int>(expected.begin(), expected.end()))
+    tree.close();
+
+    // A damaged snapshot is refused rather than replayed on.
+    {
+        fstream file(path + ".snapshot", ios::in | ios::out | ios::binary);
+        file.seekp(sizeof(SnapshotHeader) + 40);
+        file.put(0x55);
+    }
+    ASSERT_TRUE(!tree.open(path, options) && tree.size() == 0)
+
+    // Return true to signal all tests passed.
+    remove((path + ".snapshot").c_str());
+    remove((path + ".wal").c_str());
+    return true;
+}
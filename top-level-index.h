@@ -0,0 +1,212 @@
+#ifndef LAB3_TOP_LEVEL_INDEX_H
+#define LAB3_TOP_LEVEL_INDEX_H
+
+#include <climits>
+#include <functional>
+#include <vector>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define LAB3_X86_SIMD 1
+#endif
+
+// Counts how many keys of an array are less than a key, several keys per
+// instruction and without a branch that depends on the keys. Uses AVX2 when the
+// CPU has it, SSE2 on every other x86-64 CPU, and plain C++ elsewhere.
+class KeyCounter {
+public:
+    // Returns how many of the count ints at keys are less than key. count must be
+    // a multiple of 8.
+    static unsigned int countLess(const int* keys, unsigned int count, int key);
+
+private:
+    friend class AVLTreeTest;
+
+    typedef unsigned int (*Function)(const int* keys, unsigned int count, int key);
+
+    // Returns the fastest version the CPU can run.
+    static Function select();
+
+    static unsigned int countScalar(const int* keys, unsigned int count, int key);
+#ifdef LAB3_X86_SIMD
+    static unsigned int countSse2(const int* keys, unsigned int count, int key);
+    __attribute__((target("avx2"))) static unsigned int countAvx2(const int* keys, unsigned int count, int key);
+#endif
+};
+
+// Lookup index over the top LEVELS levels of a binary search tree, which every
+// lookup passes through. Those levels are in order as a flat array of keys, with
+// the subtree hanging between each two neighbours below them, so a lookup can
+// count the keys less than its key at once instead of following one pointer and
+// taking one hard to predict branch per level. The count is the index of the
+// subtree to go on in, or of the equal key.
+//
+// The tree calls touched() with the depth of every link it changes, and a
+// TopLevelIndexRefresh rebuilds the index as the change ends if one of those was
+// in it; a change to the whole tree calls rebuild() when it is done. Lookups only
+// read the index, so readers sharing a const tree never write to it. Changes
+// below the indexed levels leave it alone, so in a large tree it is rarely
+// rebuilt.
+//
+// Only ints ordered by std::less have an index; for every other key this class
+// is empty and lookups walk the tree from the root as before.
+template <class Key, class Compare, class Node>
+class TopLevelIndex {
+public:
+    void touched(unsigned int depth) {}
+
+    // Returns whether the index of a tree of size nodes has to be rebuilt.
+    bool stale(unsigned int size) const { return false; }
+
+    // Rebuilds the index from the tree root of size nodes, always or only if it is stale.
+    void rebuild(Node* root, unsigned int size) {}
+    void refresh(Node* root, unsigned int size) {}
+
+    // Returns the node to go on searching for key from, or sets found if the
+    // index holds key.
+    template <class K>
+    Node* find(const K& key, Node* root, bool& found) const { return root; }
+};
+
+template <class Node>
+class TopLevelIndex<int, std::less<int>, Node> {
+public:
+    // Number of levels in the index, so at most 127 keys in 16 blocks of 8.
+    static const unsigned int LEVELS = 7;
+
+    // Smaller trees have no index. Their top levels change on about 1 in 100
+    // writes below 10k nodes, against 1 in 1000 at 100k, and rebuilding that often
+    // costs more than the index saves the lookups, which walk few levels anyway.
+    static const unsigned int MIN_SIZE = 1u << 16;
+
+    TopLevelIndex() : count_(0), stale_(true) {}
+
+    // Marks the index stale if a link at depth depth (0 for the root) is in it.
+    void touched(unsigned int depth) {
+        if (depth <= LEVELS) stale_ = true;
+    }
+
+    bool stale(unsigned int size) const { return stale_ || (count_ == 0 && size >= MIN_SIZE); }
+
+    void rebuild(Node* root, unsigned int size);
+    void refresh(Node* root, unsigned int size) {
+        if (stale(size)) rebuild(root, size);
+    }
+
+    Node* find(int key, Node* root, bool& found) const;
+
+private:
+    // Adds the keys of the top levels of the subtree n, at depth depth, and the
+    // subtrees below them, in order.
+    void collect(Node* n, unsigned int depth);
+
+    std::vector<int> keys_;       // Keys of the top levels in order, padded with INT_MAX to a multiple of 8.
+    std::vector<Node*> subtrees_; // Subtree before each key, and the one after the last.
+    unsigned int count_;          // Number of keys, or 0 if there is no index.
+    bool stale_;                  // Whether the tree changed in the top levels since the last rebuild.
+};
+
+template <class Node>
+void TopLevelIndex<int, std::less<int>, Node>::rebuild(Node* root, unsigned int size) {
+    keys_.clear();
+    subtrees_.clear();
+    count_ = 0;
+    stale_ = false;
+    if (size < MIN_SIZE) return;
+
+    collect(root, 0);
+    count_ = keys_.size();
+    while (keys_.size() % 8 != 0) keys_.push_back(INT_MAX);
+}
+
+template <class Node>
+void TopLevelIndex<int, std::less<int>, Node>::collect(Node* n, unsigned int depth) {
+    if (n == nullptr || depth == LEVELS) {
+        subtrees_.push_back(n);
+        return;
+    }
+    collect(n->left, depth + 1);
+    keys_.push_back(n->val);
+    collect(n->right, depth + 1);
+}
+
+template <class Node>
+Node* TopLevelIndex<int, std::less<int>, Node>::find(int key, Node* root, bool& found) const {
+    if (count_ == 0 || stale_) return root;
+
+    // the padding is never less than key, so only real keys are counted
+    unsigned int less = KeyCounter::countLess(keys_.data(), keys_.size(), key);
+    found = less < count_ && keys_[less] == key;
+    return subtrees_[less];
+}
+
+// Refreshes the index of a tree as a change to the tree ends, on any return.
+template <class Index, class Node>
+class TopLevelIndexRefresh {
+public:
+    TopLevelIndexRefresh(Index& index, Node* const& root, const unsigned int& size)
+        : index_(index), root_(root), size_(size) {}
+    ~TopLevelIndexRefresh() { index_.refresh(root_, size_); }
+
+private:
+    Index& index_;
+    Node* const& root_;
+    const unsigned int& size_;
+
+    // Sets copy constructor and assignment operator to private.
+    TopLevelIndexRefresh(const TopLevelIndexRefresh& other);
+    TopLevelIndexRefresh& operator=(const TopLevelIndexRefresh& other);
+};
+
+inline unsigned int KeyCounter::countLess(const int* keys, unsigned int count, int key) {
+    static const Function function = select();
+    return function(keys, count, key);
+}
+
+inline KeyCounter::Function KeyCounter::select() {
+#ifdef LAB3_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) return &countAvx2;
+    return &countSse2;
+#else
+    return &countScalar;
+#endif
+}
+
+inline unsigned int KeyCounter::countScalar(const int* keys, unsigned int count, int key) {
+    unsigned int less = 0;
+    for (unsigned int i = 0; i < count; ++i) less += keys[i] < key;
+    return less;
+}
+
+#ifdef LAB3_X86_SIMD
+
+// A lane that compares true is -1, so subtracting the comparisons counts them
+// in each lane, and the lanes are added up at the end.
+inline unsigned int KeyCounter::countSse2(const int* keys, unsigned int count, int key) {
+    __m128i wanted = _mm_set1_epi32(key);
+    __m128i less = _mm_setzero_si128();
+    for (unsigned int i = 0; i < count; i += 4) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        less = _mm_sub_epi32(less, _mm_cmplt_epi32(block, wanted));
+    }
+    less = _mm_add_epi32(less, _mm_shuffle_epi32(less, _MM_SHUFFLE(1, 0, 3, 2)));
+    less = _mm_add_epi32(less, _mm_shuffle_epi32(less, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(less);
+}
+
+__attribute__((target("avx2"))) inline unsigned int KeyCounter::countAvx2(const int* keys, unsigned int count, int key) {
+    __m256i wanted = _mm256_set1_epi32(key);
+    __m256i less = _mm256_setzero_si256();
+    for (unsigned int i = 0; i < count; i += 8) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        less = _mm256_sub_epi32(less, _mm256_cmpgt_epi32(wanted, block));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(less), _mm256_extracti128_si256(less, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(half);
+}
+
+#endif
+
+#endif
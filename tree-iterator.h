@@ -0,0 +1,102 @@
+#ifndef LAB3_TREE_ITERATOR_H
+#define LAB3_TREE_ITERATOR_H
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+// Bidirectional iterator over the values of a tree in order, following the
+// parent links of the nodes, so that a full traversal is O(n) and each step is
+// amortized O(1). Value is the type the iterator gives access to (e.g. a const
+// key for a set, or a pair with a const key for a map).
+//
+// The end iterator points at no node, and keeps the address of the tree's root
+// pointer so that it can still be decremented to the last value.
+template <class Node, class Value>
+class TreeIterator {
+public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef typename std::remove_const<Value>::type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef Value* pointer;
+    typedef Value& reference;
+
+    TreeIterator() : node_(nullptr), root_(nullptr) {}
+    TreeIterator(Node* node, Node* const* root) : node_(node), root_(root) {}
+
+    // A mutable iterator converts to a const one.
+    template <class V>
+    TreeIterator(const TreeIterator<Node, V>& other) : node_(other.node_), root_(other.root_) {}
+
+    reference operator*() const { return node_->val; }
+    pointer operator->() const { return &node_->val; }
+
+    // Moves to the next value in order, or to the end after the last one.
+    TreeIterator& operator++();
+    TreeIterator operator++(int) { TreeIterator old = *this; ++*this; return old; }
+
+    // Moves to the previous value in order, or to the last value from the end.
+    TreeIterator& operator--();
+    TreeIterator operator--(int) { TreeIterator old = *this; --*this; return old; }
+
+    bool operator==(const TreeIterator& other) const { return node_ == other.node_; }
+    bool operator!=(const TreeIterator& other) const { return node_ != other.node_; }
+
+    // Returns the node the iterator points at, or nullptr at the end.
+    Node* node() const { return node_; }
+
+private:
+    template <class N, class V> friend class TreeIterator;
+
+    Node* node_;          // Current node, or nullptr at the end.
+    Node* const* root_;   // Address of the tree's root pointer.
+};
+
+template <class Node, class Value>
+TreeIterator<Node, Value>& TreeIterator<Node, Value>::operator++() {
+
+    // the next value is the smallest one in the right subtree, if there is one
+    if (node_->right != nullptr) {
+        node_ = node_->right;
+        while (node_->left != nullptr) node_ = node_->left;
+        return *this;
+    }
+
+    // otherwise it is the first ancestor that we reach from its left subtree
+    Node* child = node_;
+    node_ = node_->parent;
+    while (node_ != nullptr && child == node_->right) {
+        child = node_;
+        node_ = node_->parent;
+    }
+    return *this;
+}
+
+template <class Node, class Value>
+TreeIterator<Node, Value>& TreeIterator<Node, Value>::operator--() {
+
+    // from the end, go to the largest value in the tree
+    if (node_ == nullptr) {
+        node_ = *root_;
+        while (node_->right != nullptr) node_ = node_->right;
+        return *this;
+    }
+
+    // the previous value is the largest one in the left subtree, if there is one
+    if (node_->left != nullptr) {
+        node_ = node_->left;
+        while (node_->right != nullptr) node_ = node_->right;
+        return *this;
+    }
+
+    // otherwise it is the first ancestor that we reach from its right subtree
+    Node* child = node_;
+    node_ = node_->parent;
+    while (node_ != nullptr && child == node_->left) {
+        child = node_;
+        node_ = node_->parent;
+    }
+    return *this;
+}
+
+#endif
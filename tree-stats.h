@@ -0,0 +1,256 @@
+#ifndef LAB3_TREE_STATS_H
+#define LAB3_TREE_STATS_H
+
+#ifdef LAB3_TREE_STATS
+#include <atomic>
+#endif
+
+// Snapshot of what the operations of a tree have done since it was created or
+// its stats were last reset. The trees only count when the program is built
+// with LAB3_TREE_STATS defined; otherwise stats() returns a snapshot of zeros
+// with enabled false, and the counting compiles away.
+struct TreeStats {
+    enum Operation { INSERT, REMOVE, EXISTS, OPERATIONS };
+
+    // Paths of MAX_PATH or more nodes share the last bucket of their histogram,
+    // and so do operations that rotated MAX_ROTATIONS times or more.
+    static const unsigned int MAX_PATH = 64;
+    static const unsigned int MAX_ROTATIONS = 8;
+
+    bool enabled;  // Whether the tree was built to count at all.
+
+    unsigned long long operations[OPERATIONS];                 // Calls of insert, remove and exists.
+    unsigned long long nodesVisited[OPERATIONS];               // Nodes they visited, as in nodesVisited().
+    unsigned long long pathLengths[OPERATIONS][MAX_PATH + 1];  // Number of calls that visited k nodes.
+    unsigned long long rotationsPerOperation[MAX_ROTATIONS + 1]; // Inserts and removes that rotated k times.
+
+    unsigned long long comparisons;     // Calls of the comparator by any operation.
+    unsigned long long rotations;       // Single rotations, two for each double one.
+    unsigned long long doubleRotations; // Left-right and right-left rotations.
+    unsigned long long rebalances;      // Subtrees rebalanced by balanceSubTree.
+    unsigned long long allocations;     // Nodes allocated by inserts and builds.
+    unsigned long long deallocations;   // Nodes freed.
+
+    // Returns the smallest k such that at least the fraction p (0..1) of the calls
+    // of op visited at most k nodes, or 0 if there were none.
+    unsigned int pathLengthPercentile(Operation op, double p) const {
+        unsigned long long rank = (unsigned long long)(p * operations[op]), seen = 0;
+        for (unsigned int k = 0; k <= MAX_PATH; ++k) {
+            seen += pathLengths[op][k];
+            if (seen > rank) return k;
+        }
+        return operations[op] == 0 ? 0 : MAX_PATH;
+    }
+};
+
+#ifdef LAB3_TREE_STATS
+
+// Counter that the workers of a parallel build or union, and readers sharing a
+// const tree, can all add to at once. Relaxed, since no other memory depends on
+// it; a copy starts from the value copied.
+class StatsCounter {
+public:
+    StatsCounter() : value_(0) {}
+    StatsCounter(const StatsCounter& other) : value_(other.value()) {}
+    StatsCounter& operator=(const StatsCounter& other) {
+        value_.store(other.value(), std::memory_order_relaxed);
+        return *this;
+    }
+
+    void add(unsigned long long n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    unsigned long long value() const { return value_.load(std::memory_order_relaxed); }
+    void reset() { value_.store(0, std::memory_order_relaxed); }
+
+private:
+    std::atomic<unsigned long long> value_;
+};
+
+// Number of nodes visited by the last operation of a tree to finish. Readers
+// sharing a const tree may all set it at once, so it is relaxed like StatsCounter.
+class VisitCount {
+public:
+    VisitCount() : value_(0) {}
+    VisitCount(const VisitCount& other) : value_(other.value()) {}
+    VisitCount& operator=(const VisitCount& other) {
+        set(other.value());
+        return *this;
+    }
+
+    void set(unsigned int n) { value_.store(n, std::memory_order_relaxed); }
+    unsigned int value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<unsigned int> value_;
+};
+
+// Comparator that counts its calls, which the trees use in place of Compare.
+template <class Compare>
+class CountingCompare {
+public:
+    CountingCompare() {}
+    CountingCompare(const Compare& compare) : compare_(compare) {}
+
+    template <class A, class B>
+    bool operator()(const A& a, const B& b) const {
+        count_.add(1);
+        return compare_(a, b);
+    }
+
+    unsigned long long count() const { return count_.value(); }
+    void reset() { count_.reset(); }
+
+private:
+    Compare compare_;
+    mutable StatsCounter count_;
+};
+
+template <class Compare>
+struct StatsCompare {
+    typedef CountingCompare<Compare> type;
+};
+
+// Counters of a tree, updated by its operations through the calls below, which
+// may come from several threads at once.
+class TreeStatsRecorder {
+public:
+    TreeStatsRecorder() : rotationsAtStart_(0) {}
+
+    void reset() {
+        for (unsigned int op = 0; op < TreeStats::OPERATIONS; ++op) {
+            operations_[op].reset();
+            nodesVisited_[op].reset();
+            for (unsigned int k = 0; k <= TreeStats::MAX_PATH; ++k) pathLengths_[op][k].reset();
+        }
+        for (unsigned int k = 0; k <= TreeStats::MAX_ROTATIONS; ++k) rotationsPerOperation_[k].reset();
+        rotations_.reset();
+        doubleRotations_.reset();
+        rebalances_.reset();
+        allocations_.reset();
+        deallocations_.reset();
+        rotationsAtStart_ = 0;
+        lastVisited_.set(0);
+    }
+
+    // Called as an insert, remove or exists starts, and as it ends with the number
+    // of nodes it visited. Only inserts and removes, which never run at the same
+    // time on one tree, count their rotations.
+    void started(TreeStats::Operation op) {
+        if (op != TreeStats::EXISTS) rotationsAtStart_ = rotations_.value();
+    }
+    void finished(TreeStats::Operation op, unsigned int visited) {
+        lastVisited_.set(visited);
+        operations_[op].add(1);
+        nodesVisited_[op].add(visited);
+        pathLengths_[op][visited < TreeStats::MAX_PATH ? visited : TreeStats::MAX_PATH].add(1);
+        if (op != TreeStats::EXISTS) {
+            unsigned long long rotations = rotations_.value() - rotationsAtStart_;
+            rotationsPerOperation_[rotations < TreeStats::MAX_ROTATIONS ? rotations : TreeStats::MAX_ROTATIONS].add(1);
+        }
+    }
+
+    void rotated() { rotations_.add(1); }
+    void doubleRotated() { doubleRotations_.add(1); }
+    void rebalanced() { rebalances_.add(1); }
+    void allocated(unsigned long long count) { allocations_.add(count); }
+    void deallocated(unsigned long long count) { deallocations_.add(count); }
+
+    // Returns the number of nodes visited by the last operation to finish.
+    unsigned int lastVisited() const { return lastVisited_.value(); }
+
+    template <class Compare>
+    TreeStats snapshot(const CountingCompare<Compare>& compare) const {
+        TreeStats stats = TreeStats();
+        stats.enabled = true;
+        for (unsigned int op = 0; op < TreeStats::OPERATIONS; ++op) {
+            stats.operations[op] = operations_[op].value();
+            stats.nodesVisited[op] = nodesVisited_[op].value();
+            for (unsigned int k = 0; k <= TreeStats::MAX_PATH; ++k) stats.pathLengths[op][k] = pathLengths_[op][k].value();
+        }
+        for (unsigned int k = 0; k <= TreeStats::MAX_ROTATIONS; ++k) {
+            stats.rotationsPerOperation[k] = rotationsPerOperation_[k].value();
+        }
+        stats.comparisons = compare.count();
+        stats.rotations = rotations_.value();
+        stats.doubleRotations = doubleRotations_.value();
+        stats.rebalances = rebalances_.value();
+        stats.allocations = allocations_.value();
+        stats.deallocations = deallocations_.value();
+        return stats;
+    }
+
+    template <class Compare>
+    void reset(CountingCompare<Compare>& compare) {
+        reset();
+        compare.reset();
+    }
+
+private:
+    StatsCounter operations_[TreeStats::OPERATIONS];
+    StatsCounter nodesVisited_[TreeStats::OPERATIONS];
+    StatsCounter pathLengths_[TreeStats::OPERATIONS][TreeStats::MAX_PATH + 1];
+    StatsCounter rotationsPerOperation_[TreeStats::MAX_ROTATIONS + 1];
+    StatsCounter rotations_;
+    StatsCounter doubleRotations_;
+    StatsCounter rebalances_;
+    StatsCounter allocations_;
+    StatsCounter deallocations_;
+    unsigned long long rotationsAtStart_;  // Value of rotations_ when the insert or remove in progress started.
+    VisitCount lastVisited_;               // Nodes visited by the last operation to finish.
+};
+
+#else
+
+// Keeps nothing, so a lookup on a const tree writes no memory.
+class VisitCount {
+public:
+    void set(unsigned int) {}
+    unsigned int value() const { return 0; }
+};
+
+template <class Compare>
+struct StatsCompare {
+    typedef Compare type;
+};
+
+// Counts nothing, so every call inlines to nothing.
+class TreeStatsRecorder {
+public:
+    void started(TreeStats::Operation) {}
+    void finished(TreeStats::Operation, unsigned int) {}
+    void rotated() {}
+    void doubleRotated() {}
+    void rebalanced() {}
+    void allocated(unsigned long long) {}
+    void deallocated(unsigned long long) {}
+    unsigned int lastVisited() const { return 0; }
+
+    template <class Compare>
+    TreeStats snapshot(const Compare&) const { return TreeStats(); }
+
+    template <class Compare>
+    void reset(Compare&) {}
+};
+
+#endif
+
+// Records one operation of a tree: started() when it is made, and finished()
+// with the final value of visited when it goes out of scope, on any return.
+class TreeStatsScope {
+public:
+    TreeStatsScope(TreeStatsRecorder& recorder, TreeStats::Operation op, const unsigned int& visited)
+        : recorder_(recorder), op_(op), visited_(visited) {
+        recorder_.started(op_);
+    }
+    ~TreeStatsScope() { recorder_.finished(op_, visited_); }
+
+private:
+    TreeStatsRecorder& recorder_;
+    TreeStats::Operation op_;
+    const unsigned int& visited_;
+
+    // Sets copy constructor and assignment operator to private.
+    TreeStatsScope(const TreeStatsScope& other);
+    TreeStatsScope& operator=(const TreeStatsScope& other);
+};
+
+#endif